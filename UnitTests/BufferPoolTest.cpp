@@ -0,0 +1,139 @@
+/*
+Copyright 2016 Thomas Jammet
+mathieu.poux[a]gmail.com
+jammetthomas[a]gmail.com
+
+This file is part of Librtmfp.
+
+Librtmfp is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Librtmfp is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with Librtmfp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "UnitTest.h"
+#include "Base/BufferPool.h"
+#include <map>
+#include <thread>
+
+using namespace Base;
+using namespace std;
+
+namespace {
+
+// Former pool : the biggest buffer cached behind one mutex, new buffers zeroed
+struct FormerPool : virtual Object {
+	FormerPool() : requested(0), reserved(0) {}
+	~FormerPool() {
+		for (const auto& it : _buffers)
+			delete[] it.second;
+	}
+	UInt8* allocate(UInt32& size) {
+		lock_guard<mutex> lock(_mutex);
+		requested += size;
+		if (_buffers.empty() || size > (--_buffers.end())->first) {
+			reserved += size;
+			return new UInt8[size]();
+		}
+		auto itBigger(--_buffers.end());
+		reserved += size = itBigger->first;
+		UInt8* buffer(itBigger->second);
+		_buffers.erase(itBigger);
+		return buffer;
+	}
+	void deallocate(UInt8* buffer, UInt32 size) {
+		lock_guard<mutex> lock(_mutex);
+		_buffers.emplace(size, buffer);
+	}
+	UInt64	requested;
+	UInt64	reserved;
+private:
+	multimap<UInt32, UInt8*>	_buffers;
+	mutex						_mutex;
+};
+
+// Each thread keeps the last WINDOW buffers allocated : acks, packets, some fragments of keyframe and some big messages
+template<typename PoolType>
+double Allocations(PoolType& pool, UInt8 threads) {
+	enum { COUNT = 200000, WINDOW = 64 };
+	static const UInt32 Sizes[] = { 6, 1192, 6, 1192, 6, 1192, 6, 1192, 6, 1192, 6, 1192, 6, 1192, 6, 1192, 6, 1192, 16384, 65536 };
+	return UnitTest::Rate(1, [&](UInt32) {
+		vector<thread> workers;
+		for (UInt8 t = 0; t < threads; ++t) {
+			workers.emplace_back([&pool]() {
+				pair<UInt8*, UInt32> buffers[WINDOW]; // null
+				for (UInt32 i = 0; i < COUNT; ++i) {
+					pair<UInt8*, UInt32>& buffer(buffers[i % WINDOW]);
+					if (buffer.first)
+						pool.deallocate(buffer.first, buffer.second);
+					buffer.second = Sizes[i % (sizeof(Sizes) / sizeof(Sizes[0]))];
+					buffer.first = pool.allocate(buffer.second);
+					buffer.first[0] = UInt8(i); // touched as a packet
+				}
+				for (auto& buffer : buffers)
+					pool.deallocate(buffer.first, buffer.second);
+			});
+		}
+		for (thread& worker : workers)
+			worker.join();
+	}) * COUNT * threads;
+}
+
+}
+
+ADD_TEST(BufferPoolSizeClasses) {
+	Timer timer;
+	BufferPool pool(timer);
+	// an ack takes the smallest class, not the biggest buffer cached
+	UInt32 size(65536);
+	UInt8* big(pool.allocate(size));
+	CHECK(size == 65536);
+	pool.deallocate(big, size);
+	size = 6;
+	UInt8* ack(pool.allocate(size));
+	CHECK(size == 64 && ack != big);
+	pool.deallocate(ack, size);
+	// reused from the magazine of the thread
+	size = 64;
+	CHECK(pool.allocate(size) == ack && size == 64);
+	pool.deallocate(ack, size);
+	size = 1192;
+	UInt8* packet(pool.allocate(size));
+	CHECK(size == 2048);
+	pool.deallocate(packet, size);
+	// too big to be pooled, but released it serves the biggest class
+	size = 100000;
+	UInt8* huge(pool.allocate(size));
+	CHECK(size == 100000);
+	pool.deallocate(huge, size);
+
+	BufferPool::Stats stats;
+	pool.stats(stats);
+	CHECK(stats.allocations == 4 && stats.reuses == 1);
+	CHECK(stats.requested == 65536 + 6 + 64 + 1192 + 100000 && stats.reserved == 65536 + 64 + 64 + 2048 + 100000);
+	CHECK(stats.cached == 65536 + 64 + 2048 + 65536);
+	CHECK(pool.available() == 4);
+	pool.clear();
+	CHECK(!pool.available());
+}
+
+ADD_BENCH(BufferPoolAllocationRate) {
+	Timer timer;
+	for (UInt8 threads : { 1, 4 }) {
+		FormerPool former;
+		BufferPool pool(timer);
+		double before(Allocations(former, threads)), after(Allocations(pool, threads));
+		BufferPool::Stats stats;
+		pool.stats(stats);
+		printf("\t%u thread(s) : %.0f allocations/s with the former pool (%.0f%% of the given bytes lost), %.0f allocations/s by size classes (%.0f%% lost) (x%.2f)\n",
+			threads, before, (former.reserved - former.requested) * 100.0 / former.reserved, after, stats.fragmentation() * 100, after / before);
+	}
+}
@@ -0,0 +1,89 @@
+/*
+Copyright 2016 Thomas Jammet
+mathieu.poux[a]gmail.com
+jammetthomas[a]gmail.com
+
+This file is part of Librtmfp.
+
+Librtmfp is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Librtmfp is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with Librtmfp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "UnitTest.h"
+#include "Base/Crypto.h"
+#include <random>
+
+using namespace Base;
+using namespace std;
+
+namespace {
+
+// Reference : big endian 16 bits words one by one, the odd last byte added as a low byte
+UInt32 ScalarChecksum(UInt32 sum, const UInt8* data, UInt32 size) {
+	UInt64 result(sum);
+	for (; size > 1; size -= 2, data += 2)
+		result += (data[0] << 8) | data[1];
+	if (size)
+		result += *data;
+	while (result >> 16)
+		result = (result >> 16) + (result & 0xFFFF);
+	return UInt32(result);
+}
+
+}
+
+ADD_TEST(CryptoChecksumKernels) {
+	enum {
+		MAX_SIZE = 1024, // several loops of the widest kernel (32 bytes) with all the tails
+		ALIGNMENTS = 32
+	};
+	vector<UInt8> random(MAX_SIZE + ALIGNMENTS), ones(MAX_SIZE + ALIGNMENTS, 0xFF), zeros(MAX_SIZE + ALIGNMENTS, 0);
+	mt19937 generator(7);
+	for (UInt8& value : random)
+		value = UInt8(generator());
+	UInt32 kernels(0);
+	for (Crypto::ChecksumKernel kernel : { Crypto::CHECKSUM_PORTABLE, Crypto::CHECKSUM_SSE2, Crypto::CHECKSUM_AVX2 }) {
+		UInt32 sum(0);
+		if (!Crypto::AddChecksum(kernel, sum, NULL, 0))
+			continue; // not available on this CPU
+		++kernels;
+		for (const vector<UInt8>* pData : { &random, &ones, &zeros }) {
+			for (UInt32 alignment = 0; alignment < ALIGNMENTS; ++alignment) {
+				const UInt8* data(pData->data() + alignment);
+				for (UInt32 size = 0; size <= MAX_SIZE; ++size) {
+					for (UInt32 initial : { 0u, 0xFFFFu, 0x1234u }) {
+						sum = initial;
+						CHECK(Crypto::AddChecksum(kernel, sum, data, size));
+						CHECK(sum == ScalarChecksum(initial, data, size));
+					}
+				}
+			}
+		}
+		// Partial sums (even parts, the last one odd) give the checksum of the whole
+		for (UInt32 size = 1; size <= MAX_SIZE; size += 37) {
+			for (UInt32 part = 2; part < size; part += 34) {
+				sum = 0;
+				CHECK(Crypto::AddChecksum(kernel, sum, random.data() + 1, part) && Crypto::AddChecksum(kernel, sum, random.data() + 1 + part, size - part));
+				CHECK(sum == ScalarChecksum(0, random.data() + 1, size));
+			}
+		}
+		// Carries of the 64 bits lanes on the biggest datagrams
+		vector<UInt8> big(0x10000, 0xFF);
+		sum = 0;
+		CHECK(Crypto::AddChecksum(kernel, sum, big.data(), big.size()) && sum == ScalarChecksum(0, big.data(), big.size()));
+	}
+	CHECK(kernels);
+	// The default kernel is the same
+	CHECK(Crypto::AddChecksum(0x1234, random.data() + 3, MAX_SIZE - 1) == ScalarChecksum(0x1234, random.data() + 3, MAX_SIZE - 1));
+	CHECK(Crypto::ComputeChecksum(random.data(), MAX_SIZE) == UInt16(~ScalarChecksum(0, random.data(), MAX_SIZE)));
+}
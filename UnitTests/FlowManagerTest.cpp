@@ -0,0 +1,136 @@
+/*
+Copyright 2016 Thomas Jammet
+mathieu.poux[a]gmail.com
+jammetthomas[a]gmail.com
+
+This file is part of Librtmfp.
+
+Librtmfp is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Librtmfp is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with Librtmfp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "UnitTest.h"
+#include "RTMFPSession.h"
+#include "RTMFPWriter.h"
+#include "Invoker.h"
+#include "librtmfp.h"
+#include <thread>
+
+using namespace Base;
+using namespace std;
+
+namespace {
+
+void OnSocketError(const char* error) {}
+void OnStatus(const char* code, const char* description) {}
+
+// Configuration of the session (defaults of RTMFP_Init)
+RTMFPConfig Config() {
+	RTMFPConfig config;
+	memset(&config, 0, sizeof(config));
+	config.pOnSocketError = OnSocketError;
+	config.pOnStatusEvent = OnStatus;
+	config.fecSources = 8;
+	config.fecRepairs = 2;
+	config.queueSize = 1024;
+	return config;
+}
+
+// Session which counts its managements and keeps the senders instead of sending them
+struct TestSession : RTMFPSession, virtual Object {
+	TestSession(Invoker& invoker) : RTMFPSession(invoker, Config()), manages(0) {}
+
+	UInt32	manage() { ++manages; return RTMFPSession::manage(); }
+	void	send(const shared<RTMFPSender>& pSender) { senders.emplace_back(pSender); }
+
+	// Write a reliable message on a new writer
+	void	write() { createWriter(Packet(EXPAND("\x00\x54\x43\x04\x00")))->writeRaw().write8(0); }
+
+	atomic<UInt32>				manages;
+	vector<shared<RTMFPSender>>	senders;
+};
+
+// Wait until the session has been managed count times (or timeout msec), return the time waited
+Int64 WaitManages(TestSession& session, UInt32 count, UInt32 timeout = 1000) {
+	Time start;
+	while (session.manages < count && !start.isElapsed(timeout))
+		this_thread::sleep_for(chrono::milliseconds(1));
+	return start.elapsed();
+}
+
+// Schedule the management of the session on the invoker thread
+struct Schedule : Runner, virtual Object {
+	Schedule(Invoker& invoker, const RTMFPSession& session, initializer_list<UInt32> delays) : Runner("Schedule"), _invoker(invoker), _session(session), _delays(delays) {}
+	bool run(Exception& ex) {
+		for (UInt32 delay : _delays)
+			_invoker.schedule(_session, delay);
+		return true;
+	}
+private:
+	Invoker&				_invoker;
+	const RTMFPSession&		_session;
+	vector<UInt32>			_delays;
+};
+
+}
+
+ADD_TEST(FlowManagerDeadlines) {
+	Invoker invoker(false, 1); // not started, the session is managed by the test
+	TestSession session(invoker);
+	// Idle connection : next management in DELAY_CONNECTIONS_IDLE, far beyond the former 50ms tick
+	CHECK(session.manage() == DELAY_CONNECTIONS_IDLE);
+	session.status = RTMFP::CONNECTED;
+	CHECK(session.manage() == DELAY_CONNECTIONS_IDLE); // next ping in 25s
+	// A reliable message sent : next management at the repeat deadline of its writer (RTO)
+	session.write();
+	UInt32 delay(session.manage());
+	CHECK(session.senders.size() == 1 && strcmp(session.senders.back()->name, "RTMFPMessenger") == 0);
+	CHECK(delay <= session.rto() + 1 && delay + 20 >= session.rto());
+	// Not repeated before the deadline...
+	this_thread::sleep_for(chrono::milliseconds(delay - 50));
+	delay = session.manage();
+	CHECK(session.senders.size() == 1);
+	CHECK(delay <= 51 && delay >= 20);
+	// ...but once it expires
+	this_thread::sleep_for(chrono::milliseconds(delay));
+	delay = session.manage();
+	CHECK(session.senders.size() == 2 && strcmp(session.senders.back()->name, "RTMFPRepeater") == 0);
+	CHECK(delay > session.rto()); // backoff of the next repeat
+}
+
+ADD_TEST(InvokerScheduleWake) {
+	Invoker invoker(false, 1);
+	CHECK(invoker.start());
+	shared<RTMFPSession> pSession(new TestSession(invoker));
+	TestSession& session((TestSession&)*pSession);
+	unsigned int index(invoker.addConnection(pSession));
+	// Managed at once on creation, then idle : not managed during 6 former ticks
+	CHECK(WaitManages(session, 1) < 1000);
+	this_thread::sleep_for(chrono::milliseconds(DELAY_CONNECTIONS_MANAGER * 6));
+	CHECK(session.manages == 1);
+	// Wake : managed at once (thread-safe)
+	invoker.wake(session);
+	CHECK(WaitManages(session, 2) < DELAY_CONNECTIONS_MANAGER);
+	// Schedule : a deadline can only be moved earlier (as a repeat deadline)
+	invoker.handler.queue(make_shared<Schedule>(invoker, session, initializer_list<UInt32>({ 150, 1000 })));
+	Int64 waited(WaitManages(session, 3));
+	CHECK(waited >= 145 && waited < 400);
+	// Delayed acknowledgments : scheduled after DELAY_CONNECTIONS_MANAGER by each packet decoded, even if a later deadline exists
+	invoker.handler.queue(make_shared<Schedule>(invoker, session, initializer_list<UInt32>({ 1000, DELAY_CONNECTIONS_MANAGER })));
+	waited = WaitManages(session, 4);
+	CHECK(waited >= DELAY_CONNECTIONS_MANAGER - 5 && waited < 300);
+	// Then idle again
+	this_thread::sleep_for(chrono::milliseconds(DELAY_CONNECTIONS_MANAGER * 6));
+	CHECK(session.manages == 4);
+	invoker.removeConnection(index);
+}
@@ -0,0 +1,108 @@
+/*
+Copyright 2016 Thomas Jammet
+mathieu.poux[a]gmail.com
+jammetthomas[a]gmail.com
+
+This file is part of Librtmfp.
+
+Librtmfp is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Librtmfp is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with Librtmfp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "UnitTest.h"
+#include "Base/MPSCQueue.h"
+#include <thread>
+
+using namespace Base;
+using namespace std;
+
+namespace {
+
+// Value of the producer index in the high bits, the sequence of the producer in the low bits
+typedef UInt64 Value;
+Value	NewValue(UInt32 producer, UInt32 sequence) { return (Value(producer) << 32) | sequence; }
+
+// Former queue of Handler and ThreadQueue
+struct LockedQueue : virtual Object {
+	void push(Value&& value) {
+		lock_guard<mutex> lock(_mutex);
+		_values.emplace_back(value);
+	}
+	bool pop(Value& value) {
+		lock_guard<mutex> lock(_mutex);
+		if (_values.empty())
+			return false;
+		value = _values.front();
+		_values.pop_front();
+		return true;
+	}
+private:
+	deque<Value>	_values;
+	mutex			_mutex;
+};
+
+/*!
+Push count values from each producer thread while the consumer pops them, check the order of each producer,
+returns the count of values by second */
+template<typename QueueType>
+double Contention(QueueType& queue, UInt32 producers, UInt32 count) {
+	vector<UInt32> sequences(producers, 0);
+	vector<thread> threads;
+	bool ordered(true);
+	double rate = UnitTest::Rate(1, [&](UInt32) {
+		for (UInt32 producer = 0; producer < producers; ++producer) {
+			threads.emplace_back([&queue, producer, count]() {
+				for (UInt32 sequence = 0; sequence < count; ++sequence)
+					queue.push(NewValue(producer, sequence));
+			});
+		}
+		Value value;
+		for (UInt64 received = 0; received < UInt64(producers) * count;) {
+			if (!queue.pop(value)) {
+				this_thread::yield();
+				continue;
+			}
+			UInt32& sequence(sequences[value >> 32]);
+			if (UInt32(value) != sequence++)
+				ordered = false;
+			++received;
+		}
+		for (thread& thread : threads)
+			thread.join();
+	}) * producers * count;
+	CHECK(ordered);
+	Value value;
+	CHECK(!queue.pop(value));
+	return rate;
+}
+
+}
+
+ADD_TEST(MPSCQueueOrder) {
+	// Small ring : the producers overflow all the time, and fill the ring again
+	for (UInt32 producers : { 1, 2, 8 }) {
+		MPSCQueue<Value, 16> queue;
+		Contention(queue, producers, 50000);
+	}
+}
+
+ADD_BENCH(MPSCQueueContention) {
+	enum { COUNT = 500000 };
+	for (UInt32 producers : { 1, 2, 4, 8 }) {
+		LockedQueue locked;
+		double before = Contention(locked, producers, COUNT);
+		unique_ptr<MPSCQueue<Value, 4096>> pQueue(new MPSCQueue<Value, 4096>()); // as Handler
+		double after = Contention(*pQueue, producers, COUNT);
+		printf("\t%u producers : %.0f values/s with a mutex, %.0f values/s lock-free (x%.2f)\n", producers, before, after, after / before);
+	}
+}
@@ -0,0 +1,55 @@
+/*
+Copyright 2016 Thomas Jammet
+mathieu.poux[a]gmail.com
+jammetthomas[a]gmail.com
+
+This file is part of Librtmfp.
+
+Librtmfp is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Librtmfp is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with Librtmfp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "UnitTest.h"
+#include <string.h>
+#include <stdio.h>
+
+using namespace std;
+
+/*!
+Run the checks, or the benchmarks with -b, only the ones whose name contains the filter argument */
+int main(int argc, char* argv[]) {
+	bool bench(false);
+	const char* filter(NULL);
+	for (int i = 1; i < argc; ++i) {
+		if (strcmp(argv[i], "-b") == 0)
+			bench = true;
+		else
+			filter = argv[i];
+	}
+	int failures(0), count(0);
+	for (UnitTest* pTest : UnitTest::Tests()) {
+		if (pTest->bench != bench || (filter && !strstr(pTest->name, filter)))
+			continue;
+		++count;
+		printf("%s...\n", pTest->name);
+		fflush(stdout);
+		try {
+			pTest->function();
+		} catch (const UnitTest::Failure& failure) {
+			printf("%s FAILED %s:%ld, %s\n", pTest->name, failure.file, failure.line, failure.condition);
+			++failures;
+		}
+	}
+	printf("%d %s, %d failed\n", count, bench ? "benchmarks" : "tests", failures);
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,116 @@
+/*
+Copyright 2016 Thomas Jammet
+mathieu.poux[a]gmail.com
+jammetthomas[a]gmail.com
+
+This file is part of Librtmfp.
+
+Librtmfp is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Librtmfp is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with Librtmfp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "UnitTest.h"
+#include "RTMFPDecoder.h"
+
+using namespace Base;
+using namespace std;
+
+namespace {
+
+enum { PAYLOAD = 1100 };
+
+// Peers of a connection sending numbered datagrams, decoded by one pipeline by peer or by one pipeline for all (former track of the connection)
+struct Peers : virtual Object {
+	Peers(UInt32 peers, UInt32 count, bool single, UInt16 threads = 0) : threadPool(threads), handler(signal), done(0), disordered(0) {
+		RTMFP::Engine encoder(BIN "Adobe Systems 02");
+		for (UInt32 peer = 0; peer < peers; ++peer) {
+			engines.emplace_back(new RTMFP::Engine(BIN "Adobe Systems 02"));
+			received.emplace_back(0);
+			if (!single || decoders.empty()) {
+				decoders.emplace_back(new RTMFPDecoder(peer, handler, threadPool));
+				decoders.back()->onDecoded = [this](RTMFPDecoder::Decoded& decoded) {
+					BinaryReader reader(decoded.data() + 3, decoded.size() - 3); // after marker and time
+					UInt32 peer(reader.read32());
+					if (received[peer]++ != reader.read32())
+						++disordered;
+					++done;
+				};
+			}
+		}
+		// datagrams encoded before the measure, in the order of reception
+		for (UInt32 number = 0; number < count; ++number) {
+			for (UInt32 peer = 0; peer < peers; ++peer) {
+				shared<Buffer> pBuffer(RTMFP::NewBuffer(6));
+				BinaryWriter writer(*pBuffer);
+				writer.write8(0x89).write16(0).write32(peer).write32(number).next(PAYLOAD - 8);
+				const Buffer& encoded(*encoder.encode(pBuffer, 33, address));
+				datagrams.emplace_back(new Buffer(encoded.size() - 4, encoded.data() + 4)); // after the session id
+			}
+		}
+	}
+	~Peers() { threadPool.join(); }
+
+	// Receive the datagrams (as the socket thread) and handle the decoded ones, returns the datagrams decoded by second
+	double receive() {
+		return UnitTest::Rate(1, [this](UInt32) {
+			UInt32 peer(0);
+			for (const shared<Buffer>& pDatagram : datagrams) {
+				for (;;) {
+					shared<Buffer> pBuffer(new Buffer(pDatagram->size(), pDatagram->data()));
+					Exception ex;
+					if (decoders[peer % decoders.size()]->decode(ex, engines[peer], pBuffer, address))
+						break;
+					handler.flush(); // queue full, let the handler catch up
+				}
+				if (++peer == engines.size())
+					peer = 0;
+			}
+			while (done < datagrams.size()) {
+				signal.wait(100);
+				handler.flush();
+			}
+		}) * datagrams.size();
+	}
+
+	ThreadPool							threadPool;
+	Signal								signal;
+	Handler								handler;
+	SocketAddress						address;
+	vector<shared<RTMFP::Engine>>		engines;
+	vector<unique<RTMFPDecoder>>		decoders;
+	vector<shared<Buffer>>				datagrams;
+	vector<UInt32>						received;
+	UInt32								done;
+	UInt32								disordered;
+};
+
+}
+
+ADD_TEST(RTMFPDecoderOrder) {
+	// Each peer is decoded in the order of reception, whatever the thread of its pipeline
+	Peers peers(8, 200, false, 4);
+	peers.receive();
+	CHECK(peers.done == 8 * 200 && !peers.disordered);
+	for (UInt32 received : peers.received)
+		CHECK(received == 200);
+}
+
+ADD_BENCH(RTMFPDecoderPeers) {
+	enum { PEERS = 50, COUNT = 200 };
+	printf("\t%u processors, %u threads in the pool\n", Thread::ProcessorCount(), Thread::ProcessorCount() * 2);
+	Peers single(PEERS, COUNT, true), sharded(PEERS, COUNT, false);
+	double before(single.receive()), after(sharded.receive());
+	CHECK(!single.disordered && !sharded.disordered);
+	printf("\t%u peers, %u datagrams of %u bytes : %.0f datagrams/s on one pipeline, %.0f datagrams/s with a pipeline by peer (x%.2f)\n",
+		PEERS, PEERS * COUNT, PAYLOAD, before, after, after / before);
+}
@@ -0,0 +1,154 @@
+/*
+Copyright 2016 Thomas Jammet
+mathieu.poux[a]gmail.com
+jammetthomas[a]gmail.com
+
+This file is part of Librtmfp.
+
+Librtmfp is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Librtmfp is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with Librtmfp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "UnitTest.h"
+#include "RTMFPFEC.h"
+#include <random>
+
+using namespace Base;
+using namespace std;
+
+namespace {
+
+// Write the repair index of the block and give it to the decoder as RTMFPFlow, returns its size
+UInt32 Repair(const RTMFPFEC::Encoder& encoder, RTMFPFEC::Decoder* pDecoder, UInt8 index) {
+	shared<Buffer> pBuffer(new Buffer());
+	BinaryWriter writer(*pBuffer);
+	encoder.writeRepair(writer, 3, index);
+	UInt32 size(pBuffer->size());
+	if (pDecoder) {
+		BinaryReader reader(pBuffer->data(), pBuffer->size());
+		reader.next(4); // type, size and kind
+		reader.read7BitLongValue(); // flow id
+		UInt64 stage(reader.read7BitLongValue());
+		UInt8 count(reader.read8());
+		index = reader.read8();
+		Packet packet(pBuffer);
+		pDecoder->repair(stage, count, index, Packet(packet, reader.current(), reader.available()));
+	}
+	return size;
+}
+
+// Fragment of the stage with a payload of size bytes
+Packet Fragment(UInt64 stage, UInt32 size) {
+	shared<Buffer> pBuffer(new Buffer(size));
+	for (UInt32 i = 0; i < size; ++i)
+		pBuffer->data()[i] = UInt8(i * 7 + stage * 13);
+	return Packet(pBuffer);
+}
+
+// Lose the symbols of the mask (sources then repairs) in a block of 8 fragments, returns false if a lost fragment is not rebuilt exactly
+bool Block(UInt8 scheme, UInt8 repairs, UInt32 lost) {
+	enum { SOURCES = 8 };
+	RTMFPFEC::Encoder encoder(RTMFPFEC::Config(scheme, SOURCES, repairs));
+	RTMFPFEC::Decoder decoder(scheme);
+	vector<Packet> fragments;
+	for (UInt8 i = 0; i < SOURCES; ++i) {
+		fragments.emplace_back(Fragment(i + 1, 100 + (i * 37) % 200)); // different sizes, padded in the symbols
+		UInt8 flags(i == SOURCES - 1 ? RTMFP::MESSAGE_END : 0);
+		encoder.add(i + 1, flags, fragments.back().size(), false);
+		encoder.append(fragments.back().data(), fragments.back().size());
+		if (!(lost & (1 << i)))
+			decoder.add(i + 1, flags, fragments.back());
+	}
+	for (UInt8 i = 0; i < repairs; ++i)
+		Repair(encoder, (lost & (1 << (SOURCES + i))) ? NULL : &decoder, i);
+	map<UInt64, RTMFPFEC::Fragment> recovered;
+	decoder.recover(recovered);
+	for (UInt8 i = 0; i < SOURCES; ++i) {
+		if (!(lost & (1 << i)))
+			continue;
+		auto it = recovered.find(i + 1);
+		if (it == recovered.end() || it->second.size() != fragments[i].size() || memcmp(it->second.data(), fragments[i].data(), fragments[i].size()))
+			return false;
+		if (it->second.flags != (i == SOURCES - 1 ? RTMFP::MESSAGE_END : 0))
+			return false;
+	}
+	return true;
+}
+
+UInt8 Bits(UInt32 value) {
+	UInt8 count(0);
+	for (; value; value &= value - 1)
+		++count;
+	return count;
+}
+
+}
+
+ADD_TEST(RTMFPFECRoundTrip) {
+	// every loss pattern which can be repaired : 1 symbol of XOR 8+1, up to 2 symbols of Reed-Solomon 8+2
+	for (UInt32 lost = 1; lost < (1 << 9); ++lost) {
+		if (Bits(lost) == 1)
+			CHECK(Block(RTMFPFEC::SCHEME_XOR, 1, lost));
+	}
+	for (UInt32 lost = 1; lost < (1 << 10); ++lost) {
+		if (Bits(lost) <= 2)
+			CHECK(Block(RTMFPFEC::SCHEME_REED_SOLOMON, 2, lost));
+	}
+}
+
+ADD_BENCH(RTMFPFECLossRecovery) {
+	enum { COUNT = 50000 };
+	struct { UInt8 scheme, sources, repairs; const char* name; } configs[] = {
+		{ RTMFPFEC::SCHEME_NONE, 8, 0, "none" },
+		{ RTMFPFEC::SCHEME_XOR, 8, 1, "XOR 8+1" }, { RTMFPFEC::SCHEME_XOR, 16, 1, "XOR 16+1" },
+		{ RTMFPFEC::SCHEME_REED_SOLOMON, 8, 2, "RS 8+2" }, { RTMFPFEC::SCHEME_REED_SOLOMON, 16, 4, "RS 16+4" }, { RTMFPFEC::SCHEME_REED_SOLOMON, 32, 4, "RS 32+4" }
+	};
+	for (const auto& config : configs) {
+		for (double loss : { 0.01, 0.05, 0.10 }) {
+			// uniform loss of the fragments and of the repairs
+			mt19937 random(42);
+			bernoulli_distribution lose(loss);
+			RTMFPFEC::Encoder encoder(RTMFPFEC::Config(config.scheme, config.sources, config.repairs));
+			RTMFPFEC::Decoder decoder(config.scheme);
+			map<UInt64, RTMFPFEC::Fragment> recovered;
+			UInt64 bytes(0), repairBytes(0);
+			UInt32 lost(0);
+			chrono::duration<double> encoding(0);
+			for (UInt64 stage = 1; stage <= COUNT; ++stage) {
+				Packet fragment(Fragment(stage, 1150 + stage % 31));
+				bytes += fragment.size() + 4; // + chunk header
+				auto start(chrono::steady_clock::now());
+				if (config.scheme) {
+					encoder.add(stage, 0, fragment.size(), false);
+					encoder.append(fragment.data(), fragment.size());
+				}
+				encoding += chrono::steady_clock::now() - start;
+				if (lose(random))
+					++lost;
+				else
+					decoder.add(stage, 0, fragment);
+				if (!config.scheme || !encoder.closable())
+					continue;
+				for (UInt8 i = 0; i < config.repairs; ++i) {
+					start = chrono::steady_clock::now();
+					repairBytes += Repair(encoder, lose(random) ? NULL : &decoder, i);
+					encoding += chrono::steady_clock::now() - start;
+				}
+				encoder.reset();
+				decoder.recover(recovered);
+			}
+			printf("\t%-8s %2.0f%% loss : %4.1f%% overhead, %5.3f%% residual loss, %.2fus to encode a fragment\n", config.name, loss * 100,
+				repairBytes * 100.0 / bytes, (lost - recovered.size()) * 100.0 / COUNT, encoding.count() * 1e6 / COUNT);
+		}
+	}
+}
@@ -0,0 +1,202 @@
+/*
+Copyright 2016 Thomas Jammet
+mathieu.poux[a]gmail.com
+jammetthomas[a]gmail.com
+
+This file is part of Librtmfp.
+
+Librtmfp is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Librtmfp is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with Librtmfp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "UnitTest.h"
+#include "RTMFPFlow.h"
+#include "RTMFPSession.h"
+#include "Invoker.h"
+#include "librtmfp.h"
+#include <set>
+#include <random>
+
+using namespace Base;
+using namespace std;
+
+namespace {
+
+enum { WINDOW = 1024 }; // RTMFPFlow::WINDOW
+
+void OnSocketError(const char* error) {}
+void OnStatus(const char* code, const char* description) {}
+
+// Configuration of the session (defaults of RTMFP_Init)
+RTMFPConfig Config() {
+	RTMFPConfig config;
+	memset(&config, 0, sizeof(config));
+	config.pOnSocketError = OnSocketError;
+	config.pOnStatusEvent = OnStatus;
+	config.fecSources = 8;
+	config.fecRepairs = 2;
+	config.queueSize = 1024;
+	return config;
+}
+
+bool Same(const Buffer& buffer1, const Buffer& buffer2) { return buffer1.size() == buffer2.size() && memcmp(buffer1.data(), buffer2.data(), buffer1.size()) == 0; }
+
+/*!
+Flow fed with abandoned fragments (no message to handle) compared with the former map of the stages
+received after a lost stage, which gave the reference acknowledgments */
+struct FlowChecker : virtual Object {
+	FlowChecker() : _session(_invoker, Config()),
+		_flow(3, "", make_shared<FlashConnection>(), _session, 0), _stage(0), _fragment(EXPAND("\x00")) {}
+
+	void input(UInt64 stage, UInt8 flags = 0) {
+		_flow.input(stage, RTMFP::MESSAGE_ABANDON | flags, _fragment);
+		// reference
+		if (stage <= _stage)
+			return;
+		if (stage > _stage + 1) {
+			if ((stage - _stage) <= WINDOW)
+				_stages.emplace(stage);
+			return;
+		}
+		++_stage;
+		while (!_stages.empty() && *_stages.begin() == _stage + 1) {
+			++_stage;
+			_stages.erase(_stages.begin());
+		}
+	}
+
+	// Compare the acknowledgment of the flow with the one of the map
+	void check() {
+		UInt16 size(0);
+		CHECK(_flow.buildAck(size) == _stage);
+		CHECK(_flow.gap() == !_stages.empty());
+		Buffer losts;
+		BinaryWriter writer(losts);
+		_flow.writeLosts(writer);
+		CHECK(losts.size() == size);
+		Buffer expected;
+		reference(expected);
+		CHECK(Same(losts, expected));
+	}
+	// Reference acknowledgment ranges : lost count - 1, received count - 1
+	void reference(Buffer& buffer) const {
+		BinaryWriter writer(buffer);
+		UInt64 stage(_stage);
+		auto it = _stages.begin();
+		while (it != _stages.end()) {
+			writer.write7BitLongValue(*it - stage - 2);
+			UInt64 buffered(0);
+			stage = *it;
+			while (++it != _stages.end() && *it == (++stage))
+				++buffered;
+			writer.write7BitLongValue(buffered);
+			--stage;
+		}
+	}
+
+	UInt64	stage() const { return _stage; }
+	bool	gap() const { return _flow.gap(); }
+
+private:
+	Invoker			_invoker; // not started
+	RTMFPSession	_session;
+	RTMFPFlow		_flow;
+	UInt64			_stage;
+	set<UInt64>		_stages;
+	Packet			_fragment;
+};
+
+}
+
+ADD_TEST(RTMFPFlowWindowEdges) {
+	FlowChecker flow;
+	flow.input(1);
+	flow.check();
+	// Last stage of the window accepted, the next one rejected (it would take the slot of the lost stage 2)
+	flow.input(1 + WINDOW);
+	flow.input(2 + WINDOW);
+	flow.input(1 + WINDOW - 1);
+	flow.check();
+	Buffer expected, losts;
+	BinaryWriter(expected).write7BitLongValue(WINDOW - 3).write7BitLongValue(1); // 2..1022 lost, 1023..1024 received
+	flow.reference(losts);
+	CHECK(Same(losts, expected));
+	// Duplicates are ignored
+	flow.input(1);
+	flow.input(1 + WINDOW);
+	flow.check();
+	// Lost stages received : the window is consumed, the rejected stage is still waiting a repetition
+	for (UInt64 stage = 2; stage < WINDOW; ++stage)
+		flow.input(stage);
+	flow.check();
+	CHECK(flow.stage() == 1 + WINDOW);
+	flow.input(2 + WINDOW);
+	flow.check();
+	losts.clear();
+	flow.reference(losts);
+	CHECK(flow.stage() == 2 + WINDOW && !losts.size());
+}
+
+ADD_TEST(RTMFPFlowWrapAround) {
+	// Many turns of the circular window with losts, reordering, duplicates and stages beyond the window
+	FlowChecker flow;
+	mt19937 random(11);
+	vector<UInt64> losts;
+	UInt64 sent(0);
+	while (flow.stage() < WINDOW * 40) {
+		UInt32 dice(random() % 100);
+		if (dice < 5) // lost, repeated later
+			losts.emplace_back(++sent);
+		else if (dice < 8) { // reordered with the next one
+			flow.input(sent + 2);
+			flow.input(sent + 1);
+			sent += 2;
+		}
+		else if (dice < 9) // beyond the window
+			flow.input(flow.stage() + WINDOW + 1 + random() % 64);
+		else if (dice < 10) // duplicate
+			flow.input(sent);
+		else
+			flow.input(++sent);
+		// Repetitions of the lost stages, sometimes too late (the writer waits, or the window blocks the sending)
+		if (!losts.empty() && (random() % 20 == 0 || (sent - flow.stage()) >= WINDOW)) {
+			UInt32 index(random() % losts.size());
+			flow.input(losts[index]);
+			losts.erase(losts.begin() + index);
+		}
+		if ((sent - flow.stage()) >= WINDOW) {
+			// window full : the writer repeats from the first stage not acknowledged
+			for (UInt64 stage = flow.stage() + 1; stage <= sent; ++stage)
+				flow.input(stage);
+			losts.clear();
+		}
+		flow.check();
+	}
+}
+
+ADD_TEST(RTMFPFlowEndBeyondWindow) {
+	// The last fragment beyond the window is rejected, the flow must not be completed until its repetition
+	FlowChecker flow;
+	flow.input(1);
+	flow.input(2 + WINDOW, RTMFP::MESSAGE_END);
+	flow.check();
+	flow.input(2); // nothing bufferized, handled as the next stage
+	flow.input(4);
+	flow.check();
+	CHECK(flow.stage() == 2 && flow.gap());
+	for (UInt64 stage = 3; stage <= 1 + WINDOW; ++stage)
+		flow.input(stage);
+	flow.input(2 + WINDOW, RTMFP::MESSAGE_END); // repeated
+	flow.check();
+	CHECK(flow.stage() == 2 + WINDOW && !flow.gap());
+}
@@ -0,0 +1,118 @@
+/*
+Copyright 2016 Thomas Jammet
+mathieu.poux[a]gmail.com
+jammetthomas[a]gmail.com
+
+This file is part of Librtmfp.
+
+Librtmfp is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Librtmfp is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with Librtmfp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#if !defined(_WIN32) // no descriptor on Windows
+
+#include "UnitTest.h"
+#include "RTMFPNotifier.h"
+#include <algorithm>
+#include <poll.h>
+#include <thread>
+
+using namespace Base;
+using namespace std;
+
+namespace {
+
+bool Readable(int fd, int timeout = 0) {
+	pollfd descriptor = { fd, POLLIN, 0 };
+	return poll(&descriptor, 1, timeout) == 1;
+}
+
+}
+
+ADD_TEST(RTMFPNotifierStates) {
+	RTMFPNotifier notifier;
+	notifier.set(); // before the creation of the descriptor
+	int fd(notifier.fd());
+	CHECK(fd >= 0 && notifier.fd() == fd);
+	CHECK(Readable(fd));
+	notifier.reset();
+	CHECK(!Readable(fd));
+	notifier.set();
+	notifier.set();
+	CHECK(Readable(fd));
+	notifier.reset(); // once whatever the count of set()
+	CHECK(!Readable(fd));
+	notifier.reset();
+	CHECK(!Readable(fd));
+}
+
+ADD_TEST(RTMFPNotifierNoLostWakeup) {
+	// Producer : queue then set, consumer : poll, reset, drain then check again (as RTMFP_TryRead)
+	enum { COUNT = 100000 };
+	RTMFPNotifier notifier;
+	int fd(notifier.fd());
+	atomic<UInt32> produced(0);
+	thread producer([&]() {
+		for (UInt32 i = 0; i < COUNT; ++i) {
+			++produced;
+			notifier.set();
+		}
+	});
+	UInt32 consumed(0);
+	while (consumed < COUNT) {
+		CHECK(Readable(fd, 1000)); // a wakeup lost blocks here
+		notifier.reset();
+		consumed = produced;
+		if (consumed < produced)
+			notifier.set();
+	}
+	producer.join();
+	CHECK(!Readable(fd));
+}
+
+ADD_BENCH(RTMFPNotifierLatency) {
+	// Delay between the set() of an event and the wakeup of the event loop polling the descriptor
+	enum { COUNT = 2000 };
+	typedef chrono::steady_clock Clock;
+	RTMFPNotifier notifier;
+	int fd(notifier.fd());
+	atomic<Clock::rep> setTime(0);
+	vector<double> latencies;
+	thread producer([&]() {
+		for (UInt32 i = 0; i < COUNT; ++i) {
+			while (setTime) // consumed
+				this_thread::yield();
+			this_thread::sleep_for(chrono::microseconds(200));
+			setTime = Clock::now().time_since_epoch().count();
+			notifier.set();
+		}
+	});
+	while (latencies.size() < COUNT) {
+		if (!Readable(fd, 1000))
+			break;
+		Clock::time_point now(Clock::now());
+		notifier.reset();
+		latencies.emplace_back(chrono::duration<double, micro>(now - Clock::time_point(Clock::duration(setTime.load()))).count());
+		setTime = 0;
+	}
+	producer.join();
+	CHECK(latencies.size() == COUNT);
+	sort(latencies.begin(), latencies.end());
+	// set() on a notifier already set doesn't make any system call
+	notifier.set();
+	double set(UnitTest::Rate(1000000, [&](UInt32) { notifier.set(); }));
+	printf("\twakeup latency p50 %.0fus, p99 %.0fus, max %.0fus (Signal::wait(100) loops and the 50ms manage tick : up to 150ms), set() already set %.0fns\n",
+		latencies[COUNT / 2], latencies[COUNT * 99 / 100], latencies.back(), 1e9 / set);
+}
+
+#endif
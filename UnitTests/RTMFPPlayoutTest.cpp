@@ -0,0 +1,121 @@
+/*
+Copyright 2016 Thomas Jammet
+mathieu.poux[a]gmail.com
+jammetthomas[a]gmail.com
+
+This file is part of Librtmfp.
+
+Librtmfp is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Librtmfp is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with Librtmfp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "UnitTest.h"
+#include "RTMFPPlayout.h"
+#include <algorithm>
+#include <random>
+
+using namespace Base;
+using namespace std;
+
+namespace {
+
+// Synthetic feed without network : audio of 20ms and video of 33ms (a key frame every 2s),
+// delay of 30ms plus an exponential jitter, and a stall of 300ms every 10s (NetGroup pull recovery, repetitions)
+struct Feed : virtual Object {
+	enum { DURATION = 60000, BASE = 1000000 };
+
+	Feed(double jitter, UInt16 minLatency = 0, UInt16 maxLatency = 1000) : playout(minLatency, maxLatency), total(0), released(0), disordered(0), disorderedEssentials(0), latency(0),
+		_pKey(new Buffer(10, "\x17\x01zzzzzzzz")), _pInter(new Buffer(10, "\x27\x01zzzzzzzz")), _pAudio(new Buffer(10, "\xAF\x01zzzzzzzz")) {
+		mt19937 random(42);
+		exponential_distribution<double> delays(1 / jitter);
+		struct Media { Int64 arrival; UInt32 time; AMF::Type type; };
+		vector<Media> medias;
+		for (UInt32 time = 0; time < DURATION; time += 20)
+			medias.push_back({ 0, time, AMF::TYPE_AUDIO });
+		for (UInt32 time = 0; time < DURATION; time += 33)
+			medias.push_back({ 0, time, AMF::TYPE_VIDEO });
+		for (Media& media : medias) {
+			double delay(30 + delays(random));
+			UInt32 phase(media.time % 10000);
+			if (phase >= 5000 && phase < 5300)
+				delay += 5300 - phase; // stall
+			media.arrival = BASE + media.time + Int64(delay);
+		}
+		stable_sort(medias.begin(), medias.end(), [](const Media& a, const Media& b) { return a.arrival < b.arrival; });
+		total = medias.size();
+
+		// the reader polls every ms
+		deque<shared<RTMFPMediaPacket>> output;
+		UInt32 last(0);
+		auto it(medias.begin());
+		for (Int64 now = BASE; now < medias.back().arrival + 2000; ++now) {
+			for (; it != medias.end() && it->arrival <= now; ++it) {
+				RTMFP::Fragments fragments;
+				fragments.add(Packet(it->type == AMF::TYPE_AUDIO ? _pAudio : ((it->time % 2000) < 33 ? _pKey : _pInter)));
+				playout.add(now, make_shared<RTMFPMediaPacket>(fragments, it->time, it->type));
+			}
+			playout.release(now, output);
+			for (const shared<RTMFPMediaPacket>& pPacket : output) {
+				if (pPacket->time < last) {
+					++disordered;
+					if (pPacket->essential())
+						++disorderedEssentials;
+				}
+				last = pPacket->time;
+				latency += double(now - BASE - pPacket->time);
+				++released;
+			}
+			output.clear();
+		}
+		latency /= released;
+	}
+
+	RTMFPPlayout	playout;
+	UInt32			total;
+	UInt32			released;
+	UInt32			disordered; // released before a packet of greater timestamp
+	UInt32			disorderedEssentials;
+	double			latency; // mean latency of the packets released (ms)
+private:
+	shared<Buffer>	_pKey;
+	shared<Buffer>	_pInter;
+	shared<Buffer>	_pAudio;
+};
+
+}
+
+ADD_TEST(RTMFPPlayoutJitteredFeed) {
+	Feed feed(20, 50, 1000);
+	// every packet is released or dropped, in order of timestamp (only the late essential ones can be released out of order)
+	CHECK(feed.released + feed.playout.dropped == feed.total && !feed.playout.size());
+	CHECK(feed.disordered == feed.disorderedEssentials);
+	CHECK(feed.playout.dropped <= feed.playout.late && feed.playout.dropped < feed.total / 50);
+	CHECK(feed.playout.latency() >= 50 && feed.playout.latency() <= 1000 && feed.latency < 1000);
+
+	// the max latency bounds the buffer
+	Feed bounded(20, 0, 100);
+	CHECK(bounded.released + bounded.playout.dropped == bounded.total);
+	CHECK(bounded.playout.latency() <= 100 && bounded.latency < feed.latency);
+	CHECK(bounded.disordered == bounded.disorderedEssentials);
+}
+
+ADD_BENCH(RTMFPPlayoutJitter) {
+	for (double jitter : { 5.0, 20.0, 50.0 }) {
+		for (UInt16 maxLatency : { 100, 1000 }) {
+			Feed feed(jitter, 0, maxLatency);
+			printf("\tjitter %2.0fms, max latency %4ums : %u/%u released (%u out of order), %llu late, %llu dropped, mean latency %.0fms, target %ums, jitter %ums\n",
+				jitter, maxLatency, feed.released, feed.total, feed.disordered, (unsigned long long)feed.playout.late, (unsigned long long)feed.playout.dropped,
+				feed.latency, feed.playout.latency(), feed.playout.jitter());
+		}
+	}
+}
@@ -0,0 +1,251 @@
+/*
+Copyright 2016 Thomas Jammet
+mathieu.poux[a]gmail.com
+jammetthomas[a]gmail.com
+
+This file is part of Librtmfp.
+
+Librtmfp is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Librtmfp is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with Librtmfp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "UnitTest.h"
+#include "RTMFP.h"
+
+using namespace Base;
+using namespace std;
+
+namespace {
+
+enum {
+	PAYLOAD = 1100, // media payload of a datagram
+	CHUNK_HEADER = 20
+};
+
+// Chunk header of a message fragment followed by payload referenced or copied
+shared<Buffer>& Datagram(shared<Buffer>& pBuffer, RTMFP::Segments* pSegments, const Packet& payload) {
+	pBuffer = RTMFP::NewBuffer(6); // id + checksum, capacity of a packet as InitBuffer
+	BinaryWriter writer(*pBuffer);
+	writer.write8(0x89).write16(0x1234); // marker + time (fixed to compare the datagrams)
+	for (UInt8 i = 0; i < CHUNK_HEADER; ++i)
+		writer.write8(i);
+	if (pSegments)
+		pSegments->add(pBuffer->size(), payload, payload.data(), payload.size());
+	else
+		writer.write(payload);
+	return pBuffer;
+}
+
+Packet Payload() {
+	shared<Buffer> pPayload(new Buffer(PAYLOAD));
+	for (UInt32 i = 0; i < PAYLOAD; ++i)
+		pPayload->data()[i] = UInt8(i * 7);
+	return Packet(pPayload);
+}
+
+}
+
+ADD_TEST(RTMFPSegmentsSharePayload) {
+	RTMFP::Engine engine(BIN "Adobe Systems 02");
+	SocketAddress address;
+	// Flat datagram, payload copied
+	Packet payload(Payload());
+	shared<Buffer> pFlat;
+	Packet flat(engine.encode(Datagram(pFlat, NULL, payload), 33, address));
+	// Same datagram with the payload referenced, released before the encoding
+	RTMFP::Segments segments;
+	shared<Buffer> pBuffer;
+	Datagram(pBuffer, &segments, payload);
+	const UInt8* data(payload.data());
+	payload.reset();
+	CHECK(segments.size() == 1 && segments.bytes == PAYLOAD);
+	CHECK(segments.front().second.data() == data && segments.front().second.buffer().use_count() == 1); // shared, not copied
+	Packet encoded(engine.encode(pBuffer, segments, 33, address));
+	CHECK(segments.empty() && !segments.bytes);
+	CHECK(encoded == flat);
+	// And it decodes with a valid checksum (after the session id)
+	Buffer decoded(encoded.size() - 4, encoded.data() + 4);
+	Exception ex;
+	CHECK(engine.decode(ex, decoded, address));
+	CHECK(memcmp(decoded.data() + 3 + CHUNK_HEADER, Payload().data(), PAYLOAD) == 0);
+}
+
+ADD_TEST(RTMFPSegmentsAlignments) {
+	// Segments at every position of the AES blocks, with chunks around them, give the same datagram as the flat one
+	RTMFP::Engine engine(BIN "Adobe Systems 02");
+	SocketAddress address;
+	Packet payload(Payload());
+	for (UInt32 header = 0; header < 20; ++header) {
+		for (UInt32 size : { 20u, 33u, 64u, 100u, 500u }) {
+			shared<Buffer> pFlat(RTMFP::NewBuffer(6)), pBuffer(RTMFP::NewBuffer(6));
+			RTMFP::Segments segments;
+			BinaryWriter flat(*pFlat), writer(*pBuffer);
+			for (UInt32 i = 0; i < header; ++i) {
+				flat.write8(i);
+				writer.write8(i);
+			}
+			// two segments separated by a chunk header, then a last chunk
+			for (UInt8 i = 0; i < 2; ++i) {
+				flat.write(payload.data() + i, size);
+				segments.add(pBuffer->size(), payload, payload.data() + i, size);
+				flat.write(EXPAND("\x10\x11\x12"));
+				writer.write(EXPAND("\x10\x11\x12"));
+			}
+			Packet expected(engine.encode(pFlat, 33, address));
+			CHECK(Packet(engine.encode(pBuffer, segments, 33, address)) == expected);
+		}
+	}
+}
+
+ADD_BENCH(RTMFPSegmentsFanOut) {
+	enum { LISTENERS = 8, COUNT = 20000, RUNS = 3 };
+	vector<unique_ptr<RTMFP::Engine>> engines;
+	for (UInt8 i = 0; i < LISTENERS; ++i)
+		engines.emplace_back(new RTMFP::Engine(BIN "Adobe Systems 02"));
+	SocketAddress address;
+	Packet full(Payload());
+	RTMFP::Segments segments;
+	for (UInt32 size : { 64u, 128u, 256u, 512u, UInt32(PAYLOAD) }) {
+		Packet payload(full, full.data(), size);
+		// runs interleaved to share the noise of the machine, best of each kept
+		double copied(0), referenced(0);
+		for (UInt8 run = 0; run < RUNS; ++run) {
+			// Copy of the payload in the datagram of each listener, encrypted in place
+			copied = max(copied, UnitTest::Rate(COUNT, [&](UInt32) {
+				for (auto& pEngine : engines) {
+					shared<Buffer> pBuffer;
+					pEngine->encode(Datagram(pBuffer, NULL, payload), 33, address);
+				}
+			}) * LISTENERS);
+			// Payload referenced, encrypted from the message
+			referenced = max(referenced, UnitTest::Rate(COUNT, [&](UInt32) {
+				for (auto& pEngine : engines) {
+					shared<Buffer> pBuffer;
+					pEngine->encode(Datagram(pBuffer, &segments, payload), segments, 33, address);
+				}
+			}) * LISTENERS);
+		}
+		printf("\t%u listeners, %u bytes payload : %.0f datagrams/s copied, %.0f datagrams/s referenced (x%.2f)\n",
+			LISTENERS, size, copied, referenced, referenced / copied);
+	}
+}
+
+ADD_BENCH(RTMFPEngineThroughput) {
+	enum { COUNT = 100000 };
+	RTMFP::Engine engine(BIN "Adobe Systems 02");
+	SocketAddress address;
+	Packet payload(Payload());
+	shared<Buffer> pDatagram;
+	Datagram(pDatagram, NULL, payload);
+	Packet plain(pDatagram); // takes the buffer
+	auto newDatagram = [&](shared<Buffer>& pBuffer) { pBuffer.reset(new Buffer(plain.size(), plain.data())); };
+	// Before : a cipher context keyed for each packet (as a new engine)
+	double fresh = UnitTest::Rate(COUNT, [&](UInt32) {
+		shared<Buffer> pBuffer;
+		newDatagram(pBuffer);
+		RTMFP::Engine(engine).encode(pBuffer, 33, address);
+	});
+	// After : the context of the direction keeps the key schedule
+	double single = UnitTest::Rate(COUNT, [&](UInt32) {
+		shared<Buffer> pBuffer;
+		newDatagram(pBuffer);
+		engine.encode(pBuffer, 33, address);
+	});
+	printf("\tencode %u bytes : %.0f packets/s keyed by packet, %.0f packets/s (x%.2f)\n", plain.size(), fresh, single, single / fresh);
+
+	// Decode of the encoded datagram (after the session id)
+	newDatagram(pDatagram);
+	Packet encoded(engine.encode(pDatagram, 33, address));
+	Exception ex;
+	auto newEncoded = [&](shared<Buffer>& pBuffer) { pBuffer.reset(new Buffer(encoded.size() - 4, encoded.data() + 4)); };
+	fresh = UnitTest::Rate(COUNT, [&](UInt32) {
+		shared<Buffer> pBuffer;
+		newEncoded(pBuffer);
+		CHECK(RTMFP::Engine(engine).decode(ex, *pBuffer, address));
+	});
+	single = UnitTest::Rate(COUNT, [&](UInt32) {
+		shared<Buffer> pBuffer;
+		newEncoded(pBuffer);
+		CHECK(engine.decode(ex, *pBuffer, address));
+	});
+	printf("\tdecode %u bytes : %.0f packets/s keyed by packet, %.0f packets/s (x%.2f)\n", encoded.size() - 4, fresh, single, single / fresh);
+}
+
+namespace {
+
+// Keyframe of size bytes received in fragments of PAYLOAD bytes, each one referencing its own datagram
+vector<Packet> Received(UInt32 size) {
+	vector<Packet> fragments;
+	fragments.reserve(size / PAYLOAD + 1);
+	for (UInt32 position = 0; position < size; position += PAYLOAD) {
+		UInt32 count(min<UInt32>(PAYLOAD, size - position));
+		shared<Buffer> pDatagram(new Buffer(count + CHUNK_HEADER));
+		for (UInt32 i = 0; i < count; ++i)
+			pDatagram->data()[CHUNK_HEADER + i] = UInt8(position + i);
+		fragments.emplace_back();
+		fragments.back().set(pDatagram, pDatagram->data() + CHUNK_HEADER, count);
+	}
+	return fragments;
+}
+
+}
+
+ADD_TEST(RTMFPFragmentsReassembly) {
+	vector<Packet> received(Received(5 * PAYLOAD + 10));
+	RTMFP::Fragments fragments;
+	for (const Packet& fragment : received)
+		fragments.add(fragment);
+	CHECK(fragments.bytes == 5 * PAYLOAD + 10 && fragments.front().data() == received.front().data()); // referenced, not copied
+	// write from any position, through the fragments
+	for (UInt32 position : { 0u, 1u, UInt32(PAYLOAD - 1), UInt32(PAYLOAD), UInt32(3 * PAYLOAD + 7) }) {
+		Buffer buffer;
+		BinaryWriter writer(buffer);
+		fragments.write(writer, position, 2 * PAYLOAD);
+		CHECK(buffer.size() == min<UInt32>(2 * PAYLOAD, fragments.bytes - position));
+		for (UInt32 i = 0; i < buffer.size(); ++i)
+			CHECK(buffer.data()[i] == UInt8(position + i));
+	}
+	Packet packet;
+	fragments.linearize(packet);
+	CHECK(packet.size() == fragments.bytes);
+	for (UInt32 i = 0; i < packet.size(); ++i)
+		CHECK(packet.data()[i] == UInt8(i));
+	// one fragment is shared as it is
+	RTMFP::Fragments single;
+	single.add(received.front());
+	CHECK(single.linearize(packet).data() == received.front().data());
+}
+
+ADD_BENCH(RTMFPFragmentsKeyframe) {
+	for (UInt32 size : { 11u * 1024, 100u * 1024, 1024u * 1024 }) {
+		vector<Packet> received(Received(size));
+		vector<UInt8> output(size); // buffer of the RTMFP_Read caller
+		UInt32 count(100 * 1024 * 1024 / size);
+		// Before : first fragment copied and the following ones appended, then the message copied to the reader
+		double concatenated(UnitTest::Rate(count, [&](UInt32) {
+			shared<Buffer> pMessage(new Buffer(received.front().size(), received.front().data()));
+			for (UInt32 i = 1; i < received.size(); ++i)
+				pMessage->append(received[i].data(), received[i].size());
+			memcpy(output.data(), pMessage->data(), pMessage->size());
+		}));
+		// After : fragments referenced, copied only to the reader
+		double referenced(UnitTest::Rate(count, [&](UInt32) {
+			RTMFP::Fragments fragments;
+			for (const Packet& fragment : received)
+				fragments.add(fragment);
+			BinaryWriter writer(output.data(), size);
+			fragments.write(writer, 0, fragments.bytes);
+		}));
+		printf("\tkeyframe of %u KB : %.1fus concatenated, %.1fus referenced (x%.2f)\n", size / 1024, 1e6 / concatenated, 1e6 / referenced, referenced / concatenated);
+	}
+}
@@ -0,0 +1,69 @@
+/*
+Copyright 2016 Thomas Jammet
+mathieu.poux[a]gmail.com
+jammetthomas[a]gmail.com
+
+This file is part of Librtmfp.
+
+Librtmfp is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Librtmfp is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with Librtmfp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "UnitTest.h"
+#include "Base/SPSCQueue.h"
+#include <thread>
+
+using namespace Base;
+using namespace std;
+
+ADD_TEST(SPSCQueueCapacity) {
+	SPSCQueue<shared<UInt32>> queue(5);
+	CHECK(queue.capacity() == 8 && queue.empty());
+	shared<UInt32> pValue(new UInt32(0));
+	// Several turns of the ring : full at the capacity, the values popped are released by the queue
+	for (UInt32 turn = 0; turn < 3; ++turn) {
+		for (UInt32 i = 0; i < queue.capacity(); ++i)
+			CHECK(queue.push(shared<UInt32>(pValue)));
+		CHECK(!queue.push(shared<UInt32>(pValue)) && queue.size() == queue.capacity());
+		CHECK(pValue.use_count() == 1 + queue.capacity());
+		shared<UInt32> pPopped;
+		while (queue.pop(pPopped))
+			pPopped.reset();
+		CHECK(queue.empty() && !queue.size() && pValue.use_count() == 1);
+	}
+	CHECK(SPSCQueue<UInt32>(1024).capacity() == 1024 && SPSCQueue<UInt32>(1).capacity() == 1);
+}
+
+ADD_TEST(SPSCQueueThreads) {
+	// The consumer gets all the values in order while the producer fills the ring
+	enum { COUNT = 1000000 };
+	SPSCQueue<UInt32> queue(64);
+	thread producer([&queue]() {
+		for (UInt32 value = 0; value < COUNT; ++value) {
+			while (!queue.push(UInt32(value)))
+				this_thread::yield();
+		}
+	});
+	UInt32 expected(0), value;
+	bool ordered(true);
+	while (expected < COUNT) {
+		if (!queue.pop(value)) {
+			this_thread::yield();
+			continue;
+		}
+		if (value != expected++)
+			ordered = false;
+	}
+	producer.join();
+	CHECK(ordered && queue.empty());
+}
@@ -0,0 +1,490 @@
+/*
+Copyright 2016 Thomas Jammet
+mathieu.poux[a]gmail.com
+jammetthomas[a]gmail.com
+
+This file is part of Librtmfp.
+
+Librtmfp is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Librtmfp is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with Librtmfp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "UnitTest.h"
+#include "RTMFPSender.h"
+#include <string>
+#include <map>
+#include <set>
+#include <random>
+#include <thread>
+
+using namespace Base;
+using namespace std;
+
+namespace {
+
+// Pacer scheduled on the thread which calls raise() (as the invoker thread)
+struct Pacing : virtual Object {
+	Pacing() : handler(signal), pacer(handler, timer) {}
+	~Pacing() { pacer.clear(); }
+	// Schedule the pacing delays requested and queue the runners whose delay is elapsed
+	void raise() { handler.flush(); timer.raise(); }
+
+	Signal		signal;
+	Handler		handler;
+	Timer		timer;
+	RTMFPPacer	pacer;
+};
+
+struct TestSender : RTMFPSender, virtual Object {
+	TestSender(RTMFPPacer& pacer, const shared<Socket>& pSocket, const SocketAddress& address) : RTMFPSender("TestSender", 0x89) {
+		pSession.reset(new Session(0, make_shared<RTMFP::Engine>(BIN "Adobe Systems 02"), pSocket, 0, 0, 0, pacer));
+		this->address = address;
+	}
+	using RTMFPSender::send;
+	using RTMFPSender::sendBatch;
+};
+
+struct Loopback : virtual Object {
+	Loopback() : pSender(new Socket(Socket::TYPE_DATAGRAM)), receiver(Socket::TYPE_DATAGRAM) {
+		Exception ex;
+		CHECK(receiver.bind(ex, IPAddress::Loopback()) && receiver.setRecvBufferSize(ex, 0x400000) && receiver.setNonBlockingMode(ex, true));
+		address.set(IPAddress::Loopback(), receiver.address().port());
+	}
+	// Count the datagrams received, check their size
+	UInt32 receive(UInt32 size) {
+		UInt8 buffer[RTMFP::SIZE_PACKET + 0x10];
+		SocketAddress from;
+		Exception ex;
+		UInt32 count(0);
+		int received;
+		while ((received = receiver.receiveFrom(ex, buffer, sizeof(buffer), from)) > 0) {
+			CHECK(UInt32(received) == size);
+			++count;
+		}
+		return count;
+	}
+	shared<Socket>	pSender;
+	Socket			receiver;
+	SocketAddress	address;
+};
+
+}
+
+ADD_TEST(SenderBatchOwnsPackets) {
+	Pacing pacing;
+	Loopback loopback;
+	TestSender sender(pacing.pacer, loopback.pSender, loopback.address);
+	vector<Packet>& batch(sender.pSession->batch);
+	UInt8 data[RTMFP::SIZE_PACKET];
+	// A temporary packet referencing data released right after must be copied by the batch
+	for (UInt32 i = 0; i < Socket::BATCH_MAX; ++i) {
+		memset(data, UInt8(i), sizeof(data));
+		sender.send(Packet(data, sizeof(data)));
+	}
+	memset(data, 0xFF, sizeof(data));
+	CHECK(batch.size() == Socket::BATCH_MAX);
+	for (UInt32 i = 0; i < batch.size(); ++i)
+		CHECK(batch[i].buffer() && batch[i].size() == sizeof(data) && batch[i].data()[0] == UInt8(i) && batch[i].data()[sizeof(data) - 1] == UInt8(i));
+	// A buffered packet is shared, and stays valid once the writer has released it
+	const UInt8* first(batch.front().data());
+	{
+		shared<Buffer> pBuffer(new Buffer(sizeof(data)));
+		memset(pBuffer->data(), 0xAB, sizeof(data));
+		Packet packet(pBuffer);
+		// batch full, sent before to add the packet (without reallocation)
+		sender.send(packet);
+	}
+	CHECK(batch.size() == 1 && batch.capacity() == Socket::BATCH_MAX && batch.front().data() != first);
+	CHECK(batch.front().data()[0] == 0xAB && batch.front().buffer().unique());
+	sender.sendBatch();
+	CHECK(batch.empty());
+	CHECK(loopback.receive(sizeof(data)) == Socket::BATCH_MAX + 1);
+}
+
+namespace {
+
+// Add count reliable packets of one fragment to the queue
+void Fill(RTMFPSender::Queue& queue, UInt32 count) {
+	while (count--) {
+		shared<Buffer> pBuffer(new Buffer(100));
+		queue.emplace_back(new RTMFPSender::Packet(Packet(pBuffer), 1, true, make_shared<bool>(false)));
+		++queue.stage;
+	}
+}
+
+// Run a sender of the session out of a thread queue (blocked queues are flushed immediatly)
+void Run(const TestSender& session, RTMFPSender* pSender) {
+	shared<RTMFPSender> pRunner(pSender);
+	pRunner->pSession = session.pSession;
+	pRunner->address = session.address;
+	Exception ex;
+	CHECK(((Runner&)*pRunner).run(ex));
+}
+
+}
+
+ADD_TEST(SenderInFlightByQueue) {
+	Pacing pacing;
+	Loopback loopback;
+	TestSender sender(pacing.pacer, loopback.pSender, loopback.address);
+	RTMFPSender::Session& session(*sender.pSession);
+	UInt32 window(session.pCongestion->window());
+	CHECK(window == RTMFPCongestion::INIT_WINDOW);
+	shared<RTMFPSender::Queue> pA(new RTMFPSender::Queue(2, 0, string("A"))), pB(new RTMFPSender::Queue(3, 0, string("B")));
+	Fill(*pA, window - 2);
+	Fill(*pB, 4);
+	Run(sender, new RTMFPFlusher(0x89, pA));
+	CHECK(pA->inFlight == window - 2 && session.inFlight == window - 2 && pA->empty());
+	// B is blocked by the congestion window, its flusher holds it (the writer doesn't touch a queue which is not unique)
+	Run(sender, new RTMFPFlusher(0x89, pB));
+	CHECK(pB->inFlight == 2 && session.inFlight == window && pB->size() == 2);
+	CHECK(pB->blocked && session.blocked.size() == 1 && !pB.unique());
+	// Acknowledgment of A opens the window, B is flushed by its own flusher
+	Run(sender, new RTMFPAcquiter(0x89, pA, 2, RTMFPSender::Losts()));
+	CHECK(pA->inFlight == window - 4 && pA->sending.size() == window - 4);
+	CHECK(pB->inFlight == 4 && pB->empty() && !pB->blocked && session.blocked.empty() && pB.unique());
+	CHECK(session.inFlight == window);
+	// Timeout of A releases only the packets of A
+	Run(sender, new RTMFPRepeater(0x89, pA));
+	CHECK(pA->inFlight == 0 && pB->inFlight == 4 && session.inFlight == 4);
+	// An acknowledgment of the repeated packets doesn't release them twice
+	Run(sender, new RTMFPAcquiter(0x89, pA, window - 2, RTMFPSender::Losts()));
+	CHECK(pA->sending.empty() && session.inFlight == 4);
+	// Closed writer B gives back its packets in flight
+	Run(sender, new RTMFPReleaser(0x89, pB));
+	CHECK(pB->inFlight == 0 && pB->sending.empty() && session.inFlight == 0);
+	loopback.receive(100);
+}
+
+ADD_BENCH(SenderPacketsPerSecond) {
+	enum { COUNT = 100000 };
+	Loopback loopback;
+	shared<Buffer> pBuffer(new Buffer(RTMFP::SIZE_PACKET));
+	memset(pBuffer->data(), 0, pBuffer->size());
+	Packet datagram(pBuffer);
+	// One system call by datagram (RTMFP::Send of a packet)
+	double single = UnitTest::Rate(COUNT, [&](UInt32 i) {
+		RTMFP::Send(*loopback.pSender, datagram, loopback.address);
+		if ((i & 0xFF) == 0xFF)
+			loopback.receive(datagram.size());
+	});
+	loopback.receive(datagram.size());
+	// Batches of BATCH_MAX datagrams (sendmmsg)
+	vector<Packet> batch(Socket::BATCH_MAX, datagram);
+	double batched = UnitTest::Rate(COUNT / Socket::BATCH_MAX, [&](UInt32 i) {
+		RTMFP::Send(*loopback.pSender, batch.data(), batch.size(), loopback.address);
+		if ((i & 0x3) == 0x3)
+			loopback.receive(datagram.size());
+	}) * Socket::BATCH_MAX;
+	loopback.receive(datagram.size());
+	printf("\t%u bytes datagrams, %.0f packets/s with one system call each, %.0f packets/s by batches of %u (x%.2f)\n", datagram.size(), single, batched, Socket::BATCH_MAX, batched / single);
+}
+
+namespace {
+
+Int64 Microseconds() { return chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now().time_since_epoch()).count(); }
+
+/*!
+Transfer of reliable messages by 2 writers of a session through an emulated bottleneck on loopback:
+the datagrams received are decoded, delayed, dropped (randomly or when the buffer of the link is full)
+and acknowledged as the peer would do it, the sending side is the real RTMFPSender one.
+The transfer runs step by step in a thread queue to let the pacer resume the sending between the steps */
+struct LossyTransfer : Loopback, virtual Object {
+	enum {
+		RATE = 2000, // packets/s of the link (~19 Mbit/s)
+		DELAY = 20000, // one way delay in usec
+		BUFFER = 60, // packets queued by the link before to drop
+		MESSAGE = 1000, // size of the messages
+		WRITERS = 2
+	};
+	LossyTransfer(UInt8 congestionType, double loss, UInt16 pacingBurst = 0) : _loss(loss), _random(42), _linkFree(0), _end(0), bytes(0), dropped(0),
+		_sender(_pacing.pacer, pSender, address), _engine(BIN "Adobe Systems 02"), _pStep(new Step(*this)), _thread("LossyTransfer") {
+		_sender.pSession.reset(new RTMFPSender::Session(0, make_shared<RTMFP::Engine>(BIN "Adobe Systems 02"), pSender, 0, congestionType, pacingBurst, _pacing.pacer));
+		shared<Buffer> pPayload(new Buffer(MESSAGE));
+		memset(pPayload->data(), 0, MESSAGE);
+		_payload = pPayload;
+		for (UInt8 i = 0; i < WRITERS; ++i)
+			_writers[i + 2].pQueue.reset(new RTMFPSender::Queue(i + 2, 0, string("\x00\x54\x43\x04\x00", 5)));
+	}
+
+	// Run the transfer during duration msec, return the goodput in Mbit/s
+	double run(UInt32 duration) {
+		Int64 start(Microseconds());
+		_end = start + duration * 1000ll;
+		Exception ex;
+		CHECK(_thread.queue(ex, _pStep));
+		_done.wait();
+		if (_pFailure)
+			throw UnitTest::Failure(*_pFailure);
+		return bytes * 8.0 / (Microseconds() - start);
+	}
+
+	RTMFPSender::Session&	session() { return *_sender.pSession; }
+	UInt64					bytes; // payload received (without duplicates)
+	UInt32					dropped; // datagrams dropped by the link
+
+private:
+	struct Writer {
+		Writer() : receivedAck(0), received(0), stageAck(0), lostStage(0), repeatTime(0), repeatDelay(RTMFP::RTO_MIN) {}
+		shared<RTMFPSender::Queue>	pQueue;
+		// receiver side
+		set<UInt64>					stages; // received after receivedAck
+		UInt64						receivedAck; // greatest stage received in order
+		UInt64						received; // greatest stage received
+		// sender side (as RTMFPWriter)
+		UInt64						stageAck;
+		UInt64						lostStage;
+		Int64						repeatTime;
+		UInt32						repeatDelay;
+		map<UInt64, Int64>			sendTimes; // first emission of the stages not acknowledged
+	};
+	struct Fragment {
+		Fragment(UInt64 writer, UInt64 stage, UInt32 size) : writer(writer), stage(stage), size(size) {}
+		UInt64 writer;
+		UInt64 stage;
+		UInt32 size;
+	};
+	struct Ack {
+		UInt64					writer;
+		UInt64					stageAck;
+		RTMFPSender::Losts		losts;
+	};
+	struct Step : Runner, virtual Object {
+		Step(LossyTransfer& transfer) : Runner("LossyTransfer"), _transfer(transfer) {}
+		bool run(Exception& ex) { return _transfer.step(ex); }
+	private:
+		LossyTransfer& _transfer;
+	};
+
+	// One step of the transfer, queued again until the end
+	bool step(Exception& ex) {
+		Int64 now(Microseconds());
+		if (now >= _end) {
+			_done.set();
+			return true;
+		}
+		try {
+			_pacing.raise();
+			bool busy(write());
+			busy |= receive(now);
+			busy |= deliver(now);
+			busy |= acknowledge(now);
+			busy |= repeat(now);
+			if (!busy)
+				this_thread::sleep_for(chrono::microseconds(100));
+		} catch (UnitTest::Failure& failure) {
+			_pFailure.reset(new UnitTest::Failure(failure));
+			_done.set();
+			return true;
+		}
+		return ThreadQueue::Current()->queue(ex, _pStep);
+	}
+
+	void run(RTMFPSender* pSender) { Run(_sender, pSender); }
+
+	// Keep the queues of the writers fed as a writer always having messages to send
+	bool write() {
+		bool busy(false);
+		for (auto& it : _writers) {
+			if (it.second.pQueue->size() >= 16)
+				continue;
+			RTMFPMessenger* pMessenger(new RTMFPMessenger(0x89, it.second.pQueue));
+			for (UInt8 i = 0; i < 16; ++i)
+				pMessenger->newMessage(true, _payload);
+			run(pMessenger);
+			busy = true;
+		}
+		return busy;
+	}
+
+	// Decode the datagrams sent to put their fragments on the link
+	bool receive(Int64 now) {
+		UInt8 data[RTMFP::SIZE_PACKET + 0x10];
+		SocketAddress from;
+		Exception ex;
+		int size;
+		bool busy(false);
+		while ((size = receiver.receiveFrom(ex, data, sizeof(data), from)) > 4) {
+			busy = true;
+			Buffer buffer(size - 4, data + 4);
+			CHECK(_engine.decode(ex, buffer, from));
+			vector<Fragment> fragments;
+			BinaryReader reader(buffer.data(), buffer.size());
+			if ((reader.read8() | 0xF0) == 0xFD)
+				reader.next(2); // echo time
+			reader.next(2); // time
+			UInt64 writer(0), stage(0);
+			while (reader.available()) {
+				UInt8 type(reader.read8());
+				if (type == 0xFF)
+					break; // padding
+				UInt16 size(reader.read16());
+				BinaryReader chunk(reader.current(), size);
+				reader.next(size);
+				if (type == 0x10) {
+					UInt8 flags(chunk.read8());
+					writer = chunk.read7BitLongValue();
+					stage = chunk.read7BitLongValue();
+					chunk.read7BitLongValue(); // delta
+					if (flags & RTMFP::MESSAGE_OPTIONS) {
+						while (UInt8 length = chunk.read8())
+							chunk.next(length);
+					}
+				} else if (type == 0x11) {
+					chunk.read8();
+					++stage;
+				} else
+					continue;
+				_writers[writer].sendTimes.emplace(stage, now);
+				fragments.emplace_back(writer, stage, chunk.available());
+			}
+			// Bottleneck : a queue of BUFFER packets sent at RATE, random losses
+			Int64 service(1000000 / RATE);
+			if (_linkFree < now)
+				_linkFree = now;
+			if ((_linkFree - now) / service >= BUFFER || uniform_real_distribution<double>()(_random) < _loss) {
+				++dropped;
+				continue;
+			}
+			_linkFree += service;
+			_arrivals.emplace(_linkFree + DELAY, move(fragments));
+		}
+		return busy;
+	}
+
+	// Receive the fragments arrived, and acknowledge them
+	bool deliver(Int64 now) {
+		bool busy(false);
+		while (!_arrivals.empty() && _arrivals.begin()->first <= now) {
+			busy = true;
+			set<UInt64> writers;
+			for (Fragment& fragment : _arrivals.begin()->second) {
+				Writer& writer(_writers[fragment.writer]);
+				writers.emplace(fragment.writer);
+				if (fragment.stage <= writer.receivedAck || !writer.stages.emplace(fragment.stage).second)
+					continue; // duplicate
+				bytes += fragment.size;
+				if (fragment.stage > writer.received)
+					writer.received = fragment.stage;
+				while (!writer.stages.empty() && *writer.stages.begin() == writer.receivedAck + 1) {
+					++writer.receivedAck;
+					writer.stages.erase(writer.stages.begin());
+				}
+			}
+			_arrivals.erase(_arrivals.begin());
+			for (UInt64 id : writers) {
+				Writer& writer(_writers[id]);
+				Ack& ack(_acks.emplace(now + DELAY, Ack())->second);
+				ack.writer = id;
+				ack.stageAck = writer.receivedAck;
+				ack.losts.stageReceived = writer.received;
+				UInt64 next(writer.receivedAck + 1);
+				for (UInt64 stage : writer.stages) {
+					if (stage > next)
+						ack.losts.emplace_back(next, stage - 1);
+					next = stage + 1;
+				}
+			}
+		}
+		return busy;
+	}
+
+	// Acknowledgments as RTMFPWriter::acquit
+	bool acknowledge(Int64 now) {
+		bool busy(false);
+		while (!_acks.empty() && _acks.begin()->first <= now) {
+			busy = true;
+			Ack& ack(_acks.begin()->second);
+			Writer& writer(_writers[ack.writer]);
+			if (ack.stageAck > writer.stageAck) {
+				auto it(writer.sendTimes.find(ack.stageAck));
+				if (it != writer.sendTimes.end()) { // as FlowManager::setPing
+					UInt32 rtt(UInt32((now - it->second) / 1000) + 1);
+					session().rttSample = rtt;
+					session().rtt = session().rtt ? (7 * session().rtt + rtt) / 8 : rtt;
+				}
+				writer.sendTimes.erase(writer.sendTimes.begin(), writer.sendTimes.upper_bound(ack.stageAck));
+				writer.stageAck = ack.stageAck;
+				writer.repeatDelay = RTMFP::RTO_MIN;
+				writer.repeatTime = now;
+				run(new RTMFPAcquiter(0x89, writer.pQueue, ack.stageAck, RTMFPSender::Losts(ack.losts)));
+			}
+			if (!ack.losts.empty() && ack.losts.back().second > writer.lostStage) {
+				UInt64 stageFrom(writer.lostStage > writer.stageAck ? writer.lostStage : writer.stageAck);
+				writer.lostStage = ack.losts.back().second;
+				run(new RTMFPRepeater(0x89, writer.pQueue, move(ack.losts), stageFrom));
+			}
+			_acks.erase(_acks.begin());
+		}
+		return busy;
+	}
+
+	// Timeouts as RTMFPWriter::repeatMessages
+	bool repeat(Int64 now) {
+		bool busy(false);
+		for (auto& it : _writers) {
+			Writer& writer(it.second);
+			if (writer.pQueue->sending.empty() || (now - writer.repeatTime) < writer.repeatDelay * 1000ll)
+				continue;
+			writer.repeatTime = now;
+			writer.repeatDelay = writer.repeatDelay < 7072 ? UInt32(writer.repeatDelay * 1.4142) : 10000;
+			run(new RTMFPRepeater(0x89, writer.pQueue));
+			busy = true;
+		}
+		return busy;
+	}
+
+	double							_loss;
+	mt19937							_random;
+	Int64							_linkFree;
+	Int64							_end;
+	Pacing							_pacing;
+	TestSender						_sender;
+	RTMFP::Engine					_engine;
+	Packet							_payload;
+	map<UInt64, Writer>				_writers;
+	multimap<Int64, vector<Fragment>>	_arrivals;
+	multimap<Int64, Ack>			_acks;
+	unique<UnitTest::Failure>		_pFailure;
+	Signal							_done;
+	shared<Step>					_pStep;
+	ThreadQueue						_thread; // last to be stopped first
+};
+
+}
+
+ADD_BENCH(SenderLossyLoopback) {
+	printf("\tlink %u packets/s, rtt %u ms, buffer %u packets, %u writers\n", LossyTransfer::RATE, LossyTransfer::DELAY / 500, LossyTransfer::BUFFER, LossyTransfer::WRITERS);
+	for (double loss : { 0.0, 0.01, 0.05 }) {
+		for (UInt8 type : { RTMFP::CONGESTION_LOSS, RTMFP::CONGESTION_DELAY }) {
+			LossyTransfer transfer(type, loss);
+			double goodput(transfer.run(3000));
+			RTMFPSender::Session& session(transfer.session());
+			printf("\t%.0f%% loss, %s-based : %.2f Mbit/s, %u dropped, %llu repeated (%llu useful), window %u\n", loss * 100, type == RTMFP::CONGESTION_LOSS ? "loss" : "delay",
+				goodput, transfer.dropped, (unsigned long long)session.repeats.load(), (unsigned long long)session.usefulRepeats.load(), session.pCongestion->window());
+		}
+	}
+}
+
+ADD_BENCH(SenderPacing) {
+	printf("\tlink %u packets/s, rtt %u ms, buffer %u packets, %u writers, loss-based congestion\n", LossyTransfer::RATE, LossyTransfer::DELAY / 500, LossyTransfer::BUFFER, LossyTransfer::WRITERS);
+	for (double loss : { 0.0, 0.01 }) {
+		for (UInt16 burst : { 0, 4 }) {
+			LossyTransfer transfer(RTMFP::CONGESTION_LOSS, loss, burst);
+			double goodput(transfer.run(3000));
+			RTMFPSender::Session& session(transfer.session());
+			printf("\t%.0f%% loss, %s : %.2f Mbit/s, %u dropped, %llu repeated (%llu useful), window %u\n", loss * 100, burst ? "paced by 4" : "bursts",
+				goodput, transfer.dropped, (unsigned long long)session.repeats.load(), (unsigned long long)session.usefulRepeats.load(), session.pCongestion->window());
+		}
+	}
+}
@@ -0,0 +1,57 @@
+/*
+Copyright 2016 Thomas Jammet
+mathieu.poux[a]gmail.com
+jammetthomas[a]gmail.com
+
+This file is part of Librtmfp.
+
+Librtmfp is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Librtmfp is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with Librtmfp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "UnitTest.h"
+#include "Base/Socket.h"
+
+using namespace Base;
+using namespace std;
+
+ADD_TEST(SocketReceiveTruncated) {
+	Exception ex;
+	Socket receiver(Socket::TYPE_DATAGRAM), sender(Socket::TYPE_DATAGRAM);
+	CHECK(receiver.bind(ex, IPAddress::Loopback()) && receiver.setNonBlockingMode(ex, true));
+	SocketAddress address(IPAddress::Loopback(), receiver.address().port());
+	enum { SIZE = 64, COUNT = 4 };
+	// a datagram bigger than the buffers between two valid datagrams
+	UInt8 data[SIZE * 2];
+	memset(data, 1, SIZE);
+	CHECK(sender.sendTo(ex, data, SIZE, address) == SIZE);
+	memset(data, 2, sizeof(data));
+	CHECK(sender.sendTo(ex, data, sizeof(data), address) == sizeof(data));
+	memset(data, 3, SIZE);
+	CHECK(sender.sendTo(ex, data, SIZE - 1, address) == SIZE - 1);
+
+	UInt8 slots[COUNT][SIZE];
+	UInt8* buffers[COUNT] = { slots[0], slots[1], slots[2], slots[3] };
+	UInt32 sizes[COUNT];
+	SocketAddress addresses[COUNT];
+	int received(0);
+	while (received < 3) {
+		int result = receiver.receiveFrom(ex, buffers + received, SIZE, COUNT - received, sizes + received, addresses + received);
+		CHECK(result > 0);
+		received += result;
+	}
+	CHECK(sizes[0] == SIZE && slots[0][0] == 1 && slots[0][SIZE - 1] == 1);
+	CHECK(sizes[1] > SIZE); // truncated
+	CHECK(sizes[2] == SIZE - 1 && slots[2][0] == 3 && slots[2][SIZE - 2] == 3);
+	CHECK(addresses[2].port() == sender.address().port());
+}
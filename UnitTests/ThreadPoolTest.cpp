@@ -0,0 +1,118 @@
+/*
+Copyright 2016 Thomas Jammet
+mathieu.poux[a]gmail.com
+jammetthomas[a]gmail.com
+
+This file is part of Librtmfp.
+
+Librtmfp is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Librtmfp is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with Librtmfp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "UnitTest.h"
+#include "Base/ThreadPool.h"
+#include <algorithm>
+#include <thread>
+
+using namespace Base;
+using namespace std;
+
+namespace {
+
+typedef chrono::steady_clock Clock;
+
+// Runner which records the delay between its queueing and its start, then works (busy) or blocks during its duration
+struct Job : Runner, virtual Object {
+	Job(Clock::duration duration, Clock::duration& latency, atomic<UInt32>& done, bool blocking = false) : Runner("Job"), _queued(Clock::now()), _duration(duration), _latency(latency), _done(done), _blocking(blocking) {}
+private:
+	bool run(Exception& ex) {
+		Clock::time_point start(Clock::now());
+		_latency = start - _queued;
+		if (_blocking)
+			this_thread::sleep_for(_duration);
+		else
+			while ((Clock::now() - start) < _duration);
+		++_done;
+		return true;
+	}
+	Clock::time_point	_queued;
+	Clock::duration		_duration;
+	Clock::duration&	_latency;
+	atomic<UInt32>&		_done;
+	bool				_blocking;
+};
+
+// Mixed load : some slow runners among short ones, returns the sorted latencies.
+// The slow ones block their thread rather than work, to not measure the processors count of the machine
+vector<Clock::duration> Mixed(bool tracked) {
+	enum { THREADS = 4, COUNT = 5000, SLOW_EACH = 50 }; // 2% of slow runners
+	ThreadPool threadPool(THREADS);
+	vector<Clock::duration> latencies(COUNT);
+	atomic<UInt32> done(0);
+	Exception ex;
+	for (UInt32 i = 0; i < COUNT; ++i) {
+		bool slow(i % SLOW_EACH == 0);
+		shared<Job> pJob(new Job(slow ? chrono::microseconds(20000) : chrono::microseconds(20), latencies[i], done, slow));
+		UInt16 track(0); // new track each time, runners given round-robin and pinned to their thread (former behavior)
+		CHECK(tracked ? threadPool.queue(ex, pJob, track) : threadPool.queue(ex, pJob));
+		this_thread::sleep_for(chrono::microseconds(100)); // arrival rate under the pool capacity
+	}
+	while (done < COUNT)
+		this_thread::sleep_for(chrono::milliseconds(1));
+	threadPool.join();
+	sort(latencies.begin(), latencies.end());
+	return latencies;
+}
+
+double Percentile(const vector<Clock::duration>& latencies, double percent) {
+	return chrono::duration<double, milli>(latencies[UInt32(latencies.size() * percent / 100)]).count();
+}
+
+}
+
+ADD_TEST(ThreadPoolTrackOrder) {
+	// Runners of a track keep their order while untracked runners are stolen around them
+	ThreadPool threadPool(4);
+	enum { COUNT = 2000 };
+	struct Numbered : Runner, virtual Object {
+		Numbered(UInt32 number, vector<UInt32>& numbers, atomic<UInt32>& done) : Runner("Numbered"), _number(number), _numbers(numbers), _done(done) {}
+		bool run(Exception& ex) { _numbers.emplace_back(_number); ++_done; return true; }
+		UInt32				_number;
+		vector<UInt32>&		_numbers;
+		atomic<UInt32>&		_done;
+	};
+	vector<UInt32> numbers[2];
+	Clock::duration latency;
+	atomic<UInt32> done(0);
+	UInt16 tracks[2] = { 0, 0 };
+	Exception ex;
+	for (UInt32 i = 0; i < COUNT; ++i) {
+		CHECK(threadPool.queue(ex, make_shared<Numbered>(i, numbers[i & 1], done), tracks[i & 1]));
+		CHECK(threadPool.queue(ex, make_shared<Job>(chrono::microseconds(i % 100 ? 0 : 1000), latency, done)));
+	}
+	while (done < 2 * COUNT)
+		this_thread::sleep_for(chrono::milliseconds(1));
+	threadPool.join();
+	for (UInt8 i = 0; i < 2; ++i) {
+		CHECK(numbers[i].size() == COUNT / 2);
+		for (UInt32 j = 0; j < numbers[i].size(); ++j)
+			CHECK(numbers[i][j] == 2 * j + i);
+	}
+}
+
+ADD_BENCH(ThreadPoolTailLatency) {
+	vector<Clock::duration> pinned(Mixed(true)), stolen(Mixed(false));
+	printf("\t%u processors, 4 threads, 5000 runners of 20us with 2%% of 20ms\n", Thread::ProcessorCount());
+	for (double percent : { 50.0, 99.0, 99.9 })
+		printf("\tp%g queue to start : %.2fms pinned round-robin, %.2fms stolen\n", percent, Percentile(pinned, percent), Percentile(stolen, percent));
+}
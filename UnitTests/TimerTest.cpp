@@ -0,0 +1,111 @@
+/*
+Copyright 2016 Thomas Jammet
+mathieu.poux[a]gmail.com
+jammetthomas[a]gmail.com
+
+This file is part of Librtmfp.
+
+Librtmfp is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Librtmfp is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with Librtmfp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "UnitTest.h"
+#include "Base/Timer.h"
+#include <thread>
+
+using namespace Base;
+using namespace std;
+
+namespace {
+
+// Timers set, moved, cancelled or raised again by their callback, checked the same way on a Timer of each type
+struct Timers : virtual Object {
+	enum { COUNT = 300 };
+
+	Timers(Timer::Type type) : timer(type), disordered(0), early(0), _last(0) {
+		for (UInt32 i = 0; i < COUNT; ++i) {
+			onTimers.emplace_back(new Timer::OnTimer());
+			Timer::OnTimer& onTimer(*onTimers.back());
+			UInt32 timeout(1 + (i * 7919) % 700); // through the root level and its cascades
+			onTimer = [this, i, timeout](UInt32 delay) {
+				Int64 now(Time::Now());
+				if (now < deadlines[i])
+					++early;
+				if (deadlines[i] + 1 < _last) // raised by order of time (1ms of resolution)
+					++disordered;
+				_last = deadlines[i];
+				++raisings[i];
+				if (i % 5 != 2 || raisings[i] == 3)
+					return 0u;
+				deadlines[i] = now + timeout; // raised again
+				return timeout;
+			};
+			deadlines.emplace_back(Time::Now() + timeout);
+			raisings.emplace_back(0);
+			timer.set(onTimer, timeout);
+			if (i % 5 == 0)
+				timer.set(onTimer, 0); // cancelled
+			else if (i % 5 == 1) {
+				deadlines[i] = Time::Now() + timeout / 2;
+				timer.set(onTimer, timeout / 2 + 1); // moved
+			}
+		}
+	}
+	// Expected raisings of the timer i
+	static UInt32 Expected(UInt32 i) { return i % 5 == 0 ? 0 : (i % 5 == 2 ? 3 : 1); }
+
+	vector<unique<Timer::OnTimer>>		onTimers; // before timer, which resets them on deletion
+	Timer								timer;
+	vector<Int64>						deadlines;
+	vector<UInt32>						raisings;
+	UInt32								disordered;
+	UInt32								early;
+private:
+	Int64								_last;
+};
+
+}
+
+ADD_TEST(TimerWheelMatchesMap) {
+	Timers map(Timer::TYPE_MAP), wheel(Timer::TYPE_WHEEL);
+	// raised together, with the same delays
+	while (map.timer.count() || wheel.timer.count()) {
+		UInt32 delay(map.timer.raise()), wheelDelay(wheel.timer.raise());
+		if (!delay || (wheelDelay && wheelDelay < delay))
+			delay = wheelDelay;
+		if (delay)
+			this_thread::sleep_for(chrono::milliseconds(delay));
+	}
+	for (Timers* pTimers : { &map, &wheel }) {
+		CHECK(!pTimers->early && !pTimers->disordered);
+		for (UInt32 i = 0; i < Timers::COUNT; ++i)
+			CHECK(pTimers->raisings[i] == Timers::Expected(i));
+	}
+}
+
+ADD_BENCH(TimerActive100k) {
+	enum { COUNT = 100000 };
+	vector<unique<Timer::OnTimer>> onTimers;
+	for (UInt32 i = 0; i < COUNT; ++i)
+		onTimers.emplace_back(new Timer::OnTimer([](UInt32) { return 0u; }));
+	for (Timer::Type type : { Timer::TYPE_MAP, Timer::TYPE_WHEEL }) {
+		Timer timer(type);
+		// timeouts from 1ms to 1mn, as the sessions, repeat timers and GroupMedia periods
+		double set(UnitTest::Rate(COUNT, [&](UInt32 i) { timer.set(*onTimers[i], 1 + (i * 7919) % 60000); }));
+		double reset(UnitTest::Rate(COUNT, [&](UInt32 i) { timer.set(*onTimers[i], 1 + (i * 104729) % 60000); }));
+		double raise(UnitTest::Rate(COUNT, [&](UInt32) { timer.raise(); })); // nothing to raise for now (at most some timers of 1ms)
+		double cancel(UnitTest::Rate(COUNT, [&](UInt32 i) { timer.set(*onTimers[i], 0); }));
+		printf("\t%s, %u active timers : set %.0fns, set again %.0fns, raise %.0fns, cancel %.0fns\n", type == Timer::TYPE_MAP ? "map" : "wheel",
+			COUNT, 1e9 / set, 1e9 / reset, 1e9 / raise, 1e9 / cancel);
+	}
+}
@@ -0,0 +1,66 @@
+/*
+Copyright 2016 Thomas Jammet
+mathieu.poux[a]gmail.com
+jammetthomas[a]gmail.com
+
+This file is part of Librtmfp.
+
+Librtmfp is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Librtmfp is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with Librtmfp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include "Base/Mona.h"
+#include <chrono>
+#include <vector>
+
+/**************************************************
+UnitTest registers the checks of the internal classes
+of librtmfp, and their benchmarks (run only on demand)
+*/
+struct UnitTest : virtual Base::Object {
+	typedef void (*Function)();
+
+	UnitTest(const char* name, Function function, bool bench = false) : name(name), function(function), bench(bench) { Tests().emplace_back(this); }
+
+	const char*		name;
+	const Function	function;
+	const bool		bench;
+
+	// Raised by CHECK, stop the test
+	struct Failure {
+		Failure(const char* file, long line, const char* condition) : file(file), line(line), condition(condition) {}
+		const char* file;
+		const long	line;
+		const char* condition;
+	};
+
+	/*!
+	Measure the duration of count iterations of function, returns the count of iterations per second */
+	template<typename FunctionType>
+	static double Rate(Base::UInt32 count, FunctionType&& function) {
+		auto start(std::chrono::steady_clock::now());
+		for (Base::UInt32 i = 0; i < count; ++i)
+			function(i);
+		std::chrono::duration<double> elapsed(std::chrono::steady_clock::now() - start);
+		return elapsed.count() ? (count / elapsed.count()) : 0;
+	}
+
+	static std::vector<UnitTest*>& Tests() { static std::vector<UnitTest*> Tests; return Tests; }
+};
+
+#define CHECK(CONDITION) { if (!(CONDITION)) throw UnitTest::Failure(__FILE__, __LINE__, #CONDITION); }
+
+#define ADD_TEST(NAME) static void NAME(); static UnitTest NAME##Test(#NAME, NAME); static void NAME()
+#define ADD_BENCH(NAME) static void NAME(); static UnitTest NAME##Bench(#NAME, NAME, true); static void NAME()
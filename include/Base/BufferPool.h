@@ -23,24 +23,66 @@ details (or else see http://mozilla.org/MPL/2.0/).
 
 namespace Base {
 
+/*!
+Pool of buffers sorted by size classes (powers of 2 from 64 B to 64 KB), bigger buffers are not pooled.
+Each thread caches some buffers by class in its own magazine to allocate and release without contention,
+magazines exchange buffers by batch with the shared depots of the pool.
+Buffers are not zeroed, and buffers unused during a whole trimming period (10s) are released */
 struct BufferPool : Allocator, virtual Object {
+	enum {
+		MIN_SHIFT = 6, // 64 B
+		MAX_SHIFT = 16, // 64 KB
+		CLASSES = MAX_SHIFT - MIN_SHIFT + 1,
+		MAGAZINE_SIZE = 16 // buffers cached by class in each thread
+	};
+
+	struct Stats {
+		Stats() : allocations(0), reuses(0), requested(0), reserved(0), cached(0), rate(0) {}
+
+		UInt64	allocations; // buffers allocated from the system
+		UInt64	reuses; // buffers reused from the pool
+		UInt64	requested; // bytes requested
+		UInt64	reserved; // bytes given (requested bytes rounded up to the size class)
+		UInt64	cached; // bytes cached in the pool
+		double	rate; // buffers requested per second during the last trimming period
+
+		// Ratio of given bytes lost by the size class rounding
+		double	fragmentation() const { return reserved ? double(reserved - requested) / reserved : 0; }
+	};
 
 	BufferPool(const Timer&	timer);
 	~BufferPool();
 
-	UInt32 available() const { return _buffers.size(); }
+	UInt32 available() const;
 	void   clear();
+	void   stats(Stats& stats) const;
 
 	UInt8* allocate(UInt32& size) const;
 	void   deallocate(UInt8* buffer, UInt32 size) const;
 
 private:
-	mutable std::multimap<UInt32,UInt8*>	_buffers;
-	mutable std::mutex						_mutex;
+	struct Magazine;
+	struct Depot : virtual Object {
+		Depot() : minCount(0) {}
+		std::vector<UInt8*>	buffers;
+		std::mutex			mutex;
+		UInt32				minCount; // minimum number of buffers during the trimming period
+	};
+
+	// Magazine of the current thread
+	Magazine&	magazine() const;
+	// Move count buffers of the class index from the magazine to the depot (magazine must be locked)
+	void		flush(Magazine& magazine, UInt8 index, UInt8 count) const;
+
+	mutable Depot							_depots[CLASSES];
+	mutable std::vector<shared<Magazine>>	_magazines;
+	mutable std::mutex						_mutex; // protect _magazines and _stats
+	const UInt32							_id; // unique identifier of the pool to find its magazine in the thread local storage
+	Stats									_stats; // counters of the released magazines
+	UInt64									_requests; // buffers requested until the last trimming
+	Int64									_time; // time of the last trimming
 	const Timer&							_timer;
 	Timer::OnTimer							_onTimer;
-	mutable UInt32							_minCount;
-	mutable UInt32							_maxSize;
 };
 
 
@@ -53,7 +53,21 @@ struct Crypto : virtual Static {
 	static UInt32 Rotate32(UInt32 value);
 	static UInt64 Rotate64(UInt64 value);
 
-	static UInt16 ComputeChecksum(BinaryReader& reader);
+	static UInt16 ComputeChecksum(BinaryReader& reader) { return ComputeChecksum(reader.current(), reader.available()); }
+	static UInt16 ComputeChecksum(const UInt8* data, UInt32 size) { return FinishChecksum(AddChecksum(0, data, size)); }
+	/*!
+	Add the 16 bits words of data to a partial checksum (with SSE2/AVX2 when available),
+	size must be even except for the last part (its last byte is added as a low byte) */
+	static UInt32 AddChecksum(UInt32 sum, const UInt8* data, UInt32 size);
+	enum ChecksumKernel {
+		CHECKSUM_PORTABLE = 0,
+		CHECKSUM_SSE2,
+		CHECKSUM_AVX2
+	};
+	/*!
+	AddChecksum with a given kernel (to check them), return false if the kernel is not available on this CPU */
+	static bool	  AddChecksum(ChecksumKernel kernel, UInt32& sum, const UInt8* data, UInt32 size);
+	static UInt16 FinishChecksum(UInt32 sum) { return ~UInt16(sum); }
 
 	static UInt32 ComputeCRC32(const UInt8* data, UInt32 size, ROTATE_OPTIONS options =0);
 
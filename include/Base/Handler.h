@@ -20,19 +20,22 @@ details (or else see http://mozilla.org/MPL/2.0/).
 #include "Base/Runner.h"
 #include "Base/Event.h"
 #include "Base/Signal.h"
-#include <deque>
+#include "Base/MPSCQueue.h"
 
 namespace Base {
 
 struct Handler : virtual Object {
-	Handler(Signal& signal) : _signal(signal) {}
+	Handler(Signal& signal) : _signal(signal), _signaled(false) {}
 
+	/*!
+	Queue a runner (lock-free), a runner allocated once can be queued again without allocation once executed */
 	template<typename RunnerType>
 	void queue(const shared<RunnerType>& pRunner) const {
 		FATAL_CHECK(pRunner);
-		std::lock_guard<std::mutex> lock(_mutex);
-		_runners.emplace_back(pRunner);
-		_signal.set();
+		_runners.push(shared<Runner>(pRunner));
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if (!_signaled.exchange(true))
+			_signal.set(); // signal just one time by flush
 	}
 
 	template<typename ResultType, typename BaseType, typename ...Args>
@@ -57,9 +60,9 @@ struct Handler : virtual Object {
 
 private:
 
-	mutable std::mutex					_mutex;
-	mutable std::deque<shared<Runner>>	_runners;
-	Signal&								_signal;
+	mutable MPSCQueue<shared<Runner>, 4096>	_runners;
+	mutable std::atomic<bool>				_signaled;
+	Signal&									_signal;
 };
 
 
@@ -0,0 +1,135 @@
+/*
+This file is a part of MonaSolutions Copyright 2017
+mathieu.poux[a]gmail.com
+jammetthomas[a]gmail.com
+
+This program is free software: you can redistribute it and/or
+modify it under the terms of the the Mozilla Public License v2.0.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+Mozilla Public License v. 2.0 received along this program for more
+details (or else see http://mozilla.org/MPL/2.0/).
+
+*/
+
+#pragma once
+
+#include "Base/Mona.h"
+#include <atomic>
+#include <deque>
+#include <mutex>
+
+namespace Base {
+
+/*!
+Bounded lock-free queue for several producer threads and one consumer thread.
+When the ring is full values go to a locked overflow list until the consumer
+drains it, it is read only once no cell of the ring is reserved, so the order
+of the values of each producer is kept.
+CAPACITY must be a power of 2 */
+template<typename Type, UInt32 CAPACITY>
+struct MPSCQueue : virtual Object {
+	MPSCQueue() : _head(0), _tail(0), _overflowing(false) {
+		for (UInt32 i = 0; i < CAPACITY; ++i)
+			_cells[i].sequence.store(i, std::memory_order_relaxed);
+	}
+
+	/*!
+	Producers: add a value */
+	void push(Type&& value) {
+		if (!_overflowing.load(std::memory_order_acquire) && pushRing(value))
+			return;
+		std::lock_guard<std::mutex> lock(_mutex);
+		_overflow.emplace_back(std::move(value));
+		_overflowing = true;
+	}
+	/*!
+	Consumer: take the oldest value, return false if the queue is empty */
+	bool pop(Type& value) {
+		if (popRing(value))
+			return true;
+		if (!overflowReadable())
+			return false;
+		std::lock_guard<std::mutex> lock(_mutex);
+		if (_overflow.empty())
+			return false;
+		value = std::move(_overflow.front());
+		_overflow.pop_front();
+		if (_overflow.empty())
+			_overflowing = false; // producers can use the ring again
+		return true;
+	}
+	/*!
+	Consumer: copy the oldest value without removing it, return false if the queue is empty */
+	bool peek(Type& value) {
+		Cell& cell(_cells[_head & (CAPACITY - 1)]);
+		if (cell.sequence.load(std::memory_order_acquire) == (_head + 1)) {
+			value = cell.value;
+			return true;
+		}
+		if (!overflowReadable())
+			return false;
+		std::lock_guard<std::mutex> lock(_mutex);
+		if (_overflow.empty())
+			return false;
+		value = _overflow.front();
+		return true;
+	}
+	/*!
+	Consumer: return true if the queue is empty */
+	bool empty() const { return _cells[_head & (CAPACITY - 1)].sequence.load(std::memory_order_acquire) != (_head + 1) && !_overflowing.load(std::memory_order_acquire); }
+
+private:
+	static_assert((CAPACITY & (CAPACITY - 1)) == 0, "MPSCQueue capacity must be a power of 2");
+
+	// Overflow values are older than the ring values only once the ring is drained, a cell reserved
+	// but not written yet can precede a value of the same producer in the overflow
+	bool overflowReadable() const { return _overflowing.load(std::memory_order_acquire) && _tail.load(std::memory_order_acquire) == _head; }
+
+	bool pushRing(Type& value) {
+		Cell* pCell;
+		UInt32 position(_tail.load(std::memory_order_relaxed));
+		for (;;) {
+			pCell = &_cells[position & (CAPACITY - 1)];
+			Int32 delta(Int32(pCell->sequence.load(std::memory_order_acquire) - position));
+			if (!delta) {
+				if (_tail.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+					break; // cell reserved
+			} else if (delta < 0)
+				return false; // full
+			else
+				position = _tail.load(std::memory_order_relaxed);
+		}
+		pCell->value = std::move(value);
+		pCell->sequence.store(position + 1, std::memory_order_release);
+		return true;
+	}
+	bool popRing(Type& value) {
+		Cell& cell(_cells[_head & (CAPACITY - 1)]);
+		if (cell.sequence.load(std::memory_order_acquire) != (_head + 1))
+			return false; // empty (or value not written yet)
+		value = std::move(cell.value);
+		cell.value = Type(); // release resources immediatly
+		cell.sequence.store(_head + CAPACITY, std::memory_order_release);
+		++_head;
+		return true;
+	}
+
+	struct Cell {
+		std::atomic<UInt32>	sequence;
+		Type				value;
+	};
+	Cell					_cells[CAPACITY];
+	UInt32					_head; // used only by the consumer
+	char					_headPadding[64]; // to not share the cache line of the consumer
+	std::atomic<UInt32>		_tail;
+	char					_tailPadding[64]; // to not share the cache line of the producers
+	std::atomic<bool>		_overflowing;
+	std::deque<Type>		_overflow;
+	std::mutex				_mutex; // protect _overflow
+};
+
+
+} // namespace Base
@@ -0,0 +1,74 @@
+/*
+This file is a part of MonaSolutions Copyright 2017
+mathieu.poux[a]gmail.com
+jammetthomas[a]gmail.com
+
+This program is free software: you can redistribute it and/or
+modify it under the terms of the the Mozilla Public License v2.0.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+Mozilla Public License v. 2.0 received along this program for more
+details (or else see http://mozilla.org/MPL/2.0/).
+
+*/
+
+#pragma once
+
+#include "Base/Mona.h"
+#include <atomic>
+
+namespace Base {
+
+/*!
+Bounded lock-free queue between one producer thread and one consumer thread,
+its capacity is set at construction (rounded up to a power of 2) */
+template<typename Type>
+struct SPSCQueue : virtual Object {
+	SPSCQueue(UInt32 capacity) : _capacity(RoundCapacity(capacity)), _values(new Type[_capacity]), _head(0), _tail(0) {}
+
+	/*!
+	Producer: add a value, return false if the queue is full */
+	bool push(Type&& value) {
+		UInt32 tail(_tail.load(std::memory_order_relaxed));
+		if ((tail - _head.load(std::memory_order_acquire)) >= _capacity)
+			return false;
+		_values[tail & (_capacity - 1)] = std::move(value);
+		_tail.store(tail + 1, std::memory_order_release);
+		return true;
+	}
+	/*!
+	Consumer: take the oldest value, return false if the queue is empty */
+	bool pop(Type& value) {
+		UInt32 head(_head.load(std::memory_order_relaxed));
+		if (head == _tail.load(std::memory_order_acquire))
+			return false;
+		Type& slot(_values[head & (_capacity - 1)]);
+		value = std::move(slot);
+		slot = Type(); // release resources immediatly
+		_head.store(head + 1, std::memory_order_release);
+		return true;
+	}
+
+	bool	empty() const { return _head.load(std::memory_order_acquire) == _tail.load(std::memory_order_acquire); }
+	UInt32	size() const { return _tail.load(std::memory_order_acquire) - _head.load(std::memory_order_acquire); }
+	UInt32	capacity() const { return _capacity; }
+
+private:
+	static UInt32 RoundCapacity(UInt32 capacity) {
+		UInt32 power(1);
+		while (power < capacity && power < 0x80000000)
+			power <<= 1;
+		return power;
+	}
+
+	const UInt32				_capacity;
+	std::unique_ptr<Type[]>		_values;
+	std::atomic<UInt32>			_head; // consumer position
+	char						_padding[64]; // to not share the cache line of the positions
+	std::atomic<UInt32>			_tail; // producer position
+};
+
+
+} // namespace Base
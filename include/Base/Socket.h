@@ -22,6 +22,9 @@ details (or else see http://mozilla.org/MPL/2.0/).
 #include "Base/Packet.h"
 #include "Base/Handler.h"
 #include <deque>
+#if defined(__linux__)
+#define HAS_MMSG 1 // sendmmsg & recvmmsg available
+#endif
 
 namespace Base {
 
@@ -50,7 +53,8 @@ struct Socket : virtual Object, Net::Stats {
 	};
 
 	enum {
-		BACKLOG_MAX = 200 // blacklog maximum, see http://tangentsoft.net/wskfaq/advanced.html#backlog
+		BACKLOG_MAX = 200, // blacklog maximum, see http://tangentsoft.net/wskfaq/advanced.html#backlog
+		BATCH_MAX = 64 // max datagrams sent or received with one system call
 	};
 
 	/*!
@@ -121,6 +125,11 @@ struct Socket : virtual Object, Net::Stats {
 	
 	int			 receive(Exception& ex, void* buffer, UInt32 size, int flags = 0) { return receive(ex, buffer, size, flags, NULL); }
 	int			 receiveFrom(Exception& ex, void* buffer, UInt32 size, SocketAddress& address, int flags = 0)  { return receive(ex, buffer, size, flags, &address); }
+	/*!
+	Receive several datagrams with one system call when possible (recvmmsg), datagram i is written in buffers[i] of size bytes,
+	sizes[i] gets the real datagram size which is greater than size when the datagram has been truncated
+	Returns count of datagrams received (sizes and addresses filled) or -1 if error */
+	int			 receiveFrom(Exception& ex, UInt8* const* buffers, UInt32 size, UInt32 count, UInt32* sizes, SocketAddress* addresses, int flags = 0);
 
 	int			 send(Exception& ex, const void* data, UInt32 size, int flags = 0) { return sendTo(ex, data, size, SocketAddress::Wildcard(), flags); }
 	virtual int	 sendTo(Exception& ex, const void* data, UInt32 size, const SocketAddress& address, int flags=0);
@@ -130,6 +139,10 @@ struct Socket : virtual Object, Net::Stats {
 	Returns size of data sent immediatly (or -1 if error, for TCP socket a SHUTDOWN_SEND is done, so socket will be disconnected) */
 	int			 write(Exception& ex, const Packet& packet, int flags = 0) { return write(ex, packet, SocketAddress::Wildcard(), flags); }
 	int			 write(Exception& ex, const Packet& packet, const SocketAddress& address, int flags = 0);
+	/*!
+	Sequential and safe writing of several datagrams to the same address, sent with one system call when possible (sendmmsg)
+	Returns count of packets sent or queued (or -1 if error on the first packet) */
+	int			 write(Exception& ex, const Packet* packets, UInt32 count, const SocketAddress& address, int flags = 0);
 
 	virtual bool flush(Exception& ex);
 
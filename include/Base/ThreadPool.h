@@ -19,13 +19,19 @@ details (or else see http://mozilla.org/MPL/2.0/).
 #include "Base/Mona.h"
 #include "Base/ThreadQueue.h"
 #include <vector>
+#include <deque>
 
 namespace Base {
 
+/*!
+Pool of threads to execute runners:
+- a runner queued with a track is always executed by the thread of this track, in the queue order
+- a runner queued without track is given to the next thread (round-robin) but can be stolen
+by any other thread which has nothing to do, so a long runner doesn't delay the ones queued after it */
 struct ThreadPool : virtual Object {
 	/*!
 	If threads==0 use ProcessorCount*2 because gives the better result */
-	ThreadPool(UInt16 threads = 0) : _current(0), _threads(threads ? threads : Thread::ProcessorCount()*2) { _size = UInt16(_threads.size()); }
+	ThreadPool(UInt16 threads = 0);
 
 	UInt16	threads() const { return _size; }
 
@@ -35,7 +41,7 @@ struct ThreadPool : virtual Object {
 	template<typename RunnerType>
 	bool  queue(Exception& ex, const shared<RunnerType>& pRunner) const {
 		FATAL_CHECK(pRunner);
-		return _threads[_current++%_size].queue(ex, pRunner);
+		return queue(ex, shared<Runner>(pRunner));
 	}
 
 	template<typename RunnerType>
@@ -54,10 +60,30 @@ struct ThreadPool : virtual Object {
 	}
 
 private:
-	struct Thread : virtual Object, ThreadQueue { Thread() : ThreadQueue("ThreadPool") {} };
+	struct Thread : virtual Object, ThreadQueue {
+		Thread() : ThreadQueue("ThreadPool"), pPool(NULL), index(0), stealable(0) {}
+
+		using ThreadQueue::awake;
+		using ThreadQueue::wake;
+		using ThreadQueue::sleeping;
+
+		const ThreadPool*				pPool;
+		UInt16							index;
+		std::mutex						mutex; // protect runners
+		std::deque<shared<Runner>>		runners; // runners without track, can be stolen by the other threads
+		std::atomic<UInt32>				stealable; // runners.size() readable without lock
+	private:
+		bool pull(shared<Runner>& pRunner) { return pPool->steal(index, pRunner); }
+	};
+
+	bool	queue(Exception& ex, shared<Runner>&& pRunner) const;
+	/*!
+	Take the oldest runner without track, from the thread itself first and then from the following ones */
+	bool	steal(UInt16 index, shared<Runner>& pRunner) const;
 
 	mutable std::vector<Thread>	_threads;
 	mutable std::atomic<UInt16>	_current;
+	mutable std::atomic<UInt32>	_stealable; // runners without track waiting in the whole pool
 	UInt16						_size;
 };
 
@@ -19,31 +19,65 @@ details (or else see http://mozilla.org/MPL/2.0/).
 #include "Base/Mona.h"
 #include "Base/Thread.h"
 #include "Base/Runner.h"
-#include <deque>
+#include "Base/MPSCQueue.h"
 
 namespace Base {
 
 struct ThreadQueue : Thread, virtual Object {
-	ThreadQueue(const char* name) : Thread(name) {}
+	ThreadQueue(const char* name) : Thread(name), _idle(true), _sleeping(false) {}
 	virtual ~ThreadQueue() { stop();	}
 
 	static ThreadQueue*	Current() { return _PCurrent; }
 
 	template<typename RunnerType>
 	bool queue(Exception& ex, const shared<RunnerType>& pRunner) {
-		std::lock_guard<std::mutex> lock(_mutex);
-		if (!start(ex))
+		_runners.push(shared<Runner>(pRunner));
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		return awake(ex);
+	}
+	/*!
+	Return the next runner which will be executed (or null if none), must be called by the thread itself */
+	shared<Runner> next() {
+		shared<Runner> pRunner;
+		_runners.peek(pRunner);
+		return pRunner;
+	}
+
+protected:
+	/*!
+	Start the thread if stopped and wake it up if it waits for a runner, return false if it can't be started */
+	bool awake(Exception& ex) {
+		if (_idle) {
+			// thread not started or stopped after inactivity
+			std::lock_guard<std::mutex> lock(_mutex);
+			if (!start(ex))
+				return false;
+		}
+		wake();
+		return true;
+	}
+	/*!
+	Wake up the thread only if it waits for a runner, return true if it was waiting */
+	bool wake() {
+		if (!_sleeping.exchange(false))
 			return false;
-		_runners.emplace_back(pRunner);
 		wakeUp.set();
 		return true;
 	}
+	bool sleeping() const { return _sleeping; }
 
 private:
+	/*!
+	Called when the queue is empty to get a runner from elsewhere (see ThreadPool),
+	a child class must call awake() after having made a runner available */
+	virtual bool pull(shared<Runner>& pRunner) { return false; }
+
 	bool run(Exception& ex, const volatile bool& stopping);
 
-	std::deque<shared<Runner>>			_runners;
-	std::mutex							_mutex;
+	MPSCQueue<shared<Runner>, 1024>		_runners;
+	std::atomic<bool>					_idle; // true if the thread is stopped (or is stopping after inactivity)
+	std::atomic<bool>					_sleeping; // true if the thread waits for a runner
+	std::mutex							_mutex; // protect the stop/start after inactivity
 	static thread_local ThreadQueue*	_PCurrent;
 };
 
@@ -26,17 +26,21 @@ namespace Base {
 
 
 struct Timer : virtual Object {
-	Timer() : _count(0) {}
+	enum Type {
+		TYPE_MAP = 0, // timers sorted by time, O(log n) to set a timer
+		TYPE_WHEEL // hierarchical timing wheel of 1ms resolution, O(1) to set a timer
+	};
+	Timer(Type type = TYPE_MAP);
 	~Timer();
 
 /*!
 	OnTimer is a function which returns the timeout in ms of next call, or 0 to stop the timer.
 	"count" parameter informs on the number of raised time */
 	struct OnTimer : std::function<UInt32(UInt32 delay)>, virtual Object {
-		OnTimer() : _nextRaising(0), count(0) {}
+		OnTimer() : _nextRaising(0), _pNext(NULL), _pPrevious(NULL), _ppSlot(NULL), count(0) {}
 		// explicit to forbid to pass in "const OnTimer" parameter directly a lambda function
 		template<typename FunctionType>
-		explicit OnTimer(FunctionType&& function) : _nextRaising(0), count(0), std::function<UInt32(UInt32)>(std::move(function)) {}
+		explicit OnTimer(FunctionType&& function) : _nextRaising(0), _pNext(NULL), _pPrevious(NULL), _ppSlot(NULL), count(0), std::function<UInt32(UInt32)>(std::move(function)) {}
 
 		~OnTimer() { if (_nextRaising) FATAL_ERROR("OnTimer function deleting while running"); }
 
@@ -52,11 +56,17 @@ struct Timer : virtual Object {
 
 		const UInt32 count;
 	private:
-		mutable Int64	_nextRaising;
+		mutable Int64			_nextRaising;
+		// TYPE_WHEEL: double linked list of the timers of a same slot
+		mutable const OnTimer*	_pNext;
+		mutable const OnTimer*	_pPrevious;
+		mutable const OnTimer**	_ppSlot;
 
 		friend struct Timer;
 	};
 
+	const Type	type;
+
 	UInt32 count() const { return _count; }
 
 /*!
@@ -69,11 +79,15 @@ struct Timer : virtual Object {
 	UInt32 raise();
 
 private:
+	struct Wheel;
+
 	void add(const OnTimer& onTimer,  UInt32 timeout) const;
 	bool remove(const OnTimer& onTimer, shared<std::set<const OnTimer*>>& pMove) const;
+	UInt32 raiseWheel();
 
 	mutable	UInt32														_count;
 	mutable std::map<Int64, shared<std::set<const OnTimer*>>>	_timers;
+	unique<Wheel>														_pWheel; // TYPE_WHEEL
 };
 
 
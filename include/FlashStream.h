@@ -26,10 +26,12 @@ along with Librtmfp.  If not, see <http://www.gnu.org/licenses/>.
 #include "AMF.h"
 #include "AMFReader.h"
 #include "Base/Packet.h"
+#include "RTMFP.h"
 
 struct FlashHandler : virtual Base::Object {
 	typedef Base::Event<bool(const std::string& code, const std::string& description, Base::UInt16 streamId, Base::UInt64 flowId, double cbHandler)>	ON(Status); // NetConnection or NetStream status event
 	typedef Base::Event<void(Base::UInt16 mediaId, Base::UInt32 time, const Base::Packet& packet, double lostRate, AMF::Type type)>						ON(Media);  // Received when we receive media (audio/video) in server or p2p 1-1
+	typedef Base::Event<bool(Base::UInt16 mediaId, Base::UInt32 time, const RTMFP::Fragments& fragments, double lostRate, AMF::Type type)>				ON(MediaFragments);  // Same as onMedia for a media received in several fragments (not concatenated), return false if not handled
 
 	FlashHandler(Base::UInt16 id, Base::UInt16 mediaId=0) : streamId(id), _mediaId(mediaId) {}
 	virtual ~FlashHandler() {}
@@ -72,6 +74,8 @@ struct FlashStream : FlashHandler, virtual Base::Object {
 
 	// return flase if writer is closed!
 	virtual bool	process(const Base::Packet& packet, Base::UInt64 flowId, Base::UInt64 writerId, double lostRate=0);
+	// Process a message received in several fragments, a media is given to onMediaFragments without concatenation
+	virtual bool	process(const RTMFP::Fragments& fragments, Base::UInt64 flowId, Base::UInt64 writerId, double lostRate=0);
 
 private:
 	virtual bool messageHandler(const std::string& name, AMFReader& message, Base::UInt64 flowId, Base::UInt64 writerId, double callbackHandler);
@@ -42,7 +42,7 @@ lists of RTMFPFlow and RTMFPWriter
 It is the base class of RTMFPSession and P2PSession
 */
 struct FlowManager : RTMFP::Output, BandWriter {
-	FlowManager(bool responder, Invoker& invoker, OnSocketError pOnSocketError, OnStatusEvent pOnStatusEvent);
+	FlowManager(bool responder, Invoker& invoker, OnSocketError pOnSocketError, OnStatusEvent pOnStatusEvent, Base::UInt8 congestionType, Base::UInt16 pacingBurst, const RTMFPFEC::Config& fec);
 
 	virtual ~FlowManager();
 
@@ -57,9 +57,28 @@ struct FlowManager : RTMFP::Output, BandWriter {
 
 	RTMFP::SessionStatus			status; // Session status (stopped, connecting, connected or failed)
 
+	const Base::UInt8				congestionType; // Congestion control used to send packets (RTMFP::CongestionType)
+	const Base::UInt16				pacingBurst; // Max packets sent in a burst, 0 if send pacing is disabled
+	const RTMFPFEC::Config			fec; // Forward error correction offered to the librtmfp peers playing our unreliable media
+
 	// Latency (ping / 2)
 	Base::UInt16					latency() { return _ping >> 1; }
 
+	// Smoothed round trip time in msec (0 until the first measure)
+	Base::UInt32					srtt() const { return _srtt; }
+
+	// Round trip time variation in msec
+	Base::UInt32					rttvar() const { return _rttvar; }
+
+	// Count of packets received with flow data
+	Base::UInt64					dataPackets() const { return _dataPackets; }
+
+	// Count of acknowledgment packets sent
+	Base::UInt64					ackPackets() const { return _ackPackets; }
+
+	// Retransmission efficiency : ratio of useful repeats (packets really lost) on total repeats, 1 if nothing repeated
+	double							repeatEfficiency() const;
+
 	// Return true if the session has failed (we will not send packets anymore)
 	virtual bool					failed() { return (status == RTMFP::FAILED && _closeTime.isElapsed(19000)) || ((status == RTMFP::NEAR_CLOSED) && _closeTime.isElapsed(90000)); }
 
@@ -98,7 +117,8 @@ struct FlowManager : RTMFP::Output, BandWriter {
 
 
 	/* Implementation of RTMFPOutput */
-	Base::UInt32							rto() const { return Base::Net::RTO_INIT; }
+	// Effective retransmission timeout computed from SRTT and RTTVAR (RTO_INIT until the first measure)
+	Base::UInt32							rto() const { return _rto; }
 	// Send function used by RTMFPWriter to send packet with header
 	void									send(const std::shared_ptr<RTMFPSender>& pSender);
 	virtual Base::UInt64					queueing() const { return 0; }
@@ -134,8 +154,8 @@ protected:
 	// Create a flow for special signatures (NetGroup)
 	virtual RTMFPFlow*			createSpecialFlow(Base::Exception& ex, Base::UInt64 id, const std::string& signature, Base::UInt64 idWriterRef) = 0;
 
-	// Manage the flows
-	virtual void				manage();
+	// Manage the flows and writers, return the delay in msec before the next call
+	virtual Base::UInt32		manage();
 
 	// Called when we are connected to the peer/server
 	virtual void				onConnection() = 0;
@@ -184,7 +204,16 @@ private:
 	// Send the waiting messages
 	void												flushWriters();
 
-	// Update the ping value
+	// Send the delayed acknowledgments of the flows in one packet (if possible)
+	void												flushAcks();
+
+	// Send the acknowledgment chunks through the sending session (or directly if not initialized)
+	void												sendAcks(std::shared_ptr<Base::Buffer>& pChunks);
+
+	// Encode and send the acknowledgment buffer
+	void												sendBuffer();
+
+	// Update the ping value and the RTT estimation (SRTT, RTTVAR and RTO)
 	void												setPing(Base::UInt16 time, Base::UInt16 timeEcho);
 
 	// Send the close message (0C if normal, 4C if abrupt)
@@ -194,6 +223,16 @@ private:
 	Base::Time																	_lastPing; // Time since last ping sent
 	Base::Time																	_lastClose; // Time since last close chunk
 	Base::UInt16																_ping; // ping value
+	Base::UInt32																_lastTimeEcho; // last timestamp echo used to measure the RTT
+	Base::UInt32																_srtt; // smoothed round trip time (msec)
+	Base::UInt32																_rttvar; // round trip time variation (msec)
+	Base::UInt32																_rto; // effective retransmission timeout (msec)
+
+	std::set<Base::UInt64>														_ackFlows; // flows waiting for an acknowledgment
+	Base::UInt8																	_ackWaiting; // packets received and not acknowledged
+	Base::Time																	_ackTime; // time of the first packet not acknowledged
+	Base::UInt64																_dataPackets; // packets received with flow data
+	Base::UInt64																_ackPackets; // acknowledgment packets sent
 
 	Base::UInt32																_initiatorTime; // time in msec received from target
 	std::shared_ptr<Base::Buffer>												_pBuffer; // buffer for sending packets
@@ -51,4 +51,6 @@ public:
 
 	// return flase if writer is closed!
 	virtual bool	process(const Base::Packet& packet, Base::UInt64 flowId, Base::UInt64 writerId, double lostRate=0);
+	// NetGroup messages are always concatenated
+	virtual bool	process(const RTMFP::Fragments& fragments, Base::UInt64 flowId, Base::UInt64 writerId, double lostRate=0) { Base::Packet packet; return process(fragments.linearize(packet), flowId, writerId, lostRate); }
 };
@@ -23,8 +23,11 @@ along with Librtmfp.  If not, see <http://www.gnu.org/licenses/>.
 
 #include "Base/IOSocket.h"
 #include "Base/Timer.h"
+#include "Base/BufferPool.h"
+#include "RTMFPPacer.h"
 
-#define DELAY_CONNECTIONS_MANAGER	50 // Delay between each onManage (in msec)
+#define DELAY_CONNECTIONS_MANAGER	50 // Delay between each onManage of a connection which has something to do (in msec)
+#define DELAY_CONNECTIONS_IDLE		5000 // Max delay between each onManage of an idle connection (in msec)
 
 class RTMFPSession;
 class RTMFPLogger;
@@ -33,7 +36,8 @@ public:
 
 	// Create the Invoker
 	// createLogger : if True it will associate a logger instance to the static log class, otherwise it will let the default logger
-	Invoker(bool createLogger=true);
+	// threads : number of threads of the thread pool, 0 for the default value (2 per processor)
+	Invoker(bool createLogger=true, Base::UInt16 threads=0);
 	virtual ~Invoker();
 
 	// Start the socket manager if not started
@@ -49,6 +53,12 @@ public:
 
 	unsigned int	empty();
 
+	// Manage the connection as soon as possible (thread-safe)
+	void			wake(const RTMFPSession& session);
+
+	// Manage the connection in less than delay msec, must be called by the invoker thread (handler)
+	void			schedule(const RTMFPSession& session, Base::UInt32 delay);
+
 	/*** Callback functions ***/
 	void			setLogCallback(void(*onLog)(unsigned int, const char*, long, const char*));
 
@@ -57,19 +67,34 @@ public:
 	void			setInterruptCallback(int(*interruptCb)(void*), void* argument);
 
 	Base::ThreadPool					threadPool;
+	RTMFPPacer							pacer; // wake up the sessions waiting for pacing (scheduled on the timer of the invoker thread)
 	Base::IOSocket						sockets;
 	const Base::Timer&					timer; 
+	const Base::BufferPool&				bufferPool; // allocator of the buffers while the invoker is running
 	const Base::Handler&				handler;
 private:
-	virtual void		manage();
+	struct Manage;
+	// Each connection is managed on its own timer, at the time returned by RTMFPSession::manage()
+	struct Manager : virtual Base::Object {
+		Manager() : next(0) {}
+		Base::Timer::OnTimer	onManage;
+		Base::Int64				next; // time of the next onManage, 0 if not scheduled
+	};
+
+	// Manage the connection now and schedule the next call (create its manager if index is set)
+	void				manage(const RTMFPSession* pSession, unsigned int index = 0);
+	// Manage the connection at index, return the delay before the next call or 0 if it is removed
+	Base::UInt32		manageConnection(unsigned int index);
 	bool				run(Base::Exception& exc, const volatile bool& stopping);
 
 	void				removeConnection(std::map<int, std::shared_ptr<RTMFPSession>>::iterator it);
 	Base::Timer										_timer;
+	Base::BufferPool								_bufferPool;
 	Base::Handler									_handler;
 	int												_lastIndex; // last index of connection
 	std::mutex										_mutexConnections;
 	std::map<int, std::shared_ptr<RTMFPSession>>	_mapConnections;
+	std::map<const RTMFPSession*, Manager>			_managers; // managers of the connections (only accessed by the invoker thread)
 	std::unique_ptr<RTMFPLogger>					_logger; // global logger for librtmfp
 	int												(*_interruptCb)(void*); // global interrupt callback function (NULL by default)
 	void*											_interruptArg; // global interrup callback argument for interrupt function
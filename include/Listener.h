@@ -80,5 +80,4 @@ private:
 	std::shared_ptr<RTMFPWriter>	_pAudioWriter;
 	std::shared_ptr<RTMFPWriter>	_pVideoWriter;
 	bool							_dataInitialized;
-	bool							_reliable;
 };
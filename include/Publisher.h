@@ -39,6 +39,8 @@ struct Publisher : virtual Base::Object {
 	bool					running() const { return _running; }
 	void					stop();
 	Base::UInt32			count() const { return _listeners.size(); }
+	bool					audioReliable() const { return _audioReliable; }
+	bool					videoReliable() const { return _videoReliable; }
 
 	template <typename ListenerType, typename... Args>
 	ListenerType*				addListener(Base::Exception& ex, const std::string& identifier, Args... args) {
@@ -34,6 +34,7 @@ along with Librtmfp.  If not, see <http://www.gnu.org/licenses/>.
 #include "AMFWriter.h"
 #include "Base/Logs.h"
 #include <map>
+#include <deque>
 
 #define RTMFP_LIB_VERSION	0x02010003	// (2.1.3)
 
@@ -68,11 +69,24 @@ struct RTMFP : virtual Base::Static {
 	};
 
 	enum { TIMESTAMP_SCALE = 4 };
-	enum { SENDABLE_MAX = 6 }; // Number of packet max to send before receiving an ack
+	enum { SENDABLE_MAX = 6 }; // Initial number of packets which can be sent before receiving an ack
+	enum CongestionType {
+		CONGESTION_LOSS = 0, // loss-based congestion control (default)
+		CONGESTION_DELAY // delay-based congestion control
+	};
+	enum {
+		RTO_MIN = 250, // minimum ERTO in msec (RFC 7016 3.5.2.2)
+		RTO_MARGIN = 200 // constant added to SRTT + 4*RTTVAR to compute the ERTO
+	};
+	enum {
+		ACK_PACKETS = 4, // max packets with user data received before sending an acknowledgment
+		ACK_DELAY = 50 // max delay in msec before sending an acknowledgment
+	};
 
 	enum {
 		SIZE_HEADER = 11,
 		SIZE_PACKET = 1192,
+		SIZE_BUFFER = SIZE_PACKET + 0x10, // capacity of a packet buffer (+ padding of RTMFP encoding)
 		SIZE_COOKIE = 0x40
 	};
 
@@ -96,13 +110,41 @@ struct RTMFP : virtual Base::Static {
 		FAILED
 	};
 
+	/*!
+	Areas of packets shared (not copied) by a buffer to encode, each one is inserted at its offset in the buffer.
+	The areas are bufferized: they stay valid even if the message is released before the encoding */
+	struct Segments : std::deque<std::pair<Base::UInt32, Base::Packet>>, virtual Base::Object {
+		Segments() : bytes(0) {}
+		Base::UInt32	bytes; // total size of the areas
+
+		void			add(Base::UInt32 offset, const Base::Packet& packet, const Base::UInt8* data, Base::UInt32 size) { emplace_back(std::piecewise_construct, std::forward_as_tuple(offset), std::forward_as_tuple(std::move(packet), data, size)); bytes += size; }
+		void			clear() { std::deque<std::pair<Base::UInt32, Base::Packet>>::clear(); bytes = 0; }
+	};
+
+	/*!
+	Message received in several fragments, each fragment references the datagram received (no copy),
+	they are concatenated only for the consumers which require a contiguous packet */
+	struct Fragments : std::deque<Base::Packet>, virtual Base::Object {
+		Fragments() : bytes(0) {}
+		Base::UInt32	bytes; // total size of the fragments
+
+		void			add(const Base::Packet& packet) { emplace_back(std::move(packet)); bytes += packet.size(); } // bufferize it
+		void			clear() { std::deque<Base::Packet>::clear(); bytes = 0; }
+		// Write size bytes of the fragments from position
+		void			write(Base::BinaryWriter& writer, Base::UInt32 position, Base::UInt32 size) const;
+		// Set packet to the concatenation of the fragments (copied only if there are several fragments)
+		Base::Packet&	linearize(Base::Packet& packet) const;
+	};
+
 	struct Engine : virtual Base::Object {
-		Engine(const Base::UInt8* key) { memcpy(_key, key, KEY_SIZE); EVP_CIPHER_CTX_init(&_context); }
-		Engine(const Engine& engine) { memcpy(_key, engine._key, KEY_SIZE); EVP_CIPHER_CTX_init(&_context); }
-		virtual ~Engine() { EVP_CIPHER_CTX_cleanup(&_context); }
+		Engine(const Base::UInt8* key) : _pEncrypt(NULL), _pDecrypt(NULL) { memcpy(_key, key, KEY_SIZE); }
+		Engine(const Engine& engine) : _pEncrypt(NULL), _pDecrypt(NULL) { memcpy(_key, engine._key, KEY_SIZE); }
+		virtual ~Engine();
 
 		bool							decode(Base::Exception& ex, Base::Buffer& buffer, const Base::SocketAddress& address);
 		std::shared_ptr<Base::Buffer>&	encode(std::shared_ptr<Base::Buffer>& pBuffer, Base::UInt32 farId, const Base::SocketAddress& address);
+		// Encode the buffer with the segments inserted, they are encrypted directly from the packets referenced to a new buffer (segments are cleared)
+		std::shared_ptr<Base::Buffer>&	encode(std::shared_ptr<Base::Buffer>& pBuffer, Segments& segments, Base::UInt32 farId, const Base::SocketAddress& address);
 
 		static bool				Decode(Base::Exception& ex, Base::Buffer& buffer, const Base::SocketAddress& address) { return Default().decode(ex, buffer, address); }
 		static std::shared_ptr<Base::Buffer>&	Encode(std::shared_ptr<Base::Buffer>& pBuffer, Base::UInt32 farId, const Base::SocketAddress& address) { return Default().encode(pBuffer, farId, address); }
@@ -110,9 +152,17 @@ struct RTMFP : virtual Base::Static {
 	private:
 		static Engine& Default() { thread_local Engine Engine(BIN "Adobe Systems 02"); return Engine; }
 
-		enum { KEY_SIZE = 0x10 };
+		// Return the cipher context of the direction, the key is expanded only the first time then just the IV is reset
+		EVP_CIPHER_CTX*					context(bool encrypt);
+
+		enum {
+			KEY_SIZE = 0x10,
+			AES_BLOCK = 0x10,
+			DECODE_PART = 0x100 // bytes decrypted before computing their checksum (multiple of the AES block size)
+		};
 		Base::UInt8						_key[KEY_SIZE];
-		EVP_CIPHER_CTX					_context;
+		EVP_CIPHER_CTX*					_pEncrypt;
+		EVP_CIPHER_CTX*					_pDecrypt;
 	};
 
 	struct Message : virtual Base::Object, Base::Packet {
@@ -143,6 +193,10 @@ struct RTMFP : virtual Base::Static {
 	static void						Pack(Base::Buffer& buffer,Base::UInt32 farId);
 
 	static bool						Send(Base::Socket& socket, const Base::Packet& packet, const Base::SocketAddress& address);
+	// Send several packets to the same address with one system call when possible
+	static bool						Send(Base::Socket& socket, const Base::Packet* packets, Base::UInt32 count, const Base::SocketAddress& address);
+	// Return a packet buffer of size bytes with a SIZE_BUFFER capacity (same size class of the buffer pool for all packets, never reallocated by writing and padding)
+	static std::shared_ptr<Base::Buffer>	NewBuffer(Base::UInt32 size = 0);
 	static Base::Buffer&			InitBuffer(std::shared_ptr<Base::Buffer>& pBuffer, Base::UInt8 marker);
 	static Base::Buffer&			InitBuffer(std::shared_ptr<Base::Buffer>& pBuffer, std::atomic<Base::Int64>& initiatorTime, Base::UInt8 marker);
 	static void						ComputeAsymetricKeys(const Base::Binary& sharedSecret, const Base::UInt8* initiatorNonce,Base::UInt32 initNonceSize, const Base::UInt8* responderNonce,Base::UInt32 respNonceSize, Base::UInt8* requestKey, Base::UInt8* responseKey);
@@ -0,0 +1,108 @@
+/*
+Copyright 2016 Thomas Jammet
+mathieu.poux[a]gmail.com
+jammetthomas[a]gmail.com
+
+This file is part of Librtmfp.
+
+Librtmfp is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Librtmfp is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with Librtmfp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include "Base/Mona.h"
+#include "Base/Time.h"
+#include "RTMFP.h"
+
+/**************************************************
+RTMFPCongestion computes the congestion window of
+a sending session : the number of packets which can
+be in flight (sent but not acknowledged)
+It is not thread safe, it must be used only by the
+sending thread of the session (see RTMFPSender)
+*/
+struct RTMFPCongestion : virtual Base::Object {
+	enum {
+		MIN_WINDOW = 2,
+		INIT_WINDOW = RTMFP::SENDABLE_MAX,
+		MAX_WINDOW = 4096
+	};
+
+	// Create the congestion controller of the given type (RTMFP::CongestionType)
+	static RTMFPCongestion* New(Base::UInt8 type);
+
+	virtual ~RTMFPCongestion() {}
+
+	// Number of packets allowed in flight
+	Base::UInt32	window() const { return _window; }
+	// Slow start threshold
+	Base::UInt32	threshold() const { return _threshold; }
+
+	// Called when packets have been acknowledged, rtt is the smoothed round trip time and sample the last one measured (0 if unknown)
+	virtual void	onAck(Base::UInt32 acked, Base::UInt32 rtt, Base::UInt32 sample) = 0;
+	// Called when some packets must be repeated (loss detected)
+	void			onLoss(Base::UInt32 rtt);
+	// Called when the retransmission timeout has elapsed
+	void			onTimeout();
+
+protected:
+	RTMFPCongestion() : _threshold(MAX_WINDOW), _window(INIT_WINDOW), _lastDecrease(0) {}
+
+	// Return the new window after a loss
+	virtual Base::UInt32 decrease() = 0;
+
+	void			setWindow(Base::UInt32 window) { _window = window < MIN_WINDOW ? MIN_WINDOW : (window > MAX_WINDOW ? MAX_WINDOW : window); }
+
+	Base::UInt32	_threshold;
+private:
+	Base::UInt32	_window;
+	Base::Time		_lastDecrease; // to decrease the window only one time per round trip
+};
+
+/**************************************************
+Loss-based congestion control (Reno like) :
+slow start then additive increase, multiplicative
+decrease on loss
+*/
+struct RTMFPLossCongestion : RTMFPCongestion, virtual Base::Object {
+	RTMFPLossCongestion() : _acked(0) {}
+
+	void			onAck(Base::UInt32 acked, Base::UInt32 rtt, Base::UInt32 sample);
+private:
+	Base::UInt32	decrease();
+
+	Base::UInt32	_acked; // packets acknowledged since the last increase (congestion avoidance)
+};
+
+/**************************************************
+Delay-based congestion control (Vegas like) :
+compare the expected and the actual throughput
+from the round trip times and keep a few packets
+queued in the network
+*/
+struct RTMFPDelayCongestion : RTMFPCongestion, virtual Base::Object {
+	enum {
+		ALPHA = 2, // increase the window if less than ALPHA packets are queued in the network
+		BETA = 4 // decrease the window if more than BETA packets are queued in the network
+	};
+
+	RTMFPDelayCongestion() : _baseRTT(0), _acked(0) {}
+
+	void			onAck(Base::UInt32 acked, Base::UInt32 rtt, Base::UInt32 sample);
+private:
+	Base::UInt32	decrease();
+
+	Base::UInt32	_baseRTT; // minimum round trip time observed
+	Base::UInt32	_acked; // packets acknowledged since the last adjustment
+};
@@ -21,13 +21,22 @@ along with Librtmfp.  If not, see <http://www.gnu.org/licenses/>.
 
 #pragma once
 
-#include "Base/Runner.h"
+#include "Base/ThreadPool.h"
 #include "Base/Event.h"
 #include "Base/Handler.h"
 #include "Base/Packet.h"
+#include "Base/SPSCQueue.h"
 #include "RTMFP.h"
 
-struct RTMFPDecoder : Base::Runner, virtual Base::Object{
+/**************************************************
+RTMFPDecoder is the decoding pipeline of a session :
+packets received are decoded on the thread pool track
+of the session (in the order of reception) and given
+back to the handler thread with onDecoded.
+Packets are passed with lock-free queues and a runner
+is queued only when the pipeline is idle
+*/
+struct RTMFPDecoder : virtual Base::Object {
 	struct Decoded : Base::Packet {
 		Decoded(Base::UInt32 id, const Base::SocketAddress& address, std::shared_ptr<Base::Buffer>& pBuffer) : address(address), Packet(pBuffer), idSession(id) {}
 		const Base::SocketAddress		address;
@@ -35,19 +44,40 @@ struct RTMFPDecoder : Base::Runner, virtual Base::Object{
 	};
 	typedef Base::Event<void(Decoded& decoded)> ON(Decoded);
 
-	RTMFPDecoder(Base::UInt32 id, const Base::SocketAddress& address, const std::shared_ptr<RTMFP::Engine>& pDecoder, std::shared_ptr<Base::Buffer>& pBuffer, const Base::Handler& handler) :
-		_handler(handler), _idSession(id), _address(address), _pBuffer(std::move(pBuffer)), Base::Runner("RTMFPDecoder"), _pDecoder(pDecoder) {}
+	RTMFPDecoder(Base::UInt32 id, const Base::Handler& handler, const Base::ThreadPool& threadPool);
+
+	// Queue a packet to decode with the engine, must be always called by the same thread (the receiving one)
+	bool decode(Base::Exception& ex, const std::shared_ptr<RTMFP::Engine>& pEngine, std::shared_ptr<Base::Buffer>& pBuffer, const Base::SocketAddress& address);
 
 private:
-	bool run(Base::Exception& ex) {
-		bool decoded;
-		if ((decoded = _pDecoder->decode(ex, *_pBuffer, _address)))
-			_handler.queue(onDecoded, _idSession, _address, _pBuffer);
-		return decoded;
-	}
-	std::shared_ptr<RTMFP::Engine>	_pDecoder;
-	std::shared_ptr<Base::Buffer>	_pBuffer;
-	Base::SocketAddress				_address;
-	const Base::Handler&			_handler;
-	Base::UInt32					_idSession;
+	enum { QUEUE_SIZE = 256 }; // packets waiting in each direction
+
+	struct Received {
+		std::shared_ptr<RTMFP::Engine>	pEngine;
+		std::shared_ptr<Base::Buffer>	pBuffer;
+		Base::SocketAddress				address;
+	};
+	struct Pipe : virtual Base::Object {
+		Pipe(Base::UInt32 id, const Base::Handler& handler, const Base::ThreadPool& threadPool) : id(id), handler(handler), threadPool(threadPool), track(0), received(QUEUE_SIZE), decoded(QUEUE_SIZE), decoding(false), delivering(false) {}
+		const Base::UInt32									id;
+		const Base::Handler&								handler;
+		const Base::ThreadPool&								threadPool;
+		Base::UInt16										track; // thread pool track of the session
+		Base::SPSCQueue<Received>							received; // receiving thread => decoding thread
+		Base::SPSCQueue<Received>							decoded; // decoding thread => handler thread
+		std::atomic<bool>									decoding; // a decoding runner is queued
+		std::atomic<bool>									delivering; // a delivery runner is queued
+		OnDecoded											onDecoded; // subscribed to RTMFPDecoder::onDecoded (released with it)
+		std::shared_ptr<Base::Runner>						pDecoding;
+		std::shared_ptr<Base::Runner>						pDelivery;
+	};
+	struct Decoding;
+	struct Delivery;
+
+	// Queue a decoding runner if not already done
+	static bool Decode(Base::Exception& ex, const std::shared_ptr<Pipe>& pPipe);
+	// Queue a delivery runner to the handler if not already done
+	static void Deliver(const std::shared_ptr<Pipe>& pPipe);
+
+	std::shared_ptr<Pipe>		_pPipe;
 };
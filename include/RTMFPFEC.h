@@ -0,0 +1,145 @@
+/*
+Copyright 2016 Thomas Jammet
+mathieu.poux[a]gmail.com
+jammetthomas[a]gmail.com
+
+This file is part of Librtmfp.
+
+Librtmfp is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Librtmfp is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with Librtmfp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#pragma once
+
+#include "Base/Mona.h"
+#include "Base/Packet.h"
+#include "Base/BinaryWriter.h"
+#include "Base/Time.h"
+#include "RTMFP.h"
+#include <map>
+
+/**************************************************
+RTMFPFEC is the forward error correction of the
+flows carrying unreliable messages (librtmfp
+extension, only negotiated between librtmfp peers) :
+- the writer offers it with a flow header option,
+- the flow accepts it with a CHUNK_ACCEPT chunk,
+- then the writer sends repair chunks after each block
+of consecutive stages containing unreliable fragments.
+A source symbol is flags(8) + size(16) + payload, the
+repairs are computed on the symbols padded with zeros
+to the biggest one of the block (XOR or Reed-Solomon
+with a Cauchy matrix on GF(2^8))
+*/
+struct RTMFPFEC : virtual Base::Static {
+	enum Scheme {
+		SCHEME_NONE = 0,
+		SCHEME_XOR, // 1 repair by block, recovers 1 lost fragment
+		SCHEME_REED_SOLOMON // n repairs by block, recovers n lost fragments
+	};
+	enum {
+		CHUNK = 0x2F, // chunk type of the FEC messages
+		OPTION = 0x7F, // flow header option type of the FEC offer
+		KIND_ACCEPT = 0,
+		KIND_REPAIR = 1,
+		SOURCES_MAX = 64,
+		REPAIRS_MAX = 16,
+		SYMBOL_MAX = RTMFP::SIZE_PACKET + 3,
+		MARGIN = 5, // bytes kept free in the fragments for the bigger header of a repair chunk
+		DELAY_MAX = 40, // max delay in msec before closing an incomplete block
+		WINDOW = 4 * SOURCES_MAX // stages kept by the decoder
+	};
+
+	struct Config {
+		Config(Base::UInt8 scheme = SCHEME_NONE, Base::UInt8 sources = 8, Base::UInt8 repairs = 2);
+
+		Base::UInt8	scheme; // RTMFPFEC::Scheme
+		Base::UInt8	sources; // fragments by block
+		Base::UInt8	repairs; // repair chunks by block
+
+		explicit operator bool() const { return scheme != SCHEME_NONE; }
+	};
+
+	struct Fragment : Base::Packet, virtual Base::Object {
+		Fragment(Base::UInt8 flags, const Base::Packet& packet) : flags(flags), Base::Packet(std::move(packet)) {}
+		const Base::UInt8 flags;
+	};
+
+	/*!
+	Compute the repairs of the fragments written by RTMFPMessenger (sending thread) */
+	struct Encoder : virtual Base::Object {
+		Encoder(const Config& config);
+
+		const Config	config;
+
+		// Start the symbol of the fragment stage, return false if it is not protected (then the block is reset)
+		bool			add(Base::UInt64 stage, Base::UInt8 flags, Base::UInt32 size, bool reliable);
+		// Add payload bytes to the current symbol
+		void			append(const Base::UInt8* data, Base::UInt32 size);
+
+		// Block full, or incomplete since DELAY_MAX
+		bool			closable() const { return _count == config.sources || (_count && _time.isElapsed(DELAY_MAX)); }
+		// Repairs are useless if all the fragments of the block are reliable
+		bool			useful() const { return _unreliable; }
+		// Size of a repair chunk (type and size included)
+		Base::UInt32	repairSize(Base::UInt64 id) const;
+		void			writeRepair(Base::BinaryWriter& writer, Base::UInt64 id, Base::UInt8 index) const;
+		// Start a new block
+		void			reset();
+
+	private:
+		Base::UInt64				_stage; // first stage of the block
+		Base::UInt8					_count; // symbols in the block
+		Base::UInt32				_length; // size of the biggest symbol
+		Base::UInt32				_position; // position in the current symbol
+		bool						_unreliable;
+		Base::Time					_time; // time of the first symbol
+		Base::UInt8					_coefficients[REPAIRS_MAX]; // coefficients of the current symbol
+		std::unique_ptr<Base::UInt8[]>	_pRepairs; // repairs * SYMBOL_MAX bytes (zeros after _length)
+	};
+
+	/*!
+	Keep the fragments received by RTMFPFlow and rebuild the lost ones from the repairs */
+	struct Decoder : virtual Base::Object {
+		Decoder(Base::UInt8 scheme) : scheme(scheme), _stage(0), _repaired(false), _changed(false) {}
+
+		const Base::UInt8	scheme;
+
+		// Return true if at least one repair has been received (the acceptance has been received by the writer)
+		bool		repaired() const { return _repaired; }
+
+		// Keep the fragment stage, it can be a source of a block
+		void		add(Base::UInt64 stage, Base::UInt8 flags, const Base::Packet& packet);
+		// Add the repair index of the block starting at stage
+		void		repair(Base::UInt64 stage, Base::UInt8 count, Base::UInt8 index, const Base::Packet& packet);
+		// Rebuild the lost fragments of the blocks which can be repaired, return true if at least one fragment is recovered
+		bool		recover(std::map<Base::UInt64, Fragment>& fragments);
+
+	private:
+		struct Block : virtual Base::Object {
+			Block(Base::UInt8 count) : count(count), changed(true) {}
+			const Base::UInt8						count;
+			std::map<Base::UInt8, Base::Packet>		repairs;
+			bool									changed;
+		};
+		// Solve the lost symbols of the block, return false if the repairs are invalid
+		bool		solve(Base::UInt64 first, const Block& block, const std::vector<Base::UInt8>& losts, std::map<Base::UInt64, Fragment>& fragments);
+
+		std::map<Base::UInt64, Fragment>	_sources; // fragments received by stage
+		std::map<Base::UInt64, Block>		_blocks; // blocks by first stage
+		Base::UInt64						_stage; // greatest stage received
+		bool								_repaired;
+		bool								_changed; // a block has changed since the last recover()
+	};
+};
@@ -25,6 +25,7 @@ along with Librtmfp.  If not, see <http://www.gnu.org/licenses/>.
 #include "FlashConnection.h"
 #include "Base/Buffer.h"
 #include "FlowManager.h"
+#include "RTMFPFEC.h"
 
 /**************************************************************
 RTMFPFlow is the receiving class for one NetStream of a 
@@ -43,22 +44,49 @@ public:
 	// Handle fragments received
 	void	input(Base::UInt64 stage, Base::UInt8 flags, const Base::Packet& packet);
 
-	// Build acknowledgment
-	Base::UInt64	buildAck(std::vector<Base::UInt64>& losts, Base::UInt16& size);
+	// Build acknowledgment, return the current stage and add the size of the lost ranges to size
+	Base::UInt64	buildAck(Base::UInt16& size);
+	// Write the lost ranges of the acknowledgment (after buildAck)
+	void			writeLosts(Base::BinaryWriter& writer) const;
 
-	bool			consumed() { return _stageEnd && _fragments.empty() && _completeTime.isElapsed(120000); } // Wait 120s before closing the flow definetly
+	bool			consumed() { return _stageEnd && !_fragments && _completeTime.isElapsed(120000); } // Wait 120s before closing the flow definetly
+
+	// Return true if some fragments are waiting for lost stages
+	bool			gap() const { return _fragments>0; }
+
+	// Enable the forward error correction offered by the writer
+	void			setFEC(Base::UInt8 scheme) { _pFEC.reset(new RTMFPFEC::Decoder(scheme)); }
+	// Return true while the acceptance of the FEC must be sent to the writer (no repair received)
+	bool			fecAccepting() const { return _pFEC && !_pFEC->repaired(); }
+	// Handle a FEC repair chunk, return true if lost fragments have been recovered
+	bool			repair(Base::UInt64 stage, Base::UInt8 count, Base::UInt8 index, const Base::Packet& packet);
 
 	Base::UInt32	fragmentation;
 
 private:
+	// Handle fragment of stage, the next ones can be ready
+	void	receive(Base::UInt64 stage, Base::UInt8 flags, const Base::Packet& packet);
+	// Handle the fragments recovered by FEC, return true if at least one is new
+	bool	recover();
+
 	// Handle on fragment received
 	void	onFragment(Base::UInt64 stage, Base::UInt8 flags, const Base::Packet& packet);
 
 	void	output(Base::UInt64 flowId, Base::UInt32& lost, const Base::Packet& packet);
+	void	output(Base::UInt64 flowId, Base::UInt32& lost, const RTMFP::Fragments& fragments);
+
+	// Return true if stage is bufferized in the window
+	bool			buffered(Base::UInt64 stage) const { return stage > _stage && stage <= _stageMax && (_bits[(stage & (WINDOW - 1)) >> 6] & (1ull << (stage & 63))); }
+	// Return the first stage >= stage bufferized (or not if present is false), _stageMax+1 if none
+	Base::UInt64	next(Base::UInt64 stage, bool present) const;
+	// Read the range of lost stages and bufferized stages following stage (the last stage of the previous range), return false at the end
+	bool			nextRange(Base::UInt64& stage, Base::UInt64& lost, Base::UInt64& bufferized) const;
+
+	enum { WINDOW = 1024 }; // max stages bufferized after a lost stage (power of 2)
 
 	struct Fragment : Base::Packet, virtual Base::Object {
-		Fragment(Base::UInt8 flags, const Base::Packet& packet) : flags(flags), Base::Packet(std::move(packet)) {}
-		const Base::UInt8 flags;
+		Fragment() : flags(0) {}
+		Base::UInt8 flags;
 	};
 
 	Base::UInt64						_stageEnd; // If not 0 it is completed
@@ -67,7 +95,12 @@ private:
 	Base::UInt64						_stage; // Current stage (index) of messages received
 	std::shared_ptr<FlashStream>		_pStream; // NetStream handler of the flow
 	Base::UInt64						_writerRef; // Id of the writer linked to (read into fullduplex header part)
-	std::shared_ptr<Base::Buffer>		_pBuffer;
+	RTMFP::Fragments					_message; // fragments of the current message (referenced)
 	Base::UInt32						_lost;
-	std::map<Base::UInt64, Fragment>	_fragments; // map of all fragments received and not handled for now
+	// Circular window of the fragments received and not handled for now, indexed by stage
+	std::unique_ptr<Fragment[]>			_pFragments; // allocated on the first lost stage
+	Base::UInt64						_bits[WINDOW / 64]; // stages present in _pFragments
+	Base::UInt32						_fragments; // count of stages bufferized
+	Base::UInt64						_stageMax; // greatest stage bufferized
+	std::unique_ptr<RTMFPFEC::Decoder>	_pFEC; // forward error correction (if offered by the writer)
 };
@@ -75,8 +75,8 @@ struct RTMFPHandshaker : BandWriter  {
 	// Create the handshake object if needed and send a handshake 70 to address
 	void								sendHandshake70(const std::string& tag, const Base::SocketAddress& address, const Base::SocketAddress& host);
 
-	// Called by Invoker every second to manage connection (flush and ping)
-	void								manage();
+	// Send the handshakes again and release the old cookies, return the delay in msec before the next call
+	Base::UInt32						manage();
 
 	// Close the socket all connections
 	void								close();
@@ -0,0 +1,52 @@
+/*
+Copyright 2016 Thomas Jammet
+mathieu.poux[a]gmail.com
+jammetthomas[a]gmail.com
+
+This file is part of Librtmfp.
+
+Librtmfp is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Librtmfp is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with Librtmfp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include "Base/Mona.h"
+#include <atomic>
+#include <mutex>
+
+/**************************************************
+RTMFPNotifier is a descriptor readable while an
+event is pending (eventfd on Linux, pipe on BSD,
+not available on Windows), to wait for events in
+the event loop of the application
+*/
+struct RTMFPNotifier : virtual Base::Object {
+	RTMFPNotifier() : _set(false), _fd(-1), _fdWrite(-1) {}
+	virtual ~RTMFPNotifier();
+
+	// Return the descriptor (created at the first call), -1 if it cannot be created
+	int		fd();
+	// Make the descriptor readable (thread-safe)
+	void	set();
+	// Make the descriptor unreadable (thread-safe)
+	void	reset();
+
+private:
+	void	signal();
+
+	std::atomic<bool>	_set;
+	std::mutex			_mutex;
+	int					_fd;
+	int					_fdWrite; // equals _fd with eventfd
+};
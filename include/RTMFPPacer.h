@@ -0,0 +1,53 @@
+/*
+Copyright 2016 Thomas Jammet
+mathieu.poux[a]gmail.com
+jammetthomas[a]gmail.com
+
+This file is part of Librtmfp.
+
+Librtmfp is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Librtmfp is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with Librtmfp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include "Base/Mona.h"
+#include "Base/ThreadQueue.h"
+#include "Base/Handler.h"
+#include "Base/Timer.h"
+#include <map>
+
+/**************************************************
+RTMFPPacer wakes up the sending sessions waiting
+for pacing tokens : the delay is scheduled on the
+timer of the handler thread (the invoker) which
+queues the runner in the sending thread once elapsed
+*/
+struct RTMFPPacer : virtual Base::Object {
+	RTMFPPacer(const Base::Handler& handler, const Base::Timer& timer);
+
+	// Queue pRunner in the thread after delay msec (thread-safe)
+	void schedule(Base::UInt32 delay, Base::ThreadQueue& thread, const std::shared_ptr<Base::Runner>& pRunner);
+	// Stop the timer and release the runners waiting, must be called by the handler thread
+	void clear();
+
+private:
+	struct Schedule;
+	// Queue the runners whose time is elapsed, return the delay before the next one (0 if none)
+	Base::UInt32 raise();
+
+	const Base::Handler&																		_handler;
+	const Base::Timer&																			_timer;
+	Base::Timer::OnTimer																		_onTimer;
+	std::multimap<Base::Int64, std::pair<Base::ThreadQueue*, std::shared_ptr<Base::Runner>>>	_runners; // runners by time to queue (handler thread)
+};
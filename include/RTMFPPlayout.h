@@ -0,0 +1,102 @@
+/*
+Copyright 2016 Thomas Jammet
+mathieu.poux[a]gmail.com
+jammetthomas[a]gmail.com
+
+This file is part of Librtmfp.
+
+Librtmfp is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Librtmfp is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with Librtmfp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include "Base/Mona.h"
+#include "RTMFP.h"
+#include "AMF.h"
+
+/**************************************************
+RTMFPMediaPacket is a media packet waiting to be
+read by RTMFP_Read
+*/
+struct RTMFPMediaPacket : virtual Base::Object {
+	RTMFPMediaPacket(const RTMFP::Fragments& fragments, Base::UInt32 time, AMF::Type type) : time(time), type(type), pos(0), arrival(Base::Time::Now()) {
+		for (const Base::Packet& fragment : fragments)
+			this->fragments.add(fragment);
+	}
+
+	// Return false if the packet can be dropped (audio or video frame which is not a key frame or codec infos)
+	bool				essential() const {
+		const Base::Packet& first(fragments.front());
+		if (type == AMF::TYPE_VIDEO)
+			return RTMFP::IsKeyFrame(first.data(), first.size());
+		return type != AMF::TYPE_AUDIO || RTMFP::IsAACCodecInfos(first.data(), first.size());
+	}
+
+	RTMFP::Fragments	fragments; // payload (referenced, concatenated only by the copy in the reader buffer)
+	Base::UInt32		time;
+	AMF::Type			type;
+	Base::UInt32		pos;
+	const Base::Int64	arrival; // reception time
+};
+
+/**************************************************
+RTMFPPlayout is the playout buffer of a player :
+it orders the media packets by timestamp and
+releases them when their playout time is reached.
+The latency follows the peak delay of the packets
+over the fastest one (fast increase, slow decrease)
+between the min and max latencies configured.
+Late packets behind the playout point are dropped
+(except codec infos and key frames)
+*/
+struct RTMFPPlayout : virtual Base::Object {
+	RTMFPPlayout(Base::UInt16 minLatency, Base::UInt16 maxLatency);
+
+	// Add a media packet received at 'now' (msec)
+	void			add(Base::Int64 now, const std::shared_ptr<RTMFPMediaPacket>& pPacket);
+	// Move the packets which have reached their playout time in 'output'
+	void			release(Base::Int64 now, std::deque<std::shared_ptr<RTMFPMediaPacket>>& output);
+	// Return the delay in msec before the next release (0xFFFFFFFF if empty)
+	Base::UInt32	delay(Base::Int64 now) const;
+
+	Base::UInt32	latency() const { return Base::UInt32(_latency); }
+	Base::UInt32	jitter() const { return Base::UInt32(_jitter); }
+	Base::UInt32	size() const { return _packets.size(); }
+
+	const Base::UInt16	minLatency;
+	const Base::UInt16	maxLatency;
+	Base::UInt64		late; // packets received after their playout time
+	Base::UInt64		dropped; // late packets dropped
+
+private:
+	enum {
+		PERIOD = 5000, // duration of a period of the minimum transit
+		RESET = 10000 // transit gap considered as a discontinuity of the timestamps
+	};
+	void			reset(Base::Int64 transit);
+	Base::Int64		playoutTime(const RTMFPMediaPacket& packet) const { return packet.time + _transitBase + Base::Int64(_latency); }
+
+	std::deque<std::shared_ptr<RTMFPMediaPacket>>	_packets; // packets ordered by timestamp
+	Base::UInt32									_flushing; // count of packets to release without waiting (previous timeline)
+	bool											_started;
+	Base::Int64										_transitBase; // minimum transit (arrival - timestamp) of the last 2 periods
+	Base::Int64										_transitMin; // minimum transit of the current period
+	Base::Int64										_transitPrevious; // minimum transit of the previous period
+	Base::Int64										_period; // end of the current period
+	Base::Int64										_transitLast; // transit of the last packet
+	double											_jitter; // interarrival jitter (RFC 3550)
+	double											_latency; // target latency
+	Base::UInt32									_released; // timestamp of the last packet released
+	bool											_hasReleased;
+};
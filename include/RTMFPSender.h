@@ -26,10 +26,13 @@ along with Librtmfp.  If not, see <http://www.gnu.org/licenses/>.
 #include "AMFWriter.h"
 #include "Base/LostRate.h"
 #include "RTMFP.h"
+#include "RTMFPCongestion.h"
+#include "RTMFPPacer.h"
+#include "RTMFPFEC.h"
 
 struct RTMFPSender : Base::Runner, virtual Base::Object {
 	struct Packet : Base::Packet, virtual Base::Object {
-		Packet(std::shared_ptr<Base::Buffer>& pBuffer, Base::UInt32 fragments, bool reliable) : fragments(fragments), Base::Packet(pBuffer), reliable(reliable), _sizeSent(0) {}
+		Packet(const Base::Packet&& datagram, Base::UInt32 fragments, bool reliable, const std::shared_ptr<bool>& pSent) : fragments(fragments), Base::Packet(std::move(datagram)), reliable(reliable), pSent(pSent), _sizeSent(0), repeatTime(0) {}
 		void setSent() {
 			if (_sizeSent)
 				return;
@@ -40,13 +43,27 @@ struct RTMFPSender : Base::Runner, virtual Base::Object {
 		const bool   reliable;
 		const Base::UInt32	fragments;
 		Base::UInt32		sizeSent() const { return _sizeSent; }
+		Base::Int64			repeatTime; // time of the last repeat not yet acknowledged (0 if none)
+		const std::shared_ptr<bool>	pSent; // datagram already sent (shared by the packets of the writers bundled in the same datagram)
 	private:
 		Base::UInt32		_sizeSent;
 	};
+
+	/*!
+	Stages lost reported by an acknowledgment, ranges [first, last] in ascending order */
+	struct Losts : std::vector<std::pair<Base::UInt64, Base::UInt64>> {
+		Losts() : stageReceived(0) {}
+		Base::UInt64	stageReceived; // greatest stage received by the peer
+
+		// Return true if one stage of [first, last] is lost, unknown stages (> stageReceived) are considered lost if unknownLost is true
+		bool			lost(Base::UInt64 first, Base::UInt64 last, bool unknownLost) const;
+	};
+
+	struct Queue;
 	struct Session : virtual Base::Object {
-		Session(Base::UInt32 farId, const std::shared_ptr<RTMFP::Engine>& pEncoder, const std::shared_ptr<Base::Socket>& pSocket, Base::Int64 time) :
-			sendable(RTMFP::SENDABLE_MAX), socket(*pSocket), pEncoder(new RTMFP::Engine(*pEncoder)), farId(farId), initiatorTime(time),
-			queueing(0), _pSocket(pSocket), sendLostRate(sendByteRate), sendTime(0) {}
+		Session(Base::UInt32 farId, const std::shared_ptr<RTMFP::Engine>& pEncoder, const std::shared_ptr<Base::Socket>& pSocket, Base::Int64 time, Base::UInt8 congestionType, Base::UInt16 pacingBurst, RTMFPPacer& pacer) :
+			pCongestion(RTMFPCongestion::New(congestionType)), inFlight(0), datagramMarker(0), datagramUrgent(false), pLastQueue(NULL), rtt(0), rttSample(0), repeats(0), usefulRepeats(0), pacingBurst(pacingBurst), pacingTokens(pacingBurst), pacingTime(Base::Time::Now()), pacingWait(false), pacer(pacer), socket(*pSocket), pEncoder(new RTMFP::Engine(*pEncoder)), farId(farId), initiatorTime(time),
+			queueing(0), _pSocket(pSocket), sendLostRate(sendByteRate), sendTime(0) { batch.reserve(Base::Socket::BATCH_MAX); }
 		Base::UInt32					farId;
 		std::atomic<Base::Int64>		initiatorTime;
 		std::shared_ptr<RTMFP::Engine>	pEncoder;
@@ -55,23 +72,63 @@ struct RTMFPSender : Base::Runner, virtual Base::Object {
 		Base::ByteRate					sendByteRate;
 		Base::LostRate					sendLostRate;
 		std::atomic<Base::UInt64>		queueing;
-		Base::UInt8						sendable;
+		std::atomic<Base::UInt64>		repeats; // packets repeated
+		std::atomic<Base::UInt64>		usefulRepeats; // packets repeated which were really lost
+		std::atomic<Base::UInt32>		rtt; // smoothed round trip time (set by FlowManager)
+		std::atomic<Base::UInt32>		rttSample; // last round trip time measured (set by FlowManager)
+		// Congestion control (used only by the sending thread)
+		std::unique_ptr<RTMFPCongestion>	pCongestion;
+		Base::UInt32						inFlight; // packets sent and not yet acknowledged (sum of the queues inFlight)
+		std::deque<std::shared_ptr<RTMFPSender>>	blocked; // flushers of the queues waiting for the congestion window to open (or for a pacing token)
+		std::vector<Base::Packet>			batch; // datagrams waiting to be sent in one system call (owned, Socket::BATCH_MAX at most)
+		// Datagram assembly (used only by the sending thread)
+		struct Part {
+			Part(const std::shared_ptr<Queue>& pQueue, bool reliable, Base::UInt32 fragments = 1) : pQueue(pQueue), fragments(fragments), reliable(reliable) {}
+			std::shared_ptr<Queue>	pQueue;
+			Base::UInt32			fragments;
+			bool					reliable;
+		};
+		std::shared_ptr<Base::Buffer>		pDatagram; // chunks of the datagram being assembled (not encoded)
+		RTMFP::Segments						segments; // message payloads shared (not copied) by pDatagram
+		Base::UInt8							datagramMarker;
+		bool								datagramUrgent; // contains chunks which must not wait for the congestion window (acks)
+		const Queue*						pLastQueue; // queue of the last chunk written (to use the 0x11 continuation chunk)
+		std::vector<Part>					parts; // writers having chunks in the datagram
+		// Pacing (used only by the sending thread)
+		const Base::UInt16					pacingBurst; // max packets sent in a burst, 0 means no pacing
+		double								pacingTokens; // packets which can be sent now
+		Base::Int64							pacingTime; // time of the last tokens refill
+		bool								pacingWait; // true if a resume is scheduled
+		RTMFPPacer&							pacer;
+
+		// Take a pacing token, return false if the packet must wait
+		bool								pace();
+		// Return the delay in msec before the next pacing token
+		Base::UInt32						pacingDelay() const { return Base::UInt32((1 - pacingTokens) / pacingRate()) + 1; }
+		// Pacing rate in packets per msec : 1.25 congestion window per round trip
+		double								pacingRate() const { Base::UInt32 rtt(this->rtt); return pCongestion->window() * 1.25 / (rtt ? rtt : 1); }
 	private:
 		std::shared_ptr<Base::Socket>	_pSocket; // to keep the socket open
 	};
 	struct Queue : virtual Base::Object, std::deque<std::shared_ptr<Packet>> {
 		template<typename SignatureType>
-		Queue(Base::UInt64 id, Base::UInt64 flowId, const SignatureType& signature) : id(id), stage(0), stageSending(0), stageAck(0), signature(STR signature.data(), signature.size()), flowId(flowId) {}
+		Queue(Base::UInt64 id, Base::UInt64 flowId, const SignatureType& signature) : id(id), stage(0), stageSending(0), stageAck(0), inFlight(0), blocked(false), signature(STR signature.data(), signature.size()), flowId(flowId), fecAccepted(false) {}
 
 		const Base::UInt64					id;
 		const Base::UInt64					flowId;
 		const std::string					signature;
+		RTMFPFEC::Config					fec; // FEC offered in the flow header (set before the first message)
+		std::atomic<bool>					fecAccepted; // FEC accepted by the peer
 		// used by RTMFPSender
 		/// stageAck <= stageSending <= stage
 		Base::UInt64						stage;
 		Base::UInt64						stageSending;
 		Base::UInt64						stageAck;
 		std::deque<std::shared_ptr<Packet>>	sending;
+		Base::UInt32						inFlight; // packets of the queue counted in Session::inFlight
+		Losts								losts; // last lost stages reported by the peer
+		bool								blocked; // true if its flusher waits in Session::blocked
+		std::unique_ptr<RTMFPFEC::Encoder>	pFEC; // repairs of the fragments (once fecAccepted)
 	};
 
 	// Flush usage!
@@ -87,6 +144,25 @@ protected:
 	std::shared_ptr<Queue>	pQueue;
 	Base::UInt8				_marker;
 
+	// Send packets of the queue while the congestion window allows it, return false if the queue is blocked
+	bool		flush(const std::shared_ptr<Queue>& pWriterQueue);
+	// Queue again the flushers of the queues blocked by the congestion window, each queue is changed only by a runner of its writer
+	void		flushBlocked();
+	// Remove count packets of our queue from the packets in flight (acknowledged, lost or released)
+	void		release(Base::UInt32 count);
+	// Add a datagram to the session batch (bufferized), sent at the end of the run or when the batch is full
+	void		send(const Base::Packet& packet);
+	// Send the datagrams of the session batch in one system call
+	void		sendBatch();
+	// Close the datagram being assembled and start a new one with our marker
+	Base::Buffer& newDatagram();
+	// Encode the datagram being assembled and give its packet to each writer queue having chunks in it
+	void		closeDatagram();
+	// Count the repeat of the packet as useful if the acknowledgment can't be the one of the original packet
+	void		acknowledged(Packet& packet);
+	// Take a pacing token or schedule a resume of the blocked queues, return false if the packet must wait
+	bool		pace();
+
 private:
 	bool		 run(Base::Exception& ex);
 	virtual void run() {}
@@ -100,25 +176,69 @@ private:
 	Base::UInt8	_cmd;
 };
 
+/*!
+Add raw chunks (acknowledgments) to the datagram being assembled by the session,
+they are sent immediatly if no other sender follows */
+struct RTMFPChunkSender : RTMFPSender, virtual Base::Object {
+	RTMFPChunkSender(Base::UInt8 marker, const Base::Packet& chunks) : RTMFPSender("RTMFPChunkSender", marker), _chunks(std::move(chunks)) {}
+private:
+	void	run();
+
+	const Base::Packet	_chunks;
+};
+
+struct RTMFPResumer : RTMFPSender, virtual Base::Object {
+	RTMFPResumer(Base::UInt8 marker) : RTMFPSender("RTMFPResumer", marker) {}
+private:
+	void	run();
+};
+
+/*!
+Flush a queue blocked by the congestion window, it holds the queue
+while it waits in Session::blocked (so the writer considers it as sending) */
+struct RTMFPFlusher : RTMFPSender, virtual Base::Object {
+	RTMFPFlusher(Base::UInt8 marker, const std::shared_ptr<RTMFPSender::Queue>& pQueue) : RTMFPSender("RTMFPFlusher", marker, pQueue) {}
+private:
+	void	run() { pQueue->blocked = false; }
+};
+
+/*!
+Give back the packets in flight of a closed writer to the congestion window */
+struct RTMFPReleaser : RTMFPSender, virtual Base::Object {
+	RTMFPReleaser(Base::UInt8 marker, const std::shared_ptr<RTMFPSender::Queue>& pQueue) : RTMFPSender("RTMFPReleaser", marker, pQueue) {}
+private:
+	void	run();
+};
+
 struct RTMFPAcquiter : RTMFPSender, virtual Base::Object {
-	RTMFPAcquiter(Base::UInt8 marker, const std::shared_ptr<RTMFPSender::Queue>& pQueue, Base::UInt64 stageAck) : RTMFPSender("RTMFPAcquiter", marker, pQueue), _stageAck(stageAck) {}
+	RTMFPAcquiter(Base::UInt8 marker, const std::shared_ptr<RTMFPSender::Queue>& pQueue, Base::UInt64 stageAck, Losts&& losts) : RTMFPSender("RTMFPAcquiter", marker, pQueue), _stageAck(stageAck), _losts(std::move(losts)) {}
 private:
 	void	run();
 
 	Base::UInt64	_stageAck;
+	Losts			_losts;
 };
 
+/*!
+Repeat the packets lost after a timeout (all the packets not known as received by the peer)
+or after an acknowledgment with lost ranges (only the lost stages greater than stageFrom) */
 struct RTMFPRepeater : RTMFPSender, virtual Base::Object {
-	RTMFPRepeater(Base::UInt8 marker, const std::shared_ptr<RTMFPSender::Queue>& pQueue, Base::UInt8 fragments = 0) : RTMFPSender("RTMFPRepeater", marker, pQueue), _fragments(fragments) {}
+	RTMFPRepeater(Base::UInt8 marker, const std::shared_ptr<RTMFPSender::Queue>& pQueue) : RTMFPSender("RTMFPRepeater", marker, pQueue), _stageFrom(0), _selective(false) {}
+	RTMFPRepeater(Base::UInt8 marker, const std::shared_ptr<RTMFPSender::Queue>& pQueue, Losts&& losts, Base::UInt64 stageFrom) : RTMFPSender("RTMFPRepeater", marker, pQueue), _losts(std::move(losts)), _stageFrom(stageFrom), _selective(true) {}
 private:
 	void	run();
 	void	sendAbandon(Base::UInt64 stage);
 
-	Base::UInt8	_fragments;
+	Losts			_losts;
+	Base::UInt64	_stageFrom;
+	bool			_selective;
 };
 
 
 struct RTMFPMessenger : RTMFPSender, virtual Base::Object {
+	// smaller payload parts are copied rather than referenced : the cipher dominates the encoding and a reference costs
+	// more than the copy of any part which fits a datagram (RTMFPSegmentsFanOut), so they are merged before the encryption
+	enum { SEGMENT_MIN = RTMFP::SIZE_PACKET };
 	RTMFPMessenger(Base::UInt8 marker, const std::shared_ptr<RTMFPSender::Queue>& pQueue) : RTMFPSender("RTMFPMessenger", marker, pQueue), _flags(0) {} // _flags must be initialized to 0!
 
 	AMFWriter&	newMessage(bool reliable, const Base::Packet& packet) { _messages.emplace_back(reliable, packet); return _messages.back().writer; }
@@ -134,12 +254,9 @@ private:
 	Base::UInt32	headerSize();
 	void			run();
 	void			write(const Message& message);
-	void			flush();
+	// Write the repair chunks of the FEC block and start a new one
+	void			repair();
 
 	std::deque<Message>	_messages;
-
-	// current buffer =>
-	std::shared_ptr<Base::Buffer>	_pBuffer;
-	Base::UInt32					_fragments;
-	Base::UInt8						_flags;
+	Base::UInt8			_flags; // flags of the last fragment written
 };
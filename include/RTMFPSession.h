@@ -26,16 +26,21 @@ along with Librtmfp.  If not, see <http://www.gnu.org/licenses/>.
 #include "RTMFPDecoder.h"
 #include "RTMFPHandshaker.h"
 #include "Publisher.h"
+#include "RTMFPPlayout.h"
+#include "Base/SPSCQueue.h"
+#include "RTMFPNotifier.h"
 #include <queue>
 
+
 /**************************************************
 RTMFPSession represents a connection to the
 RTMFP Server
 */
 struct NetGroup;
+struct RTMFPConfig;
 class RTMFPSession : public FlowManager {
 public:
-	RTMFPSession(Invoker& invoker, OnSocketError pOnSocketError, OnStatusEvent pOnStatusEvent, OnMediaEvent pOnMediaEvent);
+	RTMFPSession(Invoker& invoker, const RTMFPConfig& config);
 
 	~RTMFPSession();
 
@@ -70,6 +75,26 @@ public:
 	// return : -1 if an error occurs, 0 if the stream is closed, otherwise 1
 	int read(Base::UInt16 mediaId, Base::UInt8* buf, Base::UInt32 size, int& nbRead);
 
+	// Asynchronous read without copy : pop the next media packet of mediaId (pPacket stays null if nothing is available)
+	// header : set to true if the FLV header must precede this packet (first read)
+	// return : -1 if an error occurs, 0 if the stream is closed, otherwise 1
+	int read(Base::UInt16 mediaId, std::shared_ptr<RTMFPMediaPacket>& pPacket, bool& header);
+
+	// Return the time to wait (msec) before the next read of mediaId (the next playout time, 100 at most)
+	Base::UInt32 readDelay(Base::UInt16 mediaId);
+
+	// Get the statistics of the playout buffer of mediaId, return false if the media or its playout buffer does not exist
+	bool playoutStats(Base::UInt16 mediaId, Base::UInt32& latency, Base::UInt32& jitter, Base::UInt32& buffered, Base::UInt64& late, Base::UInt64& dropped);
+
+	// Return the descriptor of mediaId readable while media is available, -1 if the media does not exist or if it cannot be created
+	int streamDescriptor(Base::UInt16 mediaId);
+
+	// Return the state flags (RTMFP_STATE_*) and reset the descriptor of the connection
+	int state();
+
+	// Get the statistics of the media queue of mediaId, return false if the media does not exist
+	bool queueStats(Base::UInt16 mediaId, Base::UInt32& depth, Base::UInt32& capacity, Base::UInt64& dropped, Base::UInt64& blocked);
+
 	// Write media (netstream must be published)
 	// return false if the client is not ready to publish, otherwise true
 	bool write(const Base::UInt8* data, Base::UInt32 size, int& pos);
@@ -87,8 +112,8 @@ public:
 	// return : True if the publication has been closed, false otherwise (publication not found)
 	bool closePublication(const char* streamName);
 
-	// Called by Invoker every 50ms to manage connections (flush and ping)
-	virtual void manage();
+	// Called by Invoker to manage connections (flush and ping), return the delay in msec before the next call
+	virtual Base::UInt32 manage();
 		
 	// Return listener if started successfully, otherwise NULL (only for RTMFP connection)
 	template <typename ListenerType, typename... Args>
@@ -106,10 +131,13 @@ public:
 	void stopListening(const std::string& peerId);
 
 	// Set the p2p publisher as ready (used for blocking mode)
-	void setP2pPublisherReady() { p2pPublishSignal.set(); p2pPublishReady = true; }
+	void setP2pPublisherReady() { p2pPublishSignal.set(); p2pPublishReady = true; notifier.set(); }
 
 	// Set the p2p player as ready (used for blocking mode)
-	void setP2PPlayReady() { p2pPlaySignal.set(); p2pPlayReady = true; }
+	void setP2PPlayReady() { p2pPlaySignal.set(); p2pPlayReady = true; notifier.set(); }
+
+	// Set the publisher as ready (used for blocking mode)
+	void setPublishReady() { publishSignal.set(); publishReady = true; notifier.set(); }
 
 	// Called by P2PSession when we are connected to the peer
 	bool addPeer2Group(const std::string& peerId);
@@ -152,6 +180,7 @@ public:
 	const RTMFPDecoder::OnDecoded&	getDecodeEvent() { return _onDecoded; }
 
 	FlashStream::OnMedia			onMediaPlay; // received when a packet from any media stream is ready for reading
+	FlashStream::OnMediaFragments	onMediaPlayFragments; // received when a media received in several fragments is ready for reading
 
 	// Blocking members (used for ffmpeg to wait for an event before exiting the function)
 	Base::Signal					connectSignal; // signal to wait connection
@@ -164,6 +193,8 @@ public:
 	std::atomic<bool>				publishReady; // true if the publisher is ready
 	std::atomic<bool>				connectReady; // Ready if we have received the NetStream.Connect.Success event
 	std::atomic<bool>				dataAvailable; // true if there is asynchronous data available
+	std::atomic<bool>				closed; // true when the session is closed
+	RTMFPNotifier					notifier; // descriptor readable when the state changes or when data is available
 
 	// Publishing structures
 	struct MediaPacket : virtual Base::Object, Base::Packet {
@@ -216,6 +247,8 @@ private:
 	std::string														_host; // server host name
 	std::deque<std::string>											_waitingGroup; // queue of waiting connections to groups
 	std::mutex														_mutexConnections; // mutex for waiting connections (normal or p2p)
+	std::mutex														_mutexPlayers; // mutex for the insertion of media players (the readers do not lock _mutexConnections)
+	std::atomic<bool>												_connected; // True while the status is CONNECTED (checked by the readers)
 	std::map<std::string, std::shared_ptr<P2PSession>>				_mapPeersById; // P2P connections by Id
 
 	std::string														_url; // RTMFP url of the application (base handshake)
@@ -237,9 +270,13 @@ private:
 	Base::DiffieHellman												_diffieHellman; // diffie hellman object used for key computing
 
 	RTMFPDecoder::OnDecoded											_onDecoded; // Decoded callback
-	Base::UInt16													_threadRcv; // Thread used to decode last message
+	std::map<Base::UInt32, std::shared_ptr<RTMFPDecoder>>			_decoders; // decoding pipelines by session ID
 		
 	OnMediaEvent													_pOnMedia; // External Callback to link with parent
+	Base::UInt16													_playoutMinLatency; // Playout buffer latencies of the players (max=0 : disabled)
+	Base::UInt16													_playoutMaxLatency;
+	Base::UInt16													_queueSize; // Size of the media queue of the players
+	bool															_queueBlocking; // If true wait for the reader when a media queue is full, otherwise drop the packets
 
 	// Publish/Play commands
 	struct StreamCommand : public Object {
@@ -256,21 +293,42 @@ private:
 	
 	/* Asynchronous Read */
 	struct MediaPlayer : public Object {
-		MediaPlayer() : firstRead(true), codecInfosRead(false), AACsequenceHeaderRead(false) {}
+		MediaPlayer(Base::UInt16 minLatency, Base::UInt16 maxLatency, Base::UInt16 queueSize, bool blocking) : codecInfosRead(false), AACsequenceHeaderRead(false), waitKeyFrame(false),
+			queue(queueSize > 2 ? queueSize : 2), blocking(blocking), dropped(0), blocked(0), overflowing(false), firstRead(true), pPlayout(maxLatency ? new RTMFPPlayout(minLatency, maxLatency) : NULL) {}
 
-		// Packet structure
-		struct RTMFPMediaPacket : Base::Packet, virtual Base::Object {
-			RTMFPMediaPacket(const Base::Packet& packet, Base::UInt32 time, AMF::Type type) : time(time), type(type), Packet(std::move(packet)), pos(0) {}
+		// Session : push pPacket to the reader, it waits in overflow while the queue is full, the oldest non-key frames waiting are dropped when overflow is full
+		void push(const std::shared_ptr<RTMFPMediaPacket>& pPacket);
+		// Session : push the packets waiting in overflow, return true if overflow is empty
+		bool flush();
+		// Reader : pull the packets of the queue (through the playout buffer) in mediaPackets, up to the queue capacity
+		void pull(Base::Int64 now);
 
-			Base::UInt32	time;
-			AMF::Type		type;
-			Base::UInt32	pos;
-		};
-		std::deque<std::shared_ptr<RTMFPMediaPacket>>	mediaPackets;
-		bool											firstRead;
+		// Session side (_mutexConnections)
 		bool											codecInfosRead; // Player : False until the video codec infos have been read
 		bool											AACsequenceHeaderRead; // False until the AAC sequence header infos have been read
+		bool											waitKeyFrame; // True if a video frame has been dropped, until the next key frame
+		Base::SPSCQueue<std::shared_ptr<RTMFPMediaPacket>>	queue; // Lock-free queue to the reader
+		const bool										blocking; // If true overflow can hold a whole queue, else half of it
+		std::deque<std::shared_ptr<RTMFPMediaPacket>>	overflow; // packets waiting for a place in the queue (late reader)
+		std::atomic<Base::UInt64>						dropped; // packets dropped (late reader)
+		std::atomic<Base::UInt64>						blocked; // number of times the packets have started to wait in overflow
+		std::atomic<bool>								overflowing; // true while overflow is not empty, the reader wakes up the session when it pulls the queue
+		RTMFPNotifier									notifier; // descriptor readable while media is available for the reader
+
+		// Reader side (mutexRead)
+		std::mutex										mutexRead;
+		std::deque<std::shared_ptr<RTMFPMediaPacket>>	mediaPackets; // packets ready to read
+		bool											firstRead;
+		std::unique_ptr<RTMFPPlayout>					pPlayout; // Playout buffer (null if disabled), packets are moved in mediaPackets at their playout time
 	};
+	// Add a player (_mutexConnections must be locked)
+	void														addPlayer(Base::UInt16 mediaId);
+	// Find a player without locking _mutexConnections (players are never removed), return null if not found
+	MediaPlayer*												player(Base::UInt16 mediaId);
+	// Signal to the reader that media is available in the queue (_mutexConnections must be locked)
+	void														signalMedia(MediaPlayer& media);
+	// Reset dataAvailable and the descriptor of media if the reader has nothing more to read (media.mutexRead must be locked)
+	void														updateDataAvailable(MediaPlayer& media);
 	std::map<Base::UInt16, MediaPlayer>							_mapPlayers; // Map of media players
 	Base::UInt16												_mediaCount; // Counter of media streams (publisher/player) id
 };
@@ -41,7 +41,7 @@ struct RTMFPWriter : FlashWriter, virtual Base::Object {
 	RTMFPWriter(Base::UInt8 marker, Base::UInt64 id, Base::UInt64 flowId, const Base::Binary& signature, RTMFP::Output& output);
 
 	Base::UInt64		queueing() const { return _output.queueing(); }
-	void		acquit(Base::UInt64 stageAck, Base::UInt32 lostCount);
+	void		acquit(Base::UInt64 stageAck, RTMFPSender::Losts& losts);
 	bool		consumed() { return _writers.empty() && closed() && !_pSender && _pQueue.unique() && _pQueue->empty() && _closeTime.isElapsed(130000); } // Wait 130s before closing the writer definetly
 
 	template <typename ...Args>
@@ -53,7 +53,16 @@ struct RTMFPWriter : FlashWriter, virtual Base::Object {
 	}
 
 	void				clear() { _pSender.reset(); }
+	// Give back the packets in flight of the consumed writer to the congestion window of the session
+	void				release();
 	void				flush();
+	// Return the time in msec before the next repeat of the messages not acknowledged (0 if late), or -1 if there is nothing to repeat
+	Base::Int64			repeatTimeout() const;
+
+	// Offer the forward error correction of the unreliable messages to the peer, must be called before the first message
+	void				offerFEC(const RTMFPFEC::Config& config) { _pQueue->fec = config; }
+	// FEC accepted by the peer, repairs are sent from now
+	void				acceptFEC();
 
 	/*!
 	Close the writer, override closing(Int32 code) to execute closing code */
@@ -89,7 +98,7 @@ struct RTMFPWriter : FlashWriter, virtual Base::Object {
 
 private:
 
-	void				repeatMessages(Base::UInt32 lostCount = 0); // fragments=0 means all possible!
+	void				repeatMessages(); // repeat on timeout
 	AMFWriter&			newMessage(bool reliable, const Base::Packet& packet);
 	AMFWriter&			write(AMF::Type type, Base::UInt32 time = 0, RTMFP::DataType packetType = RTMFP::TYPE_AMF, const Base::Packet& packet = Base::Packet::Null(), bool reliable = true);
 
@@ -98,7 +107,7 @@ private:
 	std::shared_ptr<RTMFPSender>			_pSender;
 	std::shared_ptr<RTMFPSender::Queue>		_pQueue;
 	Base::UInt64							_stageAck;
-	Base::UInt32							_lostCount;
+	Base::UInt64							_lostStage; // greatest lost stage already repeated
 	Base::UInt32							_repeatDelay;
 	Base::Time								_repeatTime;
 	std::set<std::shared_ptr<RTMFPWriter>>	_writers;
@@ -19,6 +19,8 @@ You should have received a copy of the GNU Lesser General Public License
 along with Librtmfp.  If not, see <http://www.gnu.org/licenses/>.
 */
 
+#include <stddef.h>
+
 #if defined(_WIN32) && !defined(LIBRTMFP_STATIC)
 	// Windows DLL declaration
 	#if defined(LIBRTMFP_EXPORT)
@@ -51,8 +53,62 @@ LIBRTMFP_API typedef struct RTMFPConfig {
 	void	(*pOnSocketError)(const char* error); // Socket Error callback
 	void	(*pOnStatusEvent)(const char* code, const char* description); // RTMFP Status Event callback
 	void	(*pOnMedia)(unsigned short streamId, unsigned int time, const char* data, unsigned int size, unsigned int type); // In synchronous read mode this callback is called when receiving data
+	unsigned short	congestionControl; // Congestion control used for sending, 0 (default) for loss-based, 1 for delay-based
+	unsigned short	pacingBurst; // Send pacing, max packets sent in a burst (0 by default : no pacing)
+	unsigned short	fecScheme; // Forward error correction of the unreliable media sent to librtmfp peers, 0 (default) for none, 1 for XOR, 2 for Reed-Solomon
+	unsigned short	fecSources; // FEC block size, number of fragments protected together (8 by default, 2 to 64)
+	unsigned short	fecRepairs; // Number of repair packets by FEC block with Reed-Solomon (2 by default, 1 to 16), XOR uses 1
+	unsigned short	playoutMaxLatency; // Playout buffer of RTMFP_Read, max latency in msec (0 by default : disabled), the latency adapts to the jitter of the media received
+	unsigned short	playoutMinLatency; // Playout buffer of RTMFP_Read, min latency in msec (0 by default)
+	unsigned short	queueSize; // Max number of media packets waiting for RTMFP_Read in each stream (1024 by default)
+	char			queueBlocking; // False by default : packets wait for a late reader up to half a queue more, then the oldest non-key frames are dropped, if True they wait up to one more queue
 } RTMFPConfig;
 
+LIBRTMFP_API typedef struct RTMFPBufferStats {
+	unsigned long long	allocations; // number of buffers allocated from the system
+	unsigned long long	reuses; // number of buffers reused from the pool
+	double				allocationRate; // buffers requested per second during the last 10 seconds
+	double				fragmentation; // ratio (0 to 1) of the given bytes lost by the size class rounding
+	unsigned long long	cached; // bytes currently cached by the pool
+} RTMFPBufferStats;
+
+LIBRTMFP_API typedef struct RTMFPPlayoutStats {
+	unsigned int		latency; // current latency (msec) of the playout buffer
+	unsigned int		jitter; // interarrival jitter (msec) of the media received
+	unsigned int		buffered; // number of packets waiting for their playout time
+	unsigned long long	late; // number of packets received after their playout time
+	unsigned long long	dropped; // number of late packets dropped (received behind the playout point)
+} RTMFPPlayoutStats;
+
+LIBRTMFP_API typedef struct RTMFPQueueStats {
+	unsigned int		depth; // number of packets waiting for the reader
+	unsigned int		capacity; // max number of packets in the queue
+	unsigned long long	dropped; // number of packets dropped because the reader was late
+	unsigned long long	blocked; // number of times the packets have started to wait for a late reader
+} RTMFPQueueStats;
+
+LIBRTMFP_API typedef struct RTMFPSlice {
+	const void*	data;
+	size_t		size;
+} RTMFPSlice; // Slice of memory (same layout as struct iovec on POSIX systems, can be given to writev)
+
+LIBRTMFP_API typedef struct RTMFPMedia {
+	unsigned int		time; // timestamp in msec
+	unsigned int		type; // 8 for audio, 9 for video, 18 for data (AMF0) and 15 for data (AMF3)
+	unsigned int		size; // payload size (bytes not already read by RTMFP_Read)
+	unsigned int		count; // number of slices
+	const RTMFPSlice*	slices; // payload, or FLV tags (header + payload + previous tag size) with RTMFP_ReadMedia flvTags option
+	void*				handle; // internal use
+} RTMFPMedia;
+
+// State flags of a connection (see RTMFP_GetState)
+#define RTMFP_STATE_CONNECTED		0x01 // NetConnection.Connect.Success received
+#define RTMFP_STATE_PUBLISHED		0x02 // the publication is ready (RTMFP_Publish or first peer of a NetGroup publication)
+#define RTMFP_STATE_P2P_PUBLISHED	0x04 // the P2P publication is ready (RTMFP_PublishP2P)
+#define RTMFP_STATE_P2P_PLAYING		0x08 // the P2P player is ready (RTMFP_Connect2Peer)
+#define RTMFP_STATE_DATA			0x10 // media is available for the readers
+#define RTMFP_STATE_CLOSED			0x20 // the connection is closed
+
 // This function MUST be called before any other
 // Initialize the RTMFP parameters with default values
 // config : CANNOT be null, it is the main configuration parameter
@@ -60,6 +116,10 @@ LIBRTMFP_API typedef struct RTMFPConfig {
 // createLogger : if 0 it will let the default log system (RTMFP_LogSetCallback will not work)
 LIBRTMFP_API void RTMFP_Init(RTMFPConfig* config, RTMFPGroupConfig* groupConfig, int createLogger);
 
+// Set the number of threads used to receive, decode and send packets (0 by default : 2 per processor)
+// It MUST be called before RTMFP_Init to be taken into account
+LIBRTMFP_API void RTMFP_ThreadPoolSetSize(unsigned short threads);
+
 // Terminate all the connections brutaly
 LIBRTMFP_API void RTMFP_Terminate();
 
@@ -106,6 +166,40 @@ LIBRTMFP_API void RTMFP_Close(unsigned int RTMFPcontext);
 // return : the number of bytes read (always less or equal than size) or -1 if an error occurs
 LIBRTMFP_API int RTMFP_Read(unsigned short streamId, unsigned int RTMFPcontext, char *buf, unsigned int size);
 
+// Read the next media packet of the stream without copy (Asynchronous read, alternative to RTMFP_Read)
+// The media memory is lent until RTMFP_ReleaseMedia is called (it must be called before RTMFP_Terminate)
+// flvTags : if 0 the slices are the payload, otherwise they form the FLV tag of the packet (preceded by the FLV header for the first read)
+// return : 1 if media is filled, 0 if the stream is closed, -1 if an error occurs
+LIBRTMFP_API int RTMFP_ReadMedia(unsigned short streamId, unsigned int RTMFPcontext, RTMFPMedia* media, int flvTags);
+
+// Release a media read by RTMFP_ReadMedia
+LIBRTMFP_API void RTMFP_ReleaseMedia(RTMFPMedia* media);
+
+// Non-blocking RTMFP_Read
+// return : the number of bytes read (0 if nothing is available) or -1 if an error occurs or the stream is closed
+LIBRTMFP_API int RTMFP_TryRead(unsigned short streamId, unsigned int RTMFPcontext, char *buf, unsigned int size);
+
+// Non-blocking RTMFP_ReadMedia
+// return : 1 if media is filled, 0 if nothing is available, -1 if an error occurs or the stream is closed
+LIBRTMFP_API int RTMFP_TryReadMedia(unsigned short streamId, unsigned int RTMFPcontext, RTMFPMedia* media, int flvTags);
+
+// Return the time (in msec, 100 at most) to wait before trying to read streamId again, to use as timeout of the event loop
+// (with the playout buffer the descriptors are signaled by the reception of media, not by the playout time)
+LIBRTMFP_API unsigned int RTMFP_GetReadDelay(unsigned int RTMFPcontext, unsigned short streamId);
+
+// Return a descriptor readable when the state of the connection changes or when media is available, to wait with poll/epoll/kqueue
+// (the connection functions are non-blocking with their blocking parameter set to 0)
+// RTMFP_GetState resets it, it is closed with the connection
+// return : the descriptor or -1 if an error occurs (not available on Windows)
+LIBRTMFP_API int RTMFP_GetDescriptor(unsigned int RTMFPcontext);
+
+// Return a descriptor readable while media is available for the stream streamId (reset by the read functions when nothing more is available)
+// return : the descriptor or -1 if an error occurs (not available on Windows)
+LIBRTMFP_API int RTMFP_GetStreamDescriptor(unsigned int RTMFPcontext, unsigned short streamId);
+
+// Return the state flags of the connection (RTMFP_STATE_*) and reset its descriptor, -1 if an error occurs
+LIBRTMFP_API int RTMFP_GetState(unsigned int RTMFPcontext);
+
 // Write size bytes of data into the current connexion
 // return the number of bytes used
 LIBRTMFP_API int RTMFP_Write(unsigned int RTMFPcontext, const char *buf, int size);
@@ -131,6 +225,18 @@ LIBRTMFP_API void RTMFP_ActiveDump();
 // Set Interrupt callback (to check if caller need the hand)
 LIBRTMFP_API void RTMFP_InterruptSetCallback(int (* interruptCb)(void*), void* argument);
 
+// Fill stats with the statistics of the buffer pool
+// Return 1 if succeed, 0 if RTMFP_Init has not been called
+LIBRTMFP_API int RTMFP_GetBufferStats(RTMFPBufferStats* stats);
+
+// Fill stats with the statistics of the playout buffer of the stream streamId (see RTMFPConfig.playoutMaxLatency)
+// Return 1 if succeed, 0 if the stream is not found or has no playout buffer
+LIBRTMFP_API int RTMFP_GetPlayoutStats(unsigned int RTMFPcontext, unsigned short streamId, RTMFPPlayoutStats* stats);
+
+// Fill stats with the statistics of the media queue of the stream streamId (see RTMFPConfig.queueSize)
+// Return 1 if succeed, 0 if the stream is not found
+LIBRTMFP_API int RTMFP_GetQueueStats(unsigned int RTMFPcontext, unsigned short streamId, RTMFPQueueStats* stats);
+
 // Retrieve publication name and url from original uri
 LIBRTMFP_API void RTMFP_GetPublicationAndUrlFromUri(const char* uri, char** publication);
 
@@ -15,6 +15,8 @@ details (or else see http://mozilla.org/MPL/2.0/).
 */
 
 #include "Base/BufferPool.h"
+#include "Base/Time.h"
+#include <thread>
 
 
 using namespace std;
@@ -22,32 +24,81 @@ using namespace std;
 
 namespace Base {
 
+struct BufferPool::Magazine : virtual Object {
+	Magazine(UInt32 poolId) : poolId(poolId), alive(true), allocations(0), reuses(0), requested(0), reserved(0) {
+		_lock.clear();
+		memset(counts, 0, sizeof(counts));
+		memset(minCounts, 0, sizeof(minCounts));
+	}
+
+	// Spin lock, only contended when the timer or clear() visit the magazine
+	void lock() { while (_lock.test_and_set(memory_order_acquire)) this_thread::yield(); }
+	void unlock() { _lock.clear(memory_order_release); }
+
+	const UInt32	poolId;
+	bool			alive; // false when its thread doesn't use it anymore
+	UInt8*			buffers[CLASSES][MAGAZINE_SIZE];
+	UInt8			counts[CLASSES];
+	UInt8			minCounts[CLASSES]; // minimum number of buffers during the trimming period
 
-BufferPool::BufferPool(const Timer&	timer) : _timer(timer), _minCount(0), _maxSize(0),
+	UInt64			allocations;
+	UInt64			reuses;
+	UInt64			requested;
+	UInt64			reserved;
+private:
+	atomic_flag		_lock;
+};
+
+static UInt32 Cached(const UInt8* counts) {
+	UInt32 count(0);
+	for (UInt8 index = 0; index < BufferPool::CLASSES; ++index)
+		count += counts[index];
+	return count;
+}
+
+BufferPool::BufferPool(const Timer&	timer) : _id([]() { static atomic<UInt32> Id(0); return ++Id; }()), _requests(0), _time(Time::Now()), _timer(timer),
 	_onTimer([this](UInt32)->UInt32 {
-		// remove bigger buffers
 		lock_guard<mutex> lock(_mutex);
-		if (_minCount > 100) // limit suppression, more than 100 it can take signifiant time!
-			_minCount = 100;
-		++_minCount;
-
-		// remove useless bigger buffer!
-		while (--_minCount) {
-			auto it(_buffers.end());
-			if ((--it)->first <= _maxSize)
-				break;
-			delete[] it->second;
-			_buffers.erase(it);
+		// Move the buffers unused during the period from magazines to depots (all the buffers if the thread is gone)
+		UInt64 requests(_stats.allocations + _stats.reuses);
+		auto it = _magazines.begin();
+		while (it != _magazines.end()) {
+			Magazine& magazine(**it);
+			magazine.lock();
+			for (UInt8 index = 0; index < CLASSES; ++index) {
+				flush(magazine, index, magazine.alive ? magazine.minCounts[index] : magazine.counts[index]);
+				magazine.minCounts[index] = magazine.counts[index];
+			}
+			requests += magazine.allocations + magazine.reuses;
+			if (magazine.alive) {
+				magazine.unlock();
+				++it;
+				continue;
+			}
+			_stats.allocations += magazine.allocations;
+			_stats.reuses += magazine.reuses;
+			_stats.requested += magazine.requested;
+			_stats.reserved += magazine.reserved;
+			magazine.unlock();
+			it = _magazines.erase(it);
 		}
-		// remove smaller buffer!
-		auto it = _buffers.begin();
-		while (_minCount--) {
-			delete[] it->second;
-			_buffers.erase(it++);
+		// Remove the buffers unused during the period from depots (the oldest first)
+		for (Depot& depot : _depots) {
+			lock_guard<mutex> lock(depot.mutex);
+			if (depot.minCount > 100) // limit suppression, more than 100 it can take signifiant time!
+				depot.minCount = 100;
+			auto itEnd(depot.buffers.begin() + depot.minCount);
+			for (auto it = depot.buffers.begin(); it != itEnd; ++it)
+				delete[] *it;
+			depot.buffers.erase(depot.buffers.begin(), itEnd);
+			depot.minCount = depot.buffers.size();
 		}
-		
-		_minCount = _buffers.size();
-		_maxSize = 0;
+
+		Int64 now(Time::Now());
+		if (now > _time)
+			_stats.rate = (requests - _requests) * 1000.0 / (now - _time);
+		_requests = requests;
+		_time = now;
 		return 10000;
 	}) {
 	_timer.set(_onTimer, 10000);
@@ -61,39 +112,155 @@ BufferPool::~BufferPool() {
 
 void BufferPool::clear() {
 	lock_guard<mutex> lock(_mutex);
-	for(const auto& it : _buffers)
-		delete [] it.second;
-	_buffers.clear();
+	for (const shared<Magazine>& pMagazine : _magazines) {
+		pMagazine->lock();
+		for (UInt8 index = 0; index < CLASSES; ++index) {
+			while (pMagazine->counts[index])
+				delete[] pMagazine->buffers[index][--pMagazine->counts[index]];
+			pMagazine->minCounts[index] = 0;
+		}
+		pMagazine->unlock();
+	}
+	for (Depot& depot : _depots) {
+		lock_guard<mutex> lock(depot.mutex);
+		for (UInt8* buffer : depot.buffers)
+			delete[] buffer;
+		depot.buffers.clear();
+		depot.minCount = 0;
+	}
 }
 
+UInt32 BufferPool::available() const {
+	UInt32 count(0);
+	lock_guard<mutex> lock(_mutex);
+	for (const shared<Magazine>& pMagazine : _magazines) {
+		pMagazine->lock();
+		count += Cached(pMagazine->counts);
+		pMagazine->unlock();
+	}
+	for (Depot& depot : _depots) {
+		lock_guard<mutex> lock(depot.mutex);
+		count += depot.buffers.size();
+	}
+	return count;
+}
 
-UInt8* BufferPool::allocate(UInt32& size) const {
-	// choose the bigger buffer 
+void BufferPool::stats(Stats& stats) const {
 	lock_guard<mutex> lock(_mutex);
-	if (size>_maxSize)
-		_maxSize = size;
+	stats = _stats;
+	for (const shared<Magazine>& pMagazine : _magazines) {
+		pMagazine->lock();
+		stats.allocations += pMagazine->allocations;
+		stats.reuses += pMagazine->reuses;
+		stats.requested += pMagazine->requested;
+		stats.reserved += pMagazine->reserved;
+		for (UInt8 index = 0; index < CLASSES; ++index)
+			stats.cached += UInt64(pMagazine->counts[index]) << (index + MIN_SHIFT);
+		pMagazine->unlock();
+	}
+	for (UInt8 index = 0; index < CLASSES; ++index) {
+		lock_guard<mutex> lock(_depots[index].mutex);
+		stats.cached += UInt64(_depots[index].buffers.size()) << (index + MIN_SHIFT);
+	}
+}
+
+BufferPool::Magazine& BufferPool::magazine() const {
+	thread_local struct Local {
+		~Local() { release(); }
+		void release() {
+			if (!pMagazine)
+				return;
+			// the pool gives back its buffers to the depots on next trimming
+			pMagazine->lock();
+			pMagazine->alive = false;
+			pMagazine->unlock();
+			pMagazine.reset();
+		}
+		shared<Magazine> pMagazine;
+	} Local;
+	if (Local.pMagazine && Local.pMagazine->poolId == _id)
+		return *Local.pMagazine;
+	Local.release(); // magazine of an other pool
+	Local.pMagazine.reset(new Magazine(_id));
+	lock_guard<mutex> lock(_mutex);
+	_magazines.emplace_back(Local.pMagazine);
+	return *Local.pMagazine;
+}
+
+void BufferPool::flush(Magazine& magazine, UInt8 index, UInt8 count) const {
+	if (!count)
+		return;
+	Depot& depot(_depots[index]);
+	lock_guard<mutex> lock(depot.mutex);
+	UInt8** end(magazine.buffers[index] + magazine.counts[index]);
+	depot.buffers.insert(depot.buffers.end(), end - count, end);
+	magazine.counts[index] -= count;
+	if (magazine.minCounts[index] > magazine.counts[index])
+		magazine.minCounts[index] = magazine.counts[index];
+}
+
+UInt8* BufferPool::allocate(UInt32& size) const {
+	Magazine& magazine(this->magazine());
+	// smallest class which fits
+	UInt8 index(0);
+	for (UInt32 rest = (size - 1) >> MIN_SHIFT; rest; rest >>= 1)
+		++index;
+
+	magazine.lock();
+	magazine.requested += size;
+	if (index >= CLASSES) {
+		// too big to be pooled
+		magazine.reserved += size;
+		++magazine.allocations;
+		magazine.unlock();
+		return new UInt8[size];
+	}
+	size = 1 << (index + MIN_SHIFT);
+	magazine.reserved += size;
 
-	if (_buffers.empty()) {
-		_minCount = 0;
-		return new UInt8[size]();
+	UInt8& count(magazine.counts[index]);
+	if (!count) {
+		// refill the half of the magazine from the depot
+		Depot& depot(_depots[index]);
+		lock_guard<mutex> lock(depot.mutex);
+		if (!depot.buffers.empty()) {
+			count = depot.buffers.size() < MAGAZINE_SIZE / 2 ? UInt8(depot.buffers.size()) : UInt8(MAGAZINE_SIZE / 2);
+			memcpy(magazine.buffers[index], depot.buffers.data() + depot.buffers.size() - count, count * sizeof(UInt8*));
+			depot.buffers.resize(depot.buffers.size() - count);
+			if (depot.buffers.size() < depot.minCount)
+				depot.minCount = depot.buffers.size();
+		}
 	}
-	// at less one available here
-	auto itBigger(_buffers.end());
-	--itBigger;
-	if (size > itBigger->first)
-		return new UInt8[size]();
-
-	size = itBigger->first;
-	UInt8* buffer(itBigger->second);
-	_buffers.erase(itBigger);
-	if (_buffers.size() < _minCount)
-		_minCount = _buffers.size();
+	if (!count) {
+		++magazine.allocations;
+		magazine.minCounts[index] = 0;
+		magazine.unlock();
+		return new UInt8[size];
+	}
+	UInt8* buffer(magazine.buffers[index][--count]);
+	if (count < magazine.minCounts[index])
+		magazine.minCounts[index] = count;
+	++magazine.reuses;
+	magazine.unlock();
 	return buffer;
 }
 
 void BufferPool::deallocate(UInt8* buffer, UInt32 size) const {
-	lock_guard<mutex> lock(_mutex);
-	_buffers.emplace(size,buffer);
+	// biggest class which can be served by this buffer (size can come from an other allocator)
+	if (size < (1 << MIN_SHIFT) || size >= (2 << MAX_SHIFT)) {
+		delete[] buffer;
+		return;
+	}
+	UInt8 index(0);
+	for (size >>= MIN_SHIFT + 1; size; size >>= 1)
+		++index;
+
+	Magazine& magazine(this->magazine());
+	magazine.lock();
+	if (magazine.counts[index] == MAGAZINE_SIZE) // full, give the half to the depot
+		flush(magazine, index, MAGAZINE_SIZE / 2);
+	magazine.buffers[index][magazine.counts[index]++] = buffer;
+	magazine.unlock();
 }
 
 
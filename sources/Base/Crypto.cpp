@@ -15,6 +15,13 @@ details (or else see http://mozilla.org/MPL/2.0/).
 */
 
 #include "Base/Crypto.h"
+#include "Base/Byte.h"
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+	#include <emmintrin.h>
+#endif
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+	#include <immintrin.h>
+#endif
 
 using namespace std;
 
@@ -79,17 +86,110 @@ UInt8* Crypto::HMAC::Compute(const EVP_MD* evp, const void* key, int keySize, co
 	return value;
 }
 
-UInt16 Crypto::ComputeChecksum(BinaryReader& reader) {
-	UInt32 sum = 0;
-	UInt32 pos(reader.position());
-	while(reader.available()>0)
-		sum += reader.available()==1 ? reader.read8() : reader.read16();
-	reader.reset(pos);
+namespace {
 
-  /* add back carry outs from top 16 bits to low 16 bits */
-  sum = (sum >> 16) + (sum & 0xffff);     /* add hi 16 to low 16 */
-  sum += (sum >> 16);                     /* add carry */
-  return ~sum; /* truncate to 16 bits */
+UInt32 Fold(UInt64 sum) {
+	/* add back carry outs from top 16 bits to low 16 bits */
+	while (sum >> 16)
+		sum = (sum >> 16) + (sum & 0xffff);
+	return UInt32(sum);
+}
+
+/*
+Kernels : sum of the native order 32 bits words (in one's complement it gives the
+same result as the 16 bits words once folded), they consume data while possible */
+UInt64 SumPortable(const UInt8*& data, UInt32& size) {
+	UInt64 sum(0);
+	UInt64 value;
+	for (; size >= 8; size -= 8, data += 8) {
+		memcpy(&value, data, 8);
+		sum += (value & 0xFFFFFFFF) + (value >> 32);
+	}
+	return sum;
+}
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+UInt64 SumSSE2(const UInt8*& data, UInt32& size) {
+	__m128i zero = _mm_setzero_si128();
+	__m128i sum = zero;
+	for (; size >= 16; size -= 16, data += 16) {
+		__m128i value = _mm_loadu_si128((const __m128i*)data);
+		sum = _mm_add_epi64(sum, _mm_unpacklo_epi32(value, zero));
+		sum = _mm_add_epi64(sum, _mm_unpackhi_epi32(value, zero));
+	}
+	UInt64 lanes[2];
+	_mm_storeu_si128((__m128i*)lanes, sum);
+	return lanes[0] + lanes[1] + SumPortable(data, size);
+}
+#endif
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+__attribute__((target("avx2"))) UInt64 SumAVX2(const UInt8*& data, UInt32& size) {
+	__m256i zero = _mm256_setzero_si256();
+	__m256i sum = zero;
+	for (; size >= 32; size -= 32, data += 32) {
+		__m256i value = _mm256_loadu_si256((const __m256i*)data);
+		sum = _mm256_add_epi64(sum, _mm256_unpacklo_epi32(value, zero));
+		sum = _mm256_add_epi64(sum, _mm256_unpackhi_epi32(value, zero));
+	}
+	UInt64 lanes[4];
+	_mm256_storeu_si256((__m256i*)lanes, sum);
+	return lanes[0] + lanes[1] + lanes[2] + lanes[3] + SumPortable(data, size);
+}
+#endif
+
+typedef UInt64 (*SumKernel)(const UInt8*& data, UInt32& size);
+SumKernel ChooseKernel() {
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+	if (__builtin_cpu_supports("avx2"))
+		return SumAVX2;
+#endif
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+	return SumSSE2;
+#else
+	return SumPortable;
+#endif
+}
+const SumKernel Sum(ChooseKernel());
+
+UInt32 AddChecksumBy(SumKernel kernel, UInt32 sum, const UInt8* data, UInt32 size) {
+	UInt32 words = Fold(kernel(data, size));
+	if (Byte::ORDER_NATIVE == Byte::ORDER_LITTLE_ENDIAN)
+		words = Byte::Flip16(words); // checksum words are big endian
+	UInt64 result = UInt64(sum) + words;
+	for (; size > 1; size -= 2, data += 2)
+		result += (data[0] << 8) | data[1];
+	if (size)
+		result += *data;
+	return Fold(result);
+}
+
+}
+
+UInt32 Crypto::AddChecksum(UInt32 sum, const UInt8* data, UInt32 size) {
+	return AddChecksumBy(Sum, sum, data, size);
+}
+
+bool Crypto::AddChecksum(ChecksumKernel kernel, UInt32& sum, const UInt8* data, UInt32 size) {
+	switch (kernel) {
+		case CHECKSUM_PORTABLE:
+			sum = AddChecksumBy(SumPortable, sum, data, size);
+			return true;
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+		case CHECKSUM_SSE2:
+			sum = AddChecksumBy(SumSSE2, sum, data, size);
+			return true;
+#endif
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+		case CHECKSUM_AVX2:
+			if (!__builtin_cpu_supports("avx2"))
+				return false;
+			sum = AddChecksumBy(SumAVX2, sum, data, size);
+			return true;
+#endif
+		default:
+			return false;
+	}
 }
 
 
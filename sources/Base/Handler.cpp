@@ -36,15 +36,13 @@ void Handler::queue(const Event<void()>& onResult) const {
 UInt32 Handler::flush(UInt32 count) {
 	bool all(count==0);
 	UInt32 done(0);
-	for (;;) {
+	// reset before draining, a runner queued now will signal again
+	_signaled = false;
+	atomic_thread_fence(memory_order_seq_cst);
+	while (all || count--) {
 		shared<Runner> pRunner;
-		{
-			lock_guard<mutex> lock(_mutex);
-			if (_runners.empty() || (!all && count--))
-				break;
-			pRunner = move(_runners.front());
-			_runners.pop_front();
-		}
+		if (!_runners.pop(pRunner))
+			break;
 		Exception ex;
 		Thread::ChangeName newName(pRunner->name);
 		AUTO_ERROR(pRunner->run(ex), newName);
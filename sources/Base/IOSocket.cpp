@@ -15,6 +15,7 @@ details (or else see http://mozilla.org/MPL/2.0/).
 */
 
 #include "Base/IOSocket.h"
+#include "Base/Logs.h"
 #if defined(_BSD)
     #include <sys/types.h>
     #include <sys/event.h>
@@ -384,9 +385,45 @@ void IOSocket::read(const shared<Socket>& pSocket, int error) {
 			ThreadQueue*		_pThread;
 		};
 
+		typedef std::vector<std::pair<shared<Buffer>, SocketAddress>> Datagrams;
+		struct Batch : Action::Handle {
+			Batch(const char* name, const shared<Socket>& pSocket, const Exception& ex, Datagrams& datagrams, bool& stop) :
+				Action::Handle(name, pSocket, ex), _datagrams(move(datagrams)), _receiving(0), _pThread(NULL) {
+				for (auto& it : _datagrams)
+					_receiving += it.first->size();
+				if ((pSocket->_receiving += _receiving) < pSocket->recvBufferSize())
+					return;
+				stop = true;
+				_pThread = ThreadQueue::Current();
+				++pSocket->_reading;
+			}
+		private:
+			void handle(const shared<Socket>& pSocket) {
+				for (auto& it : _datagrams)
+					pSocket->onReceived(it.first, it.second);
+				UInt32 receiving = pSocket->_receiving -= _receiving;
+				if (!_pThread)
+					return;
+				if (receiving < pSocket->recvBufferSize()) {
+					// REARM
+					Exception ex;
+					if (!_pThread->queue(ex, make_shared<Receive>(0, pSocket)))
+						pSocket->onError(ex);
+				} else
+					--pSocket->_reading;
+			}
+			Datagrams			_datagrams;
+			UInt32				_receiving;
+			ThreadQueue*		_pThread;
+		};
+
 		bool process(Exception& ex, const shared<Socket>& pSocket) {
 			if (!pSocket->_reading--) // me and something else! useless!
 				return true;
+#if defined(HAS_MMSG)
+			if (pSocket->type == Socket::TYPE_DATAGRAM && !pSocket->isSecure())
+				return processDatagrams(ex, pSocket);
+#endif
 			UInt32 available = pSocket->available();
 			bool stop(false);
 			while (!stop) {
@@ -432,6 +469,71 @@ void IOSocket::read(const shared<Socket>& pSocket, int error) {
 			};
 			return true;
 		}
+
+		bool processDatagrams(Exception& ex, const shared<Socket>& pSocket) {
+			// Receive up to SLAB_COUNT datagrams per system call directly in buffers of the pool,
+			// then dispatch them with only one handle. A datagram which fits a smaller size class of the pool
+			// is copied in a right-sized buffer and its slot is reused, to not hold SLAB_SIZE bytes for each ack or ping
+			enum {
+				SLAB_COUNT = 32,
+				SLAB_SIZE = 2048, // greater than max possible MTU (~1500 bytes)
+				COPY_MAX = SLAB_SIZE / 2
+			};
+			shared<Buffer>	slots[SLAB_COUNT];
+			UInt8*			buffers[SLAB_COUNT];
+			UInt32			sizes[SLAB_COUNT];
+			SocketAddress	addresses[SLAB_COUNT];
+			bool stop(false);
+			while (!stop) {
+				// refill the slots given to the previous batch
+				for (UInt32 i = 0; i < SLAB_COUNT; ++i) {
+					if (slots[i])
+						slots[i]->resize(SLAB_SIZE, false);
+					else
+						slots[i].reset(new Buffer(SLAB_SIZE));
+					buffers[i] = slots[i]->data();
+				}
+				bool queueing(pSocket->queueing() ? true : false);
+				int received = pSocket->receiveFrom(ex, buffers, SLAB_SIZE, SLAB_COUNT, sizes, addresses);
+				if (received < 0) {
+					if (ex.cast<Ex::Net::Socket>().code != NET_EWOULDBLOCK)
+						return false;
+					ex = nullptr;
+					if (queueing)
+						Send(0, pSocket).process(ex, pSocket);
+					if (pSocket->available())
+						continue;
+					break;
+				}
+				Datagrams datagrams;
+				datagrams.reserve(received);
+				for (int i = 0; i < received; ++i) {
+					if (sizes[i] > SLAB_SIZE) {
+						WARN("Datagram of ", sizes[i], " bytes from ", addresses[i], " truncated, dropped");
+						continue; // slot reused
+					}
+					shared<Buffer> pBuffer;
+					if (sizes[i] <= COPY_MAX)
+						pBuffer.reset(new Buffer(sizes[i], buffers[i])); // slot reused
+					else {
+						pBuffer = move(slots[i]);
+						pBuffer->resize(sizes[i]);
+					}
+					if (pSocket->pDecoder) {
+						UInt32 decoded = pSocket->pDecoder->decode(pBuffer, addresses[i], pSocket);
+						if (pBuffer && decoded < pBuffer->size())
+							pBuffer->resize(decoded);
+					}
+					if (pBuffer)
+						datagrams.emplace_back(move(pBuffer), addresses[i]);
+				}
+				if (!datagrams.empty())
+					handle<Batch>(pSocket, datagrams, stop);
+				if (received < SLAB_COUNT && !pSocket->available())
+					break;
+			}
+			return true;
+		}
 	};
 
 	Action::Run(threadPool, make_shared<Receive>(error, pSocket), pSocket->_threadReceive);
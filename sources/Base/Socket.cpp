@@ -367,6 +367,66 @@ int Socket::receive(Exception& ex, void* buffer, UInt32 size, int flags, SocketA
 	return rc;
 }
 
+int Socket::receiveFrom(Exception& ex, UInt8* const* buffers, UInt32 size, UInt32 count, UInt32* sizes, SocketAddress* addresses, int flags) {
+#if defined(HAS_MMSG)
+	if (type == TYPE_DATAGRAM && !isSecure() && count > 1) {
+		if (_sockex) {
+			ex = _sockex;
+			return -1;
+		}
+		if (count > BATCH_MAX)
+			count = BATCH_MAX;
+		union Address {
+			struct sockaddr_in  sa_in;
+			struct sockaddr_in6 sa_in6;
+		};
+		mmsghdr	msgs[BATCH_MAX];
+		iovec	iovs[BATCH_MAX];
+		Address	addrs[BATCH_MAX];
+		memset(msgs, 0, sizeof(mmsghdr)*count);
+		for (UInt32 i = 0; i < count; ++i) {
+			iovs[i].iov_base = buffers[i];
+			iovs[i].iov_len = size;
+			msgs[i].msg_hdr.msg_name = &addrs[i];
+			msgs[i].msg_hdr.msg_namelen = sizeof(Address);
+			msgs[i].msg_hdr.msg_iov = &iovs[i];
+			msgs[i].msg_hdr.msg_iovlen = 1;
+		}
+		int rc;
+		int error(0);
+		do {
+			rc = ::recvmmsg(_sockfd, msgs, count, flags | MSG_TRUNC, NULL); // MSG_TRUNC => msg_len is the real datagram size
+		} while (rc < 0 && (error = Net::LastError()) == NET_EINTR);
+		if (rc < 0) {
+			if (error == NET_EAGAIN)
+				error = NET_EWOULDBLOCK;
+			SetException(ex, error, " (count=", count, ", size=", size, ", flags=", flags, ")");
+			return -1;
+		}
+		if (!_address)
+			_address.set(IPAddress::Loopback(), 0); // to advise that address is computable
+		for (int i = 0; i < rc; ++i) {
+			sizes[i] = msgs[i].msg_len;
+			if ((msgs[i].msg_hdr.msg_flags & MSG_TRUNC) && sizes[i] <= size)
+				sizes[i] = size + 1;
+			addresses[i].set(reinterpret_cast<const sockaddr&>(addrs[i]));
+			receive(sizes[i]);
+		}
+		return rc;
+	}
+#endif
+	// fallback, one datagram
+#if defined(HAS_MMSG)
+	if (type == TYPE_DATAGRAM && !isSecure())
+		flags |= MSG_TRUNC; // returns the real datagram size
+#endif
+	int rc = receive(ex, buffers[0], size, flags, addresses);
+	if (rc < 0)
+		return -1;
+	sizes[0] = rc;
+	return 1;
+}
+
 int Socket::sendTo(Exception& ex, const void* data, UInt32 size, const SocketAddress& address, int flags) {
 	if (_sockex) {
 		ex = _sockex;
@@ -436,6 +496,72 @@ int Socket::write(Exception& ex, const Packet& packet, const SocketAddress& addr
 	return sent;
 }
 
+int Socket::write(Exception& ex, const Packet* packets, UInt32 count, const SocketAddress& address, int flags) {
+#if defined(HAS_MMSG)
+	if (type == TYPE_DATAGRAM && !isSecure() && count > 1) {
+		lock_guard<mutex> lock(_mutexSending);
+		if (_sockex) {
+			ex = _sockex;
+			return -1;
+		}
+		const SocketAddress& target(address ? address : _peerAddress);
+		UInt32 done(0);
+		if (_sendings.empty()) {
+			flags |= MSG_NOSIGNAL;
+			mmsghdr	msgs[BATCH_MAX];
+			iovec	iovs[BATCH_MAX];
+			while (done < count) {
+				UInt32 batch = count - done;
+				if (batch > BATCH_MAX)
+					batch = BATCH_MAX;
+				for (UInt32 i = 0; i < batch; ++i) {
+					const Packet& packet(packets[done + i]);
+					iovs[i].iov_base = (void*)packet.data();
+					iovs[i].iov_len = packet.size();
+					memset(&msgs[i], 0, sizeof(mmsghdr));
+					if (target) {
+						msgs[i].msg_hdr.msg_name = (void*)target.data();
+						msgs[i].msg_hdr.msg_namelen = target.size();
+					}
+					msgs[i].msg_hdr.msg_iov = &iovs[i];
+					msgs[i].msg_hdr.msg_iovlen = 1;
+				}
+				int rc;
+				int error(0);
+				do {
+					rc = ::sendmmsg(_sockfd, msgs, batch, flags);
+				} while (rc < 0 && (error = Net::LastError()) == NET_EINTR);
+				if (rc < 0) {
+					if (error == NET_EAGAIN)
+						error = NET_EWOULDBLOCK;
+					if (error == NET_EWOULDBLOCK || (error == NET_ENOTCONN && _peerAddress))
+						break; // queue and wait onFlush, no error!
+					SetException(ex, error, " (address=", target, ", count=", batch, ", flags=", flags, ")");
+					return done ? done : -1; // datagrams not sent are lost
+				}
+				if (!_address)
+					_address.set(IPAddress::Loopback(), 0); // to advise that address is computable
+				for (int i = 0; i < rc; ++i)
+					send(msgs[i].msg_len);
+				done += rc; // if partial the next call will give the reason
+			}
+		}
+		// queue the remaining packets
+		for (UInt32 i = done; i < count; ++i) {
+			_sendings.emplace_back(packets[i], target, flags);
+			_queueing += packets[i].size();
+		}
+		return count;
+	}
+#endif
+	// fallback, one system call per packet
+	for (UInt32 i = 0; i < count; ++i) {
+		if (write(ex, packets[i], address, flags) < 0)
+			return i ? i : -1;
+	}
+	return count;
+}
+
 bool Socket::flush(Exception& ex) {
 	if (_sockex) {
 		ex = _sockex;
@@ -0,0 +1,87 @@
+/*
+This file is a part of MonaSolutions Copyright 2017
+mathieu.poux[a]gmail.com
+jammetthomas[a]gmail.com
+
+This program is free software: you can redistribute it and/or
+modify it under the terms of the the Mozilla Public License v2.0.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+Mozilla Public License v. 2.0 received along this program for more
+details (or else see http://mozilla.org/MPL/2.0/).
+
+*/
+
+#include "Base/ThreadPool.h"
+
+
+using namespace std;
+
+
+namespace Base {
+
+ThreadPool::ThreadPool(UInt16 threads) : _threads(threads ? threads : Thread::ProcessorCount()*2), _current(0), _stealable(0) {
+	_size = UInt16(_threads.size());
+	UInt16 index(0);
+	for (Thread& thread : _threads) {
+		thread.pPool = this;
+		thread.index = index++;
+	}
+}
+
+bool ThreadPool::queue(Exception& ex, shared<Runner>&& pRunner) const {
+	Thread& thread = _threads[_current++%_size];
+	{
+		lock_guard<mutex> lock(thread.mutex);
+		thread.runners.emplace_back(pRunner);
+		++thread.stealable;
+	}
+	++_stealable; // after the push, a thread which sees it will find the runner
+
+	// Is the thread busy? if yes wake up another one to steal the runner
+	bool busy = thread.running() && !thread.sleeping();
+	if (!thread.awake(ex)) {
+		// Impossible to start the thread, give back the runner to the caller if nobody has taken it
+		lock_guard<mutex> lock(thread.mutex);
+		for (auto it = thread.runners.begin(); it != thread.runners.end(); ++it) {
+			if (*it != pRunner)
+				continue;
+			thread.runners.erase(it);
+			--thread.stealable;
+			--_stealable;
+			return false;
+		}
+		return true;
+	}
+	if (!busy)
+		return true;
+	for (UInt16 i = 1; i < _size; ++i) {
+		if (_threads[(thread.index + i) % _size].wake())
+			break;
+	}
+	return true;
+}
+
+bool ThreadPool::steal(UInt16 index, shared<Runner>& pRunner) const {
+	if (!_stealable)
+		return false;
+	for (UInt16 i = 0; i < _size; ++i) {
+		Thread& thread = _threads[(index + i) % _size];
+		if (!thread.stealable)
+			continue;
+		lock_guard<mutex> lock(thread.mutex);
+		if (thread.runners.empty())
+			continue;
+		pRunner = move(thread.runners.front());
+		thread.runners.pop_front();
+		--thread.stealable;
+		--_stealable;
+		return true;
+	}
+	return false;
+}
+
+
+} // namespace Base
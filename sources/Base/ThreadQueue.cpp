@@ -27,29 +27,40 @@ thread_local ThreadQueue* ThreadQueue::_PCurrent(NULL);
 
 bool ThreadQueue::run(Exception&, const volatile bool& stopping) {
 	_PCurrent = this;
+	_idle = false;
 
 	for (;;) {
 
-		bool timeout = !wakeUp.wait(120000); // 2 mn of timeout
+		// _sleeping before checking runners, a producer sees it or the runner is seen here
+		_sleeping = true;
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		shared<Runner> pRunner;
+		bool timeout = !_runners.pop(pRunner) && !pull(pRunner) && !wakeUp.wait(120000); // 2 mn of timeout
+		_sleeping = false;
 		
 		for (;;) {
-			shared<Runner> pRunner;
-			{
-				std::lock_guard<std::mutex> lock(_mutex);
-				if(_runners.empty()) {
-					if (timeout)
+			if (!pRunner && !_runners.pop(pRunner) && !pull(pRunner)) {
+				if (stopping)
+					return true;
+				if (!timeout)
+					break;
+				// inactivity, stop the thread (the next queue will restart it)
+				_idle = true;
+				std::atomic_thread_fence(std::memory_order_seq_cst);
+				{
+					std::lock_guard<std::mutex> lock(_mutex);
+					if (!_runners.pop(pRunner) && !pull(pRunner)) {
 						stop(); // to set _stop immediatly!
-					if (stopping)
 						return true;
-					break;
+					}
+					_idle = false;
 				}
-				pRunner = move(_runners.front());
-				_runners.pop_front();
 			}
 
 			Exception ex;
 			setName(pRunner->name);
 			AUTO_ERROR(pRunner->run(ex), pRunner->name);
+			pRunner.reset();
 		}
 	}
 	return true;
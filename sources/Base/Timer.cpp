@@ -23,7 +23,132 @@ using namespace std;
 
 namespace Base {
 
+/*!
+Hierarchical timing wheel: a root level of 256 slots of 1ms, then 4 levels of 64 slots,
+each slot of a level covers the whole previous level (256ms, 16s, 17mn, 18h), so ~49 days.
+A timer is linked in the slot of its raising time in the lowest level which can contain it,
+and the timers of an upper slot are dispatched in the lower levels when the root level
+wraps around to it (cascade) */
+struct Timer::Wheel : virtual Object {
+	enum {
+		ROOT_BITS = 8,
+		ROOT_SIZE = 1 << ROOT_BITS,
+		LEVEL_BITS = 6,
+		LEVEL_SIZE = 1 << LEVEL_BITS,
+		LEVELS = 4 // levels above root
+	};
+
+	Wheel() : current(Time::Now()) {
+		memset(_root, 0, sizeof(_root));
+		memset(_rootBits, 0, sizeof(_rootBits));
+		memset(_levels, 0, sizeof(_levels));
+	}
+
+	Int64	current; // last time processed
+
+	bool contains(const OnTimer& onTimer) const {
+		return (onTimer._ppSlot >= _root && onTimer._ppSlot < _root + ROOT_SIZE) || (onTimer._ppSlot >= &_levels[0][0] && onTimer._ppSlot < &_levels[0][0] + LEVELS*LEVEL_SIZE);
+	}
+
+	void add(const OnTimer& onTimer) {
+		Int64 time(onTimer._nextRaising);
+		UInt64 delta(time - current);
+		const OnTimer** ppSlot;
+		if (delta < ROOT_SIZE) {
+			UInt8 index(time & (ROOT_SIZE - 1));
+			_rootBits[index >> 6] |= 1ull << (index & 63);
+			ppSlot = &_root[index];
+		} else {
+			if (delta > 0xFFFFFFFF)
+				time = current + 0xFFFFFFFF; // beyond the wheel, wait in the last level (cascaded again later)
+			UInt8 level(0);
+			while (level < (LEVELS - 1) && delta >= (1ull << (ROOT_BITS + LEVEL_BITS*(level + 1))))
+				++level;
+			ppSlot = &_levels[level][(time >> (ROOT_BITS + LEVEL_BITS*level)) & (LEVEL_SIZE - 1)];
+		}
+		onTimer._ppSlot = ppSlot;
+		onTimer._pPrevious = NULL;
+		if ((onTimer._pNext = *ppSlot))
+			onTimer._pNext->_pPrevious = &onTimer;
+		*ppSlot = &onTimer;
+	}
+
+	void remove(const OnTimer& onTimer) {
+		if (onTimer._pNext)
+			onTimer._pNext->_pPrevious = onTimer._pPrevious;
+		if (onTimer._pPrevious)
+			onTimer._pPrevious->_pNext = onTimer._pNext;
+		else if (!(*onTimer._ppSlot = onTimer._pNext) && onTimer._ppSlot < _root + ROOT_SIZE) {
+			UInt8 index(UInt8(onTimer._ppSlot - _root));
+			_rootBits[index >> 6] &= ~(1ull << (index & 63));
+		}
+		onTimer._ppSlot = NULL;
+		onTimer._pNext = onTimer._pPrevious = NULL;
+	}
+
+	/*!
+	Return the first timer of the root slot of current time (to raise) */
+	const OnTimer* first() const { return _root[current & (ROOT_SIZE - 1)]; }
+
+	/*!
+	Return the time of the next root slot to raise, or the time of the next cascade if the root level is empty until it */
+	Int64 next() const {
+		UInt32 index((current & (ROOT_SIZE - 1)) + 1);
+		while (index < ROOT_SIZE) {
+			UInt64 bits(_rootBits[index >> 6] >> (index & 63));
+			if (bits) {
+				while (!(bits & 1)) {
+					bits >>= 1;
+					++index;
+				}
+				return (current & ~Int64(ROOT_SIZE - 1)) + index;
+			}
+			index = (index | 63) + 1;
+		}
+		return (current | (ROOT_SIZE - 1)) + 1;
+	}
+
+	/*!
+	Called when current time reaches the begin of the root level, dispatch the upper slots reached */
+	void cascade() {
+		for (UInt8 level = 0; level < LEVELS; ++level) {
+			UInt8 index((current >> (ROOT_BITS + LEVEL_BITS*level)) & (LEVEL_SIZE - 1));
+			const OnTimer* pTimer(_levels[level][index]);
+			_levels[level][index] = NULL;
+			while (pTimer) {
+				const OnTimer* pNext(pTimer->_pNext);
+				add(*pTimer);
+				pTimer = pNext;
+			}
+			if (index)
+				break; // upper level not reached
+		}
+	}
+
+	void clear() {
+		for (const OnTimer* pTimer : _root) {
+			for (; pTimer; pTimer = pTimer->_pNext)
+				pTimer->_nextRaising = 0;
+		}
+		for (UInt8 level = 0; level < LEVELS; ++level) {
+			for (const OnTimer* pTimer : _levels[level]) {
+				for (; pTimer; pTimer = pTimer->_pNext)
+					pTimer->_nextRaising = 0;
+			}
+		}
+	}
+
+private:
+	const OnTimer*	_root[ROOT_SIZE];
+	UInt64			_rootBits[ROOT_SIZE / 64]; // non-empty root slots
+	const OnTimer*	_levels[LEVELS][LEVEL_SIZE];
+};
+
+Timer::Timer(Type type) : _count(0), type(type), _pWheel(type == TYPE_WHEEL ? new Wheel() : NULL) {}
+
 Timer::~Timer() {
+	if (_pWheel)
+		_pWheel->clear();
 	for(const auto& it : _timers) {
 		for (const OnTimer* pTimer : *it.second)
 			pTimer->_nextRaising = 0;
@@ -31,6 +156,18 @@ Timer::~Timer() {
 }
 
 void Timer::set(const OnTimer& onTimer,  UInt32 timeout) const {
+	if (_pWheel) {
+		if (onTimer._nextRaising) {
+			if (!_pWheel->contains(onTimer)) {
+				FATAL_ERROR("Timer already used on an other Timer machine, create both individual Timer::Type rather");
+				return;
+			}
+			_pWheel->remove(onTimer);
+			onTimer._nextRaising = 0;
+			--_count;
+		}
+		return add(onTimer, timeout);
+	}
 	shared<std::set<const OnTimer*>> pMove;
 	if (!remove(onTimer, pMove))
 		return add(onTimer, timeout);
@@ -49,6 +186,10 @@ void Timer::add(const OnTimer& onTimer,  UInt32 timeout) const {
 	if (!timeout)
 		return;
 	++_count;
+	if (_pWheel) {
+		onTimer._nextRaising = Time::Now() + timeout;
+		return _pWheel->add(onTimer);
+	}
 	auto& it(_timers[(onTimer._nextRaising=Time::Now() + timeout)]);
 	if (!it)
 		it.reset(new std::set<const OnTimer*>());
@@ -76,6 +217,8 @@ bool Timer::remove(const OnTimer& onTimer, shared<std::set<const OnTimer*>>& pMo
 }
 
 UInt32 Timer::raise() {
+	if (_pWheel)
+		return raiseWheel();
 	while (!_timers.empty()) {
 		const auto& it(_timers.begin());
 		Int64 waiting(it->first-Time::Now());
@@ -94,5 +237,32 @@ UInt32 Timer::raise() {
 	return 0; //empty!
 }
 
+UInt32 Timer::raiseWheel() {
+	Wheel& wheel(*_pWheel);
+	Int64 now(Time::Now());
+	while (_count) {
+		Int64 next(wheel.next());
+		if (next > now) {
+			wheel.current = now; // no slot and no cascade until now
+			return UInt32(next - now); // > 0!
+		}
+		wheel.current = next;
+		if (!(next & (Wheel::ROOT_SIZE - 1)))
+			wheel.cascade();
+		// the timers added while raising can't go in this slot (raising time > now >= current)
+		while (const OnTimer* pTimer = wheel.first()) {
+			wheel.remove(*pTimer);
+			UInt32 delay(UInt32(now - pTimer->_nextRaising));
+			pTimer->_nextRaising = 0;
+			--_count;
+			UInt32 timeout = (*pTimer)(delay);
+			if (timeout)
+				add(*pTimer, timeout);
+		}
+	}
+	wheel.current = now;
+	return 0; //empty!
+}
+
 
 } // namespace Base
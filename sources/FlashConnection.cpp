@@ -36,6 +36,7 @@ FlashConnection::~FlashConnection() {
 	for (auto& it : _streams) {
 		it.second->onStatus = nullptr;
 		it.second->onMedia = nullptr;
+		it.second->onMediaFragments = nullptr;
 		it.second->onPlay = nullptr;
 		it.second->onNewPeer = nullptr;
 		it.second->onGroupHandshake = nullptr;
@@ -69,6 +70,7 @@ FlashStream* FlashConnection::addStream(UInt16 id, shared_ptr<FlashStream>& pStr
 	_streams[id] = pStream;
 	pStream->onStatus = onStatus;
 	pStream->onMedia = onMedia;
+	pStream->onMediaFragments = onMediaFragments;
 	pStream->onPlay = onPlay;
 	pStream->onNewPeer = onNewPeer;
 	pStream->onGroupHandshake = onGroupHandshake;
@@ -46,6 +46,24 @@ bool FlashStream::process(const Packet& packet, UInt64 flowId, UInt64 writerId,
 	return FlashHandler::process(type, time, Packet(packet, reader.current(), reader.available()), flowId, writerId, lostRate);
 }
 
+bool FlashStream::process(const RTMFP::Fragments& fragments, UInt64 flowId, UInt64 writerId, double lostRate) {
+	const Packet& first(fragments.front());
+	// type + time + the first bytes of the media (to check codec infos)
+	if (first.size() > 6 && (*first.data() == AMF::TYPE_AUDIO || *first.data() == AMF::TYPE_VIDEO)) {
+		BinaryReader reader(first.data(), first.size());
+		AMF::Type type = (AMF::Type)reader.read8();
+		UInt32 time = reader.read32();
+		RTMFP::Fragments media;
+		media.add(Packet(first, reader.current(), reader.available()));
+		for (auto it = fragments.begin() + 1; it != fragments.end(); ++it)
+			media.add(*it);
+		if (onMediaFragments(_mediaId, time, media, lostRate, type))
+			return true;
+	}
+	Packet packet;
+	return process(fragments.linearize(packet), flowId, writerId, lostRate);
+}
+
 bool FlashStream::messageHandler(const string& name, AMFReader& message, UInt64 flowId, UInt64 writerId, double callbackHandler) {
 	/*** P2P Publisher part ***/
 	if (name == "play") {
@@ -31,8 +31,9 @@ along with Librtmfp.  If not, see <http://www.gnu.org/licenses/>.
 using namespace Base;
 using namespace std;
 
-FlowManager::FlowManager(bool responder, Invoker& invoker, OnSocketError pOnSocketError, OnStatusEvent pOnStatusEvent) : _invoker(invoker), _pOnStatusEvent(pOnStatusEvent), _pOnSocketError(pOnSocketError),
-	status(RTMFP::STOPPED), _tag(16, '\0'), _sessionId(0), _pListener(NULL), _mainFlowId(0), _initiatorTime(-1), _responder(responder), _nextRTMFPWriterId(2), _farId(0), _threadSend(0), _ping(0) {
+FlowManager::FlowManager(bool responder, Invoker& invoker, OnSocketError pOnSocketError, OnStatusEvent pOnStatusEvent, UInt8 congestionType, UInt16 pacingBurst, const RTMFPFEC::Config& fec) : _invoker(invoker), _pOnStatusEvent(pOnStatusEvent), _pOnSocketError(pOnSocketError),
+	status(RTMFP::STOPPED), congestionType(congestionType), pacingBurst(pacingBurst), fec(fec), _tag(16, '\0'), _sessionId(0), _pListener(NULL), _mainFlowId(0), _initiatorTime(-1), _responder(responder), _nextRTMFPWriterId(2), _farId(0), _threadSend(0), _ping(0), _lastTimeEcho(-1), _srtt(0), _rttvar(0), _rto(Net::RTO_INIT),
+	_ackWaiting(0), _dataPackets(0), _ackPackets(0) {
 
 	_pMainStream.reset(new FlashConnection());
 	_pMainStream->onStatus = [this](const string& code, const string& description, UInt16 streamId, UInt64 flowId, double cbHandler) {
@@ -66,6 +67,7 @@ FlowManager::~FlowManager() {
 	if (_pMainStream) {
 		_pMainStream->onStatus = nullptr;
 		_pMainStream->onMedia = nullptr;
+		_pMainStream->onMediaFragments = nullptr;
 		_pMainStream->onPlay = nullptr;
 	}
 }
@@ -112,6 +114,7 @@ void FlowManager::flushWriters() {
 		pWriter->flush();
 		if (pWriter->consumed()) {
 			DEBUG("Writer ", pWriter->id, " of Session ", name(), " consumed")
+			pWriter->release();
 			_flowWriters.erase(it++);
 			continue;
 		}
@@ -124,6 +127,13 @@ void FlowManager::sendCloseChunk(bool abrupt) {
 	_lastClose.update();
 }
 
+double FlowManager::repeatEfficiency() const {
+	if (!_pSendSession)
+		return 1;
+	UInt64 repeats = _pSendSession->repeats;
+	return repeats ? (double(_pSendSession->usefulRepeats) / repeats) : 1;
+}
+
 void FlowManager::close(bool abrupt) {
 	if (status == RTMFP::FAILED)
 		return;
@@ -131,6 +141,11 @@ void FlowManager::close(bool abrupt) {
 	// Send the close message
 	if (status >= RTMFP::CONNECTED)
 		sendCloseChunk(abrupt);
+	if (status <= RTMFP::CONNECTED) {
+		DEBUG("Session ", name(), " has sent ", _ackPackets, " acknowledgments for ", _dataPackets, " data packets received")
+		if (_pSendSession)
+			DEBUG("Session ", name(), " has repeated ", _pSendSession->repeats.load(), " packets (efficiency ", repeatEfficiency(), ")")
+	}
 
 	// Close writers
 	if (!_flowWriters.empty()) {
@@ -159,6 +174,7 @@ void FlowManager::receive(const Packet& packet) {
 	UInt8 flags;
 	RTMFPFlow* pFlow = NULL;
 	UInt64 stage = 0;
+	bool acknowledge(false), ackNow(false); // flow data received, and true if the acknowledgment must not be delayed
 
 	BinaryReader reader(packet.data(), packet.size());
 	UInt8 type = reader.available()>0 ? reader.read8() : 0xFF;
@@ -235,26 +251,39 @@ void FlowManager::receive(const Packet& packet) {
 			UInt64 ackStage(message.read7BitLongValue());
 			shared_ptr<RTMFPWriter> pWriter;
 			if (writer(id, pWriter)) {
-				UInt32 lostCount(0);
-				if (message.available()) {
-					++lostCount;
-					if (type == 0x50) {
-						UInt8 i;
-						do {
-							UInt8 bits(message.read8());
-							for (i = 0; i < 8; ++i) {
-								if (bits & 1)
-									break;
-								++lostCount;
-								bits >>= 1;
+				// Lost ranges
+				RTMFPSender::Losts losts;
+				UInt64 current(losts.stageReceived = ackStage);
+				if (type == 0x50) {
+					// bitfield of the stages received after ackStage + 1
+					UInt64 lostStage(++current);
+					while (message.available()) {
+						UInt8 bits(message.read8());
+						for (UInt8 i = 0; i < 8; ++i, bits >>= 1) {
+							if (!(bits & 1)) {
+								if (!lostStage)
+									lostStage = current + 1;
+							} else {
+								if (lostStage) {
+									losts.emplace_back(lostStage, current);
+									lostStage = 0;
+								}
+								losts.stageReceived = current + 1;
 							}
-
-						} while (i == 8 && message.available());
+							++current;
+						}
 					}
-					else
-						lostCount += UInt32(message.read7BitLongValue());
+				} else {
+					// 7bit ranges: lost count - 1, received count - 1
+					while (message.available()) {
+						UInt64 lostStage(current + 1);
+						current += message.read7BitLongValue() + 1;
+						losts.emplace_back(lostStage, current);
+						current += message.read7BitLongValue() + 1;
+					}
+					losts.stageReceived = current;
 				}
-				pWriter->acquit(ackStage, lostCount);
+				pWriter->acquit(ackStage, losts);
 			}
 			else
 				DEBUG("Writer ", id, " unfound for acknowledgment ", ackStage, " stage on session ", name(), ", certainly an obsolete message (writer closed)");
@@ -281,6 +310,7 @@ void FlowManager::receive(const Packet& packet) {
 				message.read(message.read8(), signature);
 
 				UInt64 idWriterRef = 0;
+				UInt8 fecScheme(RTMFPFEC::SCHEME_NONE);
 				if (message.read8()>0) {
 
 					// Fullduplex header part
@@ -289,11 +319,16 @@ void FlowManager::receive(const Packet& packet) {
 					else
 						idWriterRef = message.read7BitLongValue(); // RTMFPWriter ID related to this flow
 
-					// Useless header part 
+					// Other header parts
 					UInt8 length = message.read8();
 					while (length>0 && message.available()) {
-						WARN("Unknown message part on flow ", flowId);
-						message.next(length);
+						if (length == 2 && message.current()[0] == RTMFPFEC::OPTION) {
+							message.next(1);
+							fecScheme = message.read8(); // FEC offer (librtmfp extension)
+						} else {
+							WARN("Unknown message part on flow ", flowId);
+							message.next(length);
+						}
 						length = message.read8();
 					}
 					if (length>0) {
@@ -302,8 +337,10 @@ void FlowManager::receive(const Packet& packet) {
 					}
 				}
 
-				if (!pFlow)
-					pFlow = createFlow(flowId, signature, idWriterRef);
+				if (!pFlow && (pFlow = createFlow(flowId, signature, idWriterRef)) && fecScheme) {
+					DEBUG("FEC offered on flow ", flowId, " in session ", name())
+					pFlow->setFEC(fecScheme); // accepted with the acknowledgments
+				}
 			}
 
 			if (!pFlow) {
@@ -333,6 +370,33 @@ void FlowManager::receive(const Packet& packet) {
 			}
 			break;
 		}
+		case RTMFPFEC::CHUNK: {
+			// Forward error correction (librtmfp extension)
+			UInt8 kind(message.read8());
+			UInt64 id(message.read7BitLongValue());
+			if (kind == RTMFPFEC::KIND_ACCEPT) {
+				shared_ptr<RTMFPWriter> pWriter;
+				if (writer(id, pWriter))
+					pWriter->acceptFEC();
+				break;
+			}
+			if (kind != RTMFPFEC::KIND_REPAIR || status == RTMFP::FAILED)
+				break;
+			auto itFlow = _flows.find(id);
+			if (itFlow == _flows.end())
+				break;
+			UInt64 first(message.read7BitLongValue());
+			UInt8 count(message.read8());
+			UInt8 index(message.read8());
+			if (itFlow->second->repair(first, count, index, Packet(packet, message.current(), message.available()))) {
+				// lost stages recovered, acknowledge them
+				if (_ackFlows.empty())
+					_ackTime.update();
+				_ackFlows.emplace(id);
+				acknowledge = true;
+			}
+			break;
+		}
 		default:
 			ERROR("RTMFPMessage type '", String::Format<UInt8>("%02x", type), "' unknown on connection ", name());
 			return;
@@ -345,26 +409,80 @@ void FlowManager::receive(const Packet& packet) {
 		// Commit RTMFPFlow (pFlow means 0x11 or 0x10 message)
 		if (stage && (status != RTMFP::FAILED) && type != 0x11) {
 			if (pFlow) {
-				vector<UInt64> losts;
-				stage = pFlow->buildAck(losts, size = 0);
-				size += Binary::Get7BitValueSize(pFlow->id) + Binary::Get7BitValueSize(0xFF7Fu) + Binary::Get7BitValueSize(stage);
-				BinaryWriter writer(write(0x51, size));
-				writer.write7BitLongValue(pFlow->id).write7BitValue(0xFF7F).write7BitLongValue(stage);
-				for (UInt64 lost : losts)
-					writer.write7BitLongValue(lost);
-				if (pFlow->consumed())
-					removeFlow(pFlow);
+				// Delay the acknowledgment, unless a gap is detected (acknowledge it immediatly to get the lost stages)
+				if (_ackFlows.empty())
+					_ackTime.update();
+				_ackFlows.emplace(pFlow->id);
+				acknowledge = true;
+				if (pFlow->gap())
+					ackNow = true;
 				pFlow = NULL;
 			}
-			else // commit everything (flow unknown)
+			else { // commit everything (flow unknown)
 				BinaryWriter(write(0x51, 1 + Binary::Get7BitValueSize(flowId) + Binary::Get7BitValueSize(stage))).write7BitLongValue(flowId).write7BitValue(0).write7BitLongValue(stage);
-			if (_pBuffer) {
-				RTMFP::Send(*socket(_address.family()), Packet(_pEncoder->encode(_pBuffer, _farId, _address)), _address);
-				_pBuffer.reset();
+				sendBuffer();
 			}
 			stage = 0;
 		}
 	}
+
+	if (!acknowledge)
+		return;
+	++_dataPackets;
+	if (ackNow || ++_ackWaiting >= RTMFP::ACK_PACKETS || _ackTime.isElapsed(RTMFP::ACK_DELAY))
+		flushAcks();
+}
+
+void FlowManager::flushAcks() {
+	shared<Buffer> pChunks;
+	for (UInt64 flowId : _ackFlows) {
+		auto it = _flows.find(flowId);
+		if (it == _flows.end())
+			continue; // flow removed
+		RTMFPFlow* pFlow = it->second;
+		UInt16 size(0);
+		UInt64 stage = pFlow->buildAck(size);
+		size += Binary::Get7BitValueSize(pFlow->id) + Binary::Get7BitValueSize(0xFF7Fu) + Binary::Get7BitValueSize(stage);
+		if (pChunks && (pChunks->size() + 3 + size) > (RTMFP::SIZE_PACKET - RTMFP::SIZE_HEADER))
+			sendAcks(pChunks);
+		if (!pChunks)
+			pChunks = RTMFP::NewBuffer();
+		// Acknowledgments of several flows are merged in the same packet
+		BinaryWriter writer(*pChunks);
+		writer.write8(0x51).write16(size).write7BitLongValue(pFlow->id).write7BitValue(0xFF7F).write7BitLongValue(stage);
+		pFlow->writeLosts(writer);
+		// Acceptance of the FEC, repeated until the first repair
+		if (pFlow->fecAccepting() && (pChunks->size() + 4 + Binary::Get7BitValueSize(pFlow->id)) <= (RTMFP::SIZE_PACKET - RTMFP::SIZE_HEADER))
+			writer.write8(RTMFPFEC::CHUNK).write16(1 + Binary::Get7BitValueSize(pFlow->id)).write8(RTMFPFEC::KIND_ACCEPT).write7BitLongValue(pFlow->id);
+		if (pFlow->consumed())
+			removeFlow(pFlow);
+	}
+	_ackFlows.clear();
+	_ackWaiting = 0;
+	sendAcks(pChunks);
+}
+
+void FlowManager::sendAcks(shared<Buffer>& pChunks) {
+	if (!pChunks)
+		return;
+	UInt8 marker((status >= RTMFP::CONNECTED) ? (0x89 + _responder) : 0x0B);
+	if (_pSendSession) {
+		// bundled by the sending thread with the chunks of the writers flushed at the same time
+		send(make_shared<RTMFPChunkSender>(marker, Packet(pChunks)));
+		++_ackPackets;
+	} else {
+		RTMFP::InitBuffer(_pBuffer, marker).append(pChunks->data(), pChunks->size());
+		sendBuffer();
+	}
+	pChunks.reset();
+}
+
+void FlowManager::sendBuffer() {
+	if (!_pBuffer)
+		return;
+	RTMFP::Send(*socket(_address.family()), Packet(_pEncoder->encode(_pBuffer, _farId, _address)), _address);
+	_pBuffer.reset();
+	++_ackPackets;
 }
 
 void FlowManager::send(const shared_ptr<RTMFPSender>& pSender) {
@@ -424,7 +542,11 @@ RTMFPFlow* FlowManager::createFlow(UInt64 id, const string& signature, UInt64 id
 	return _flows.emplace_hint(it, piecewise_construct, forward_as_tuple(id), forward_as_tuple(pFlow))->second;
 }
 
-void FlowManager::manage() {
+UInt32 FlowManager::manage() {
+
+	// Send the delayed acknowledgments
+	if (!_ackFlows.empty())
+		flushAcks();
 
 	// Release the old flows
 	auto itFlow = _flows.begin();
@@ -437,6 +559,41 @@ void FlowManager::manage() {
 
 	// Send the waiting messages
 	flushWriters();
+
+	// Next call : when a timeout of the session or of a writer will expire
+	UInt32 delay(DELAY_CONNECTIONS_IDLE);
+	auto until = [&delay](const Time& time, Int64 timeout) {
+		Int64 remaining(timeout - time.elapsed() + 1); // +1 because isElapsed() is strict
+		if (remaining < delay)
+			delay = remaining > 0 ? UInt32(remaining) : 1;
+	};
+	switch (status) {
+	case RTMFP::CONNECTED:
+		until(_lastPing, 25000);
+		break;
+	case RTMFP::NEAR_CLOSED:
+		until(_lastClose, 5000);
+		until(_closeTime, 90000);
+		break;
+	case RTMFP::FAILED:
+		until(_closeTime, 19000);
+		break;
+	case RTMFP::STOPPED:
+		break;
+	default: // connecting
+		delay = DELAY_CONNECTIONS_MANAGER;
+	}
+	for (auto& it : _flowWriters) {
+		Int64 timeout = it.second->repeatTimeout();
+		if (timeout < 0)
+			continue;
+		// if late the queue is sending, check again later
+		if (!timeout)
+			timeout = DELAY_CONNECTIONS_MANAGER;
+		if (timeout < delay)
+			delay = UInt32(timeout);
+	}
+	return delay;
 }
 
 void FlowManager::removeFlow(RTMFPFlow* pFlow) {
@@ -476,7 +633,7 @@ bool FlowManager::computeKeys(UInt32 farId) {
 	RTMFP::ComputeAsymetricKeys(_sharedSecret, BIN initiatorNonce.data(), initiatorNonce.size(), BIN responderNonce.data(), responderNonce.size(), requestKey, responseKey);
 	_pDecoder.reset(new RTMFP::Engine(_responder ? requestKey : responseKey));
 	_pEncoder.reset(new RTMFP::Engine(_responder ? responseKey : requestKey));
-	_pSendSession.reset(new RTMFPSender::Session(farId, _pEncoder, socket(_address.family()), _pSendSession ? _pSendSession->initiatorTime.load() : 0)); // important, initialize the sender session
+	_pSendSession.reset(new RTMFPSender::Session(farId, _pEncoder, socket(_address.family()), _pSendSession ? _pSendSession->initiatorTime.load() : 0, congestionType, pacingBurst, _invoker.pacer)); // important, initialize the sender session
 
 	// Save nonces just in case we are in a NetGroup connection
 	_farNonce = _pHandshake->farNonce;
@@ -498,7 +655,7 @@ void FlowManager::receive(const SocketAddress& address, const Packet& packet) {
 
 		// If address family change socket will change
 		if (address.family() != _address.family())
-			_pSendSession.reset(new RTMFPSender::Session(_farId, _pEncoder, socket(_address.family()), _pSendSession ? _pSendSession->initiatorTime.load() : 0));
+			_pSendSession.reset(new RTMFPSender::Session(_farId, _pEncoder, socket(_address.family()), _pSendSession ? _pSendSession->initiatorTime.load() : 0, congestionType, pacingBurst, _invoker.pacer));
 		_address.set(address);
 	}
 
@@ -546,6 +703,7 @@ void FlowManager::receive(const SocketAddress& address, const Packet& packet) {
 	case 0xF9:
 	case 0xFA:
 		receive(Packet(packet, reader.current(), reader.available()));
+		flushWriters(); // send immediatly the answers
 		break;
 	default:
 		WARN("Unexpected RTMFP marker : ", String::Format<UInt8>("%02x", marker));
@@ -553,15 +711,37 @@ void FlowManager::receive(const SocketAddress& address, const Packet& packet) {
 }
 
 void FlowManager::setPing(UInt16 time, UInt16 timeEcho) {
-	if (timeEcho > time) {
-		if (timeEcho - time < 30)
-			time = 0;
-		else
-			time += 0xFFFF - timeEcho;
-		timeEcho = 0;
+	if (timeEcho == _lastTimeEcho)
+		return; // echo already used, the elapsed time would be added to the RTT (RFC 7016 3.5.2.2)
+	_lastTimeEcho = timeEcho;
+
+	UInt16 elapsed = time - timeEcho;
+	if (elapsed > 0x7FFF) { // echo in the future
+		if (UInt16(timeEcho - time) >= 30)
+			return; // incoherent echo, ignore it
+		elapsed = 0;
+	}
+	UInt32 rtt = elapsed * RTMFP::TIMESTAMP_SCALE;
+
+	// RTT estimation (RFC 6298 & RFC 7016)
+	if (!_ping) {
+		_srtt = rtt;
+		_rttvar = rtt / 2;
+	} else {
+		_rttvar = (3 * _rttvar + (_srtt > rtt ? _srtt - rtt : rtt - _srtt)) / 4;
+		_srtt = (7 * _srtt + rtt) / 8;
+	}
+	_rto = _srtt + 4 * _rttvar + RTMFP::RTO_MARGIN;
+	if (_rto < RTMFP::RTO_MIN)
+		_rto = RTMFP::RTO_MIN;
+	else if (_rto > Net::RTO_MAX)
+		_rto = Net::RTO_MAX;
+	_ping = rtt ? (rtt > 0xFFFF ? 0xFFFF : rtt) : 1;
+	if (_pSendSession) {
+		_pSendSession->rttSample = rtt;
+		_pSendSession->rtt = _srtt;
 	}
-	UInt16 value = (time - timeEcho) * RTMFP::TIMESTAMP_SCALE;
-	_ping = (value == 0 ? 1 : value);
+	TRACE("RTT of ", name(), " : ", rtt, "ms (srtt=", _srtt, ", rttvar=", _rttvar, ", rto=", _rto, ")")
 }
 
 void FlowManager::sendConnect(BinaryReader& reader) {
@@ -609,7 +789,7 @@ bool FlowManager::onPeerHandshake70(const SocketAddress& address, const Packet&
 
 	// update address & generate the session
 	_address.set(address);
-	_pSendSession.reset(new RTMFPSender::Session(0, _pEncoder, socket(_address.family()), _pSendSession ? _pSendSession->initiatorTime.load() : 0));
+	_pSendSession.reset(new RTMFPSender::Session(0, _pEncoder, socket(_address.family()), _pSendSession ? _pSendSession->initiatorTime.load() : 0, congestionType, pacingBurst, _invoker.pacer));
 	return true;
 };
 
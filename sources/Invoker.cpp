@@ -29,7 +29,20 @@ using namespace std;
 
 /** Invoker **/
 
-Invoker::Invoker(bool createLogger) : Thread("Invoker"), _interruptCb(NULL), _interruptArg(NULL), handler(_handler), timer(_timer), sockets(_handler, threadPool), _lastIndex(0), _handler(wakeUp) {
+struct Invoker::Manage : Runner, virtual Object {
+	Manage(Invoker& invoker, const RTMFPSession* pSession, unsigned int index = 0) : Runner("Manage"), _invoker(invoker), _pSession(pSession), _index(index) {}
+	bool run(Exception& ex) {
+		if (_invoker.running()) // not after the invoker stop (managers released)
+			_invoker.manage(_pSession, _index);
+		return true;
+	}
+private:
+	Invoker&				_invoker;
+	const RTMFPSession*		_pSession; // only used as key, can be deleted
+	unsigned int			_index;
+};
+
+Invoker::Invoker(bool createLogger, UInt16 threads) : Thread("Invoker"), threadPool(threads), pacer(_handler, _timer), _interruptCb(NULL), _interruptArg(NULL), handler(_handler), timer(_timer), bufferPool(_bufferPool), sockets(_handler, threadPool), _lastIndex(0), _timer(Timer::TYPE_WHEEL), _bufferPool(_timer), _handler(wakeUp) {
 	if (createLogger) {
 		_logger.reset(new RTMFPLogger());
 		Logs::SetLogger(*_logger);
@@ -63,6 +76,7 @@ unsigned int Invoker::addConnection(std::shared_ptr<RTMFPSession>& pConn) {
 	lock_guard<mutex>	lock(_mutexConnections);
 
 	_mapConnections.emplace(++_lastIndex, pConn);
+	_handler.queue(make_shared<Manage>(*this, pConn.get(), _lastIndex)); // create the manager in the invoker thread
 	return _lastIndex; // Index of a connection is the position in the vector + 1 (0 is reserved for errors)
 }
 
@@ -100,36 +114,67 @@ unsigned int Invoker::empty() {
 	return _mapConnections.empty();
 }
 
-void Invoker::manage() {
-	lock_guard<mutex>	lock(_mutexConnections);
-	auto it = _mapConnections.begin();
-	while(it != _mapConnections.end()) {
-		it->second->manage();
+void Invoker::wake(const RTMFPSession& session) {
+	_handler.queue(make_shared<Manage>(*this, &session));
+}
 
-		if (it->second->failed()) {
-			_mapConnections.erase(it++);
-			continue;
-		}
-		it++;
+void Invoker::schedule(const RTMFPSession& session, UInt32 delay) {
+	auto it = _managers.find(&session);
+	if (it == _managers.end())
+		return; // not yet created or removed
+	Manager& manager = it->second;
+	Int64 next = Time::Now() + delay;
+	if (manager.next && manager.next <= next)
+		return; // already scheduled before
+	manager.next = next;
+	_timer.set(manager.onManage, delay);
+}
+
+void Invoker::manage(const RTMFPSession* pSession, unsigned int index) {
+	auto it = _managers.lower_bound(pSession);
+	if (it == _managers.end() || it->first != pSession) {
+		if (!index)
+			return; // removed
+		it = _managers.emplace_hint(it, piecewise_construct, forward_as_tuple(pSession), forward_as_tuple());
 	}
+	Manager& manager = it->second;
+	if (index) {
+		// new connection (the address of a deleted one can be reused, so always reset the function)
+		manager.onManage = [this, &manager, pSession, index](UInt32) {
+			UInt32 delay = manageConnection(index);
+			manager.next = delay ? Time::Now() + delay : 0;
+			if (!delay)
+				_handler.queue(make_shared<Manage>(*this, pSession)); // release the manager outside of the timer
+			return delay;
+		};
+	}
+	UInt32 delay = manager.onManage();
+	_timer.set(manager.onManage, delay);
+	if (!delay)
+		_managers.erase(it);
 }
 
-bool Invoker::run(Exception& exc, const volatile bool& stopping) {
-	BufferPool bufferPool(timer);
-	Buffer::SetAllocator(bufferPool);
+UInt32 Invoker::manageConnection(unsigned int index) {
+	lock_guard<mutex>	lock(_mutexConnections);
+	auto it = _mapConnections.find(index);
+	if (it == _mapConnections.end())
+		return 0;
+	UInt32 delay = it->second->manage();
+	if (!it->second->failed())
+		return delay;
+	_mapConnections.erase(it);
+	return 0;
+}
 
-	Timer::OnTimer onManage;
+bool Invoker::run(Exception& exc, const volatile bool& stopping) {
+	Buffer::SetAllocator(_bufferPool);
 
 #if !defined(_DEBUG)
 	try
 #endif
 	{ // Encapsulate sessions!
 
-		onManage = ([&](UInt32 count) {
-			manage(); // client manage (script, etc..)
-			return DELAY_CONNECTIONS_MANAGER;
-		}); // manage every 2 seconds!
-		_timer.set(onManage, DELAY_CONNECTIONS_MANAGER);
+		// Each connection is managed by its own timer (see manage())
 		while (!stopping) {
 			if (wakeUp.wait(_timer.raise()))
 				_handler.flush();
@@ -146,8 +191,10 @@ bool Invoker::run(Exception& exc, const volatile bool& stopping) {
 	}
 #endif
 	Thread::stop(); // to set running() to false (and not more allows to handler to queue Runner)
-	// Stop onManage (useless now)
-	_timer.set(onManage, 0);
+	// Stop the managers (useless now)
+	for (auto& it : _managers)
+		_timer.set(it.second.onManage, 0);
+	_managers.clear();
 
 	// Destroy the connections
 	{
@@ -165,11 +212,15 @@ bool Invoker::run(Exception& exc, const volatile bool& stopping) {
 
 	// empty handler!
 	_handler.flush();
+	pacer.clear();
 
 	// release memory
 	INFO("Invoker memory release");
 	Buffer::SetAllocator();
-	bufferPool.clear();
+	BufferPool::Stats stats;
+	_bufferPool.stats(stats);
+	_bufferPool.clear();
+	DEBUG("Buffers allocated : ", stats.allocations, ", reused : ", stats.reuses, ", fragmentation : ", String::Format<double>("%.1f", stats.fragmentation() * 100), "%")
 	NOTE("Invoker stopped")
 	if (_logger) {
 		Logs::SetLogger(Logs::DefaultLogger()); // we must reset Logger to default to avoid crash if someone call Logs::Log() after Logger destruction
@@ -33,7 +33,7 @@ Listener::Listener(Publisher& publication, const string& identifier) : publicati
 
 FlashListener::FlashListener(Publisher& publication, const string& identifier, shared_ptr<RTMFPWriter>& pDataWriter, shared_ptr<RTMFPWriter>& pAudioWriter, shared_ptr<RTMFPWriter>& pVideoWriter) : Listener(publication, identifier),
 	_pDataWriter(pDataWriter), _pAudioWriter(pAudioWriter), _pVideoWriter(pVideoWriter), receiveAudio(true), receiveVideo(true), _firstTime(true), _seekTime(0),
-	_dataInitialized(false), _reliable(true), _startTime(0), _lastTime(0), _codecInfosSent(false) {
+	_dataInitialized(false), _startTime(0), _lastTime(0), _codecInfosSent(false) {
 
 }
 
@@ -139,7 +139,7 @@ void FlashListener::pushVideo(UInt32 time, const Packet& packet) {
 
 	//TRACE("Video time(+seekTime) => ", time, "(+", _seekTime, "), size : ", size);
 
-	if (!writeMedia(*_pVideoWriter, RTMFP::IsKeyFrame(packet.data(), packet.size()) || _reliable, FlashWriter::VIDEO, _lastTime = (time + _seekTime), packet))
+	if (!writeMedia(*_pVideoWriter, RTMFP::IsKeyFrame(packet.data(), packet.size()) || publication.videoReliable(), FlashWriter::VIDEO, _lastTime = (time + _seekTime), packet))
 		initWriters();
 }
 
@@ -160,7 +160,7 @@ void FlashListener::pushAudio(UInt32 time, const Packet& packet) {
 
 	//TRACE("Audio time(+seekTime) => ", time, "(+", _seekTime, ")");
 
-	if (!writeMedia(*_pAudioWriter, RTMFP::IsAACCodecInfos(packet.data(), packet.size()) || _reliable, FlashWriter::AUDIO, _lastTime = (time + _seekTime), packet))
+	if (!writeMedia(*_pAudioWriter, RTMFP::IsAACCodecInfos(packet.data(), packet.size()) || publication.audioReliable(), FlashWriter::AUDIO, _lastTime = (time + _seekTime), packet))
 		initWriters();
 }
 
@@ -156,7 +156,7 @@ NetGroup::NetGroup(UInt16 mediaId, const string& groupId, const string& groupTxt
 			}
 			INFO("First viewer play request, starting to play Stream ", stream)
 			_pListener->onMedia = _groupMediaPublisher->second.onMedia;
-			_conn.publishReady = true; // A peer is connected : unlock the possible blocking RTMFP_PublishP2P function
+			_conn.setPublishReady(); // A peer is connected : unlock the possible blocking RTMFP_PublishP2P function
 		}
 
 		if (!pPeer->groupReportInitiator) {
@@ -37,10 +37,13 @@ UInt32 P2PSession::P2PSessionCounter = 0x03000000; // Notice that Flash uses inc
 
 P2PSession::P2PSession(RTMFPSession* parent, string id, Invoker& invoker, OnSocketError pOnSocketError, OnStatusEvent pOnStatusEvent, 
 		const Base::SocketAddress& host, bool responder, bool group, UInt16 mediaId) : peerId(id), hostAddress(host), _parent(parent), _groupBeginSent(false), _peerMediaId(mediaId),
-		groupReportInitiator(false), _groupConnectSent(false), _isGroup(group), groupFirstReportSent(false), FlowManager(responder, invoker, pOnSocketError, pOnStatusEvent) {
+		groupReportInitiator(false), _groupConnectSent(false), _isGroup(group), groupFirstReportSent(false), FlowManager(responder, invoker, pOnSocketError, pOnStatusEvent, parent->congestionType, parent->pacingBurst, parent->fec) {
 	_pMainStream->onMedia = [this](UInt16 mediaId, UInt32 time, const Packet& packet, double lostRate, AMF::Type type) {
 		return _parent->onMediaPlay(_peerMediaId, time, packet, lostRate, type);
 	};
+	_pMainStream->onMediaFragments = [this](UInt16 mediaId, UInt32 time, const RTMFP::Fragments& fragments, double lostRate, AMF::Type type) {
+		return _parent->onMediaPlayFragments(_peerMediaId, time, fragments, lostRate, type);
+	};
 	_pMainStream->onGroupHandshake = [this](const string& groupId, const string& key, const string& peerId) {
 		return handleGroupHandshake(groupId, key, peerId);
 	};
@@ -153,6 +156,7 @@ P2PSession::~P2PSession() {
 	close(true);
 
 	_pMainStream->onMedia = nullptr;
+	_pMainStream->onMediaFragments = nullptr;
 	_pMainStream->onGroupMedia = nullptr;
 	_pMainStream->onGroupReport = nullptr;
 	_pMainStream->onGroupPlayPush = nullptr;
@@ -244,6 +248,11 @@ bool P2PSession::handlePlay(const string& streamName, UInt16 streamId, UInt64 fl
 	shared_ptr<RTMFPWriter> pDataWriter = createWriter(signature, flowId);
 	shared_ptr<RTMFPWriter> pAudioWriter = createWriter(signature, flowId);
 	shared_ptr<RTMFPWriter> pVideoWriter = createWriter(signature, flowId);
+	if (fec) {
+		// the repairs are sent only if the peer accepts (librtmfp) and if the media are unreliable
+		pAudioWriter->offerFEC(fec);
+		pVideoWriter->offerFEC(fec);
+	}
 
 	Exception ex;
 	if(!(_pListener = _parent->startListening<FlashListener, shared_ptr<RTMFPWriter>&>(ex, streamName, peerId, pDataWriter, pAudioWriter, pVideoWriter))) {
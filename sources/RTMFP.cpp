@@ -73,8 +73,14 @@ void RTMFP::Pack(Buffer& buffer,UInt32 farId) {
 }
 
 
+shared<Buffer> RTMFP::NewBuffer(UInt32 size) {
+	shared<Buffer> pBuffer(new Buffer(SIZE_BUFFER));
+	pBuffer->resize(size, false);
+	return pBuffer;
+}
+
 Buffer& RTMFP::InitBuffer(shared_ptr<Buffer>& pBuffer, UInt8 marker) {
-	pBuffer.reset(new Buffer(6));
+	pBuffer = NewBuffer(6);
 	return BinaryWriter(*pBuffer).write8(marker).write16(RTMFP::TimeNow()).buffer();
 }
 
@@ -85,7 +91,7 @@ Buffer& RTMFP::InitBuffer(shared_ptr<Buffer>& pBuffer, atomic<Int64>& initiatorT
 	time = Time::Now() - time;
 	if ((time > 262140)) // because is not convertible in RTMFP timestamp on 2 bytes, 0xFFFF*RTMFP::TIMESTAMP_SCALE = 262140
 		return InitBuffer(pBuffer, marker);
-	pBuffer.reset(new Buffer(6));
+	pBuffer = NewBuffer(6);
 	return BinaryWriter(*pBuffer).write8(marker + 4).write16(RTMFP::TimeNow()).write16(RTMFP::Time(time)).buffer();
 }
 
@@ -101,15 +107,88 @@ bool RTMFP::Send(Socket& socket, const Packet& packet, const SocketAddress& addr
 	return true;
 }
 
+bool RTMFP::Send(Socket& socket, const Packet* packets, UInt32 count, const SocketAddress& address) {
+	Exception ex;
+	int sent = socket.write(ex, packets, count, address);
+	if (sent < 0) {
+		DEBUG(ex);
+		return false;
+	}
+	if (ex)
+		DEBUG(ex);
+	return UInt32(sent) == count;
+}
+
+RTMFP::Engine::~Engine() {
+	if (_pEncrypt)
+		EVP_CIPHER_CTX_free(_pEncrypt);
+	if (_pDecrypt)
+		EVP_CIPHER_CTX_free(_pDecrypt);
+}
+
+void RTMFP::Fragments::write(BinaryWriter& writer, UInt32 position, UInt32 size) const {
+	for (const Packet& fragment : *this) {
+		if (!size)
+			return;
+		if (position >= fragment.size()) {
+			position -= fragment.size();
+			continue;
+		}
+		UInt32 count(min(fragment.size() - position, size));
+		writer.write(fragment.data() + position, count);
+		size -= count;
+		position = 0;
+	}
+}
+
+Packet& RTMFP::Fragments::linearize(Packet& packet) const {
+	if (empty())
+		return packet.reset();
+	if (std::deque<Packet>::size() == 1)
+		return packet.set(move(front()));
+	shared<Buffer> pBuffer(new Buffer(bytes));
+	UInt8* data(pBuffer->data());
+	for (const Packet& fragment : *this) {
+		memcpy(data, fragment.data(), fragment.size());
+		data += fragment.size();
+	}
+	return packet.set(pBuffer);
+}
+
+EVP_CIPHER_CTX* RTMFP::Engine::context(bool encrypt) {
+	static const UInt8 IV[KEY_SIZE] = { 0 };
+	EVP_CIPHER_CTX*& pContext(encrypt ? _pEncrypt : _pDecrypt);
+	if (pContext) {
+		EVP_CipherInit_ex(pContext, NULL, NULL, NULL, IV, -1); // keep the key schedule
+		return pContext;
+	}
+	pContext = EVP_CIPHER_CTX_new();
+	EVP_CipherInit_ex(pContext, EVP_aes_128_cbc(), NULL, _key, IV, encrypt ? 1 : 0);
+	EVP_CIPHER_CTX_set_padding(pContext, 0); // RTMFP padding is done by encode
+	return pContext;
+}
+
 bool RTMFP::Engine::decode(Exception& ex, Buffer& buffer, const SocketAddress& address) {
-	static UInt8 IV[KEY_SIZE];
-	EVP_CipherInit_ex(&_context, EVP_aes_128_cbc(), NULL, _key, IV, 0);
-	int temp;
-	EVP_CipherUpdate(&_context, buffer.data(), &temp, buffer.data(), buffer.size());
+	if (buffer.size() < 2) {
+		ex.set<Ex::Protocol>("Bad RTMFP packet size from ", address);
+		return false;
+	}
+	// Decrypt by parts and compute the checksum of each part while it is still in cache
+	EVP_CIPHER_CTX* pContext(context(false));
+	UInt8* data(buffer.data());
+	UInt32 sum(0);
+	UInt32 skip(2); // checksum field
+	for (UInt32 offset = 0; offset < buffer.size(); offset += DECODE_PART) {
+		int size(buffer.size() - offset);
+		if (size > DECODE_PART)
+			size = DECODE_PART;
+		EVP_CipherUpdate(pContext, data + offset, &size, data + offset, size);
+		if (UInt32(size) > skip)
+			sum = Crypto::AddChecksum(sum, data + offset + skip, size - skip);
+		skip = 0;
+	}
 	// Check CRC
-	BinaryReader reader(buffer.data(), buffer.size());
-	UInt16 crc(reader.read16());
-	if (Crypto::ComputeChecksum(reader) != crc) {
+	if (Crypto::FinishChecksum(sum) != BinaryReader(data, 2).read16()) {
 		ex.set<Ex::Protocol>("Bad RTMFP CRC sum computing from ", address);
 		return false;
 	}
@@ -136,16 +215,118 @@ shared<Buffer>& RTMFP::Engine::encode(shared_ptr<Buffer>& pBuffer, UInt32 farId,
 	UInt8* data = pBuffer->data();
 
 	// Write CRC (at the beginning of the request)
-	BinaryReader reader(data, size);
-	reader.next(6);
-	BinaryWriter(data + 4, 2).write16(Crypto::ComputeChecksum(reader));
+	BinaryWriter(data + 4, 2).write16(Crypto::ComputeChecksum(data + 6, size - 6));
 	// Encrypt the resulted request
-	static UInt8 IV[KEY_SIZE];
-	EVP_CipherInit_ex(&_context, EVP_aes_128_cbc(), NULL, _key, IV, 1);
-	EVP_CipherUpdate(&_context, data + 4, &temp, data + 4, size - 4);
+	EVP_CipherUpdate(context(true), data + 4, &temp, data + 4, size - 4);
 
-	reader.reset(4);
+	BinaryReader reader(data + 4, 8);
+	BinaryWriter(data, 4).write32(reader.read32() ^ reader.read32() ^ farId);
+	return pBuffer;
+}
+
+shared<Buffer>& RTMFP::Engine::encode(shared_ptr<Buffer>& pBuffer, Segments& segments, UInt32 farId, const SocketAddress& address) {
+	if (!segments.empty() && Logs::IsDumping()) {
+		// flatten to dump the whole packet
+		shared<Buffer> pFlat(new Buffer());
+		UInt32 offset(0);
+		for (auto& segment : segments) {
+			pFlat->append(pBuffer->data() + offset, segment.first - offset).append(segment.second.data(), segment.second.size());
+			offset = segment.first;
+		}
+		pFlat->append(pBuffer->data() + offset, pBuffer->size() - offset);
+		pBuffer = pFlat;
+		segments.clear();
+	}
+	if (segments.empty())
+		return encode(pBuffer, farId, address);
+
+	UInt32 end(pBuffer->size());
+	UInt32 size = end + segments.bytes;
+	if (size > RTMFP::SIZE_PACKET)
+		CRITIC("Packet exceeds 1192 RTMFP maximum size, risks to be ignored by client");
+	// Padding (see encode) is added to the end of the buffer, after the last segment
+	UInt32 padding = (0xFFFFFFFF - size + 5) & 0x0F;
+	// The buffer (capacity of a packet) is encoded in place : the chunks following each segment are moved to their final position,
+	// from the last one, to leave the room where the segments are encrypted directly from the packets referenced.
+	// Only the whole AES blocks of a segment are encrypted from its packet, its edges are copied to join the chunks around them,
+	// so the cipher is called once by part without partial blocks to buffer
+	pBuffer->resize(size + padding);
+	UInt8* data(pBuffer->data());
+	memset(data + size, 0xFF, padding);
+	size += padding;
+	UInt32 shift(segments.bytes);
+	for (auto it = segments.rbegin(); it != segments.rend(); ++it) {
+		Packet& packet(it->second);
+		memmove(data + it->first + shift, data + it->first, end - it->first);
+		end = it->first;
+		shift -= packet.size();
+		it->first += shift; // final position
+		UInt32 head((AES_BLOCK - ((it->first - 4) & (AES_BLOCK - 1))) & (AES_BLOCK - 1));
+		UInt32 tail((it->first + packet.size() - 4) & (AES_BLOCK - 1));
+		if ((head + tail) >= packet.size()) {
+			memcpy(data + it->first, packet.data(), packet.size());
+			it->first += packet.size();
+			packet -= packet.size();
+			continue;
+		}
+		memcpy(data + it->first, packet.data(), head);
+		memcpy(data + it->first + packet.size() - tail, packet.data() + packet.size() - tail, tail);
+		it->first += head;
+		packet += head;
+		packet -= tail;
+	}
+
+	// Call onPart with the parts of the packet in order, from the position 4 (checksum + data)
+	auto forEach = [&](const function<void(const UInt8*, UInt32)>& onPart) {
+		UInt32 offset(4);
+		for (auto& segment : segments) {
+			onPart(data + offset, segment.first - offset);
+			onPart(segment.second.data(), segment.second.size());
+			offset = segment.first + segment.second.size();
+		}
+		onPart(data + offset, size - offset);
+	};
+
+	// Checksum of the data (after the checksum field), 16 bits words of the concatenated parts
+	UInt32 sum(0);
+	UInt32 skip(2); // checksum field
+	Int16 odd(-1); // byte waiting for the next part to make a word
+	forEach([&](const UInt8* part, UInt32 size) {
+		if (skip) {
+			UInt32 skipped(skip < size ? skip : size);
+			part += skipped;
+			size -= skipped;
+			skip -= skipped;
+		}
+		if (odd >= 0 && size) {
+			UInt8 word[2] = { UInt8(odd), *part++ };
+			sum = Crypto::AddChecksum(sum, word, 2);
+			--size;
+			odd = -1;
+		}
+		if (size & 1)
+			odd = part[--size];
+		sum = Crypto::AddChecksum(sum, part, size);
+	});
+	if (odd >= 0) {
+		UInt8 last = UInt8(odd);
+		sum = Crypto::AddChecksum(sum, &last, 1);
+	}
+	BinaryWriter(data + 4, 2).write16(Crypto::FinishChecksum(sum));
+
+	// Encrypt the chunks in place, and the segments from the packets referenced
+	UInt8* out = data + 4;
+	EVP_CIPHER_CTX* pContext(context(true));
+	forEach([&](const UInt8* part, UInt32 size) {
+		int written(0);
+		if (size)
+			EVP_CipherUpdate(pContext, out, &written, part, size);
+		out += written;
+	});
+
+	BinaryReader reader(data + 4, 8);
 	BinaryWriter(data, 4).write32(reader.read32() ^ reader.read32() ^ farId);
+	segments.clear();
 	return pBuffer;
 }
 
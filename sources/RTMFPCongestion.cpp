@@ -0,0 +1,111 @@
+/*
+Copyright 2016 Thomas Jammet
+mathieu.poux[a]gmail.com
+jammetthomas[a]gmail.com
+
+This file is part of Librtmfp.
+
+Librtmfp is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Librtmfp is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with Librtmfp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "RTMFPCongestion.h"
+#include "Base/Logs.h"
+
+using namespace Base;
+
+RTMFPCongestion* RTMFPCongestion::New(UInt8 type) {
+	switch (type) {
+		case RTMFP::CONGESTION_DELAY:
+			return new RTMFPDelayCongestion();
+		case RTMFP::CONGESTION_LOSS:
+			break;
+		default:
+			WARN("Unknown congestion control type ", type, ", loss-based congestion control used")
+	}
+	return new RTMFPLossCongestion();
+}
+
+void RTMFPCongestion::onLoss(UInt32 rtt) {
+	// Decrease only one time per round trip, the following losses are from the same congestion event
+	if (!_lastDecrease.isElapsed(rtt ? rtt : RTMFP::RTO_MIN))
+		return;
+	_lastDecrease.update();
+	_threshold = decrease();
+	if (_threshold < MIN_WINDOW)
+		_threshold = MIN_WINDOW;
+	setWindow(_threshold);
+	TRACE("Congestion window decreased to ", _window)
+}
+
+void RTMFPCongestion::onTimeout() {
+	_lastDecrease.update();
+	_threshold = _window >> 1;
+	if (_threshold < MIN_WINDOW)
+		_threshold = MIN_WINDOW;
+	setWindow(MIN_WINDOW);
+	TRACE("Congestion window reset to ", _window, " after timeout")
+}
+
+void RTMFPLossCongestion::onAck(UInt32 acked, UInt32 rtt, UInt32 sample) {
+	if (window() < _threshold) {
+		// Slow start
+		setWindow(window() + acked);
+		return;
+	}
+	// Congestion avoidance : +1 per window acknowledged
+	_acked += acked;
+	if (_acked < window())
+		return;
+	_acked -= window();
+	setWindow(window() + 1);
+}
+
+UInt32 RTMFPLossCongestion::decrease() {
+	_acked = 0;
+	return window() >> 1;
+}
+
+void RTMFPDelayCongestion::onAck(UInt32 acked, UInt32 rtt, UInt32 sample) {
+	if (!rtt || !sample) {
+		// No measure yet, grow as in slow start
+		if (window() < _threshold)
+			setWindow(window() + acked);
+		return;
+	}
+	// the minimum of the raw samples, a smoothed value never reaches the propagation delay
+	if (!_baseRTT || sample < _baseRTT)
+		_baseRTT = sample;
+
+	// Adjust the window one time per window acknowledged (~ one time per round trip)
+	_acked += acked;
+	if (_acked < window())
+		return;
+	_acked = 0;
+
+	// Number of packets queued in the network = window * (1 - baseRTT/rtt)
+	UInt32 queued = window() * (rtt - _baseRTT) / rtt;
+	if (window() < _threshold && queued < ALPHA)
+		setWindow(window() << 1); // slow start while no queueing delay
+	else if (queued < ALPHA)
+		setWindow(window() + 1);
+	else if (queued > BETA) {
+		setWindow(window() - 1);
+		_threshold = window();
+	}
+}
+
+UInt32 RTMFPDelayCongestion::decrease() {
+	_acked = 0;
+	return window() * 3 / 4;
+}
@@ -0,0 +1,113 @@
+/*
+Copyright 2016 Thomas Jammet
+mathieu.poux[a]gmail.com
+jammetthomas[a]gmail.com
+
+This file is part of Librtmfp.
+
+Librtmfp is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Librtmfp is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with Librtmfp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "RTMFPDecoder.h"
+#include "Base/Logs.h"
+
+using namespace std;
+using namespace Base;
+
+struct RTMFPDecoder::Decoding : Runner, virtual Object {
+	Decoding(const shared<Pipe>& pPipe) : Runner("RTMFPDecoder"), _weakPipe(pPipe) {}
+private:
+	bool run(Exception&) {
+		shared<Pipe> pPipe(_weakPipe.lock());
+		if (!pPipe)
+			return true; // decoder deleted
+		Pipe& pipe(*pPipe);
+		Received received;
+		for (;;) {
+			// stop if the handler is late, the delivery will resume the decoding
+			while (pipe.decoded.size() < QUEUE_SIZE && pipe.received.pop(received)) {
+				Exception ex;
+				if (received.pEngine->decode(ex, *received.pBuffer, received.address)) {
+					received.pEngine.reset();
+					pipe.decoded.push(move(received));
+				} else
+					ERROR("RTMFPDecoder, ", ex)
+			}
+			if (!pipe.decoded.empty())
+				Deliver(pPipe);
+			pipe.decoding = false;
+			if (pipe.decoded.size() >= QUEUE_SIZE || pipe.received.empty() || pipe.decoding.exchange(true))
+				return true;
+			// a packet has been received after the end of the loop
+		}
+	}
+	weak<Pipe>	_weakPipe;
+};
+
+struct RTMFPDecoder::Delivery : Runner, virtual Object {
+	Delivery(const shared<Pipe>& pPipe) : Runner("RTMFPDecoder"), _weakPipe(pPipe) {}
+private:
+	bool run(Exception& ex) {
+		shared<Pipe> pPipe(_weakPipe.lock());
+		if (!pPipe)
+			return true; // decoder deleted
+		Pipe& pipe(*pPipe);
+		Received received;
+		for (;;) {
+			while (pipe.decoded.pop(received)) {
+				Decoded decoded(pipe.id, received.address, received.pBuffer);
+				pipe.onDecoded(decoded);
+			}
+			pipe.delivering = false;
+			if (pipe.decoded.empty() || pipe.delivering.exchange(true))
+				break;
+		}
+		// resume the decoding if it has been stopped by a full queue
+		return pipe.received.empty() || Decode(ex, pPipe);
+	}
+	weak<Pipe>	_weakPipe;
+};
+
+RTMFPDecoder::RTMFPDecoder(UInt32 id, const Handler& handler, const ThreadPool& threadPool) : _pPipe(new Pipe(id, handler, threadPool)) {
+	_pPipe->onDecoded = onDecoded; // packets still in the pipe are ignored once deleted
+	// runners allocated one time and queued again, they don't keep the pipe alive
+	_pPipe->pDecoding.reset(new Decoding(_pPipe));
+	_pPipe->pDelivery.reset(new Delivery(_pPipe));
+}
+
+bool RTMFPDecoder::decode(Exception& ex, const shared<RTMFP::Engine>& pEngine, shared<Buffer>& pBuffer, const SocketAddress& address) {
+	Received received;
+	received.pEngine = pEngine;
+	received.pBuffer = move(pBuffer);
+	received.address = address;
+	if (!_pPipe->received.push(move(received))) {
+		ex.set<Ex::Intern>("Decoding queue full, packet from ", address, " ignored");
+		return false;
+	}
+	return Decode(ex, _pPipe);
+}
+
+bool RTMFPDecoder::Decode(Exception& ex, const shared<Pipe>& pPipe) {
+	if (pPipe->decoding.exchange(true))
+		return true; // already queued
+	if (pPipe->threadPool.queue(ex, pPipe->pDecoding, pPipe->track))
+		return true;
+	pPipe->decoding = false;
+	return false;
+}
+
+void RTMFPDecoder::Deliver(const shared<Pipe>& pPipe) {
+	if (!pPipe->delivering.exchange(true))
+		pPipe->handler.queue(pPipe->pDelivery);
+}
@@ -0,0 +1,284 @@
+/*
+Copyright 2016 Thomas Jammet
+mathieu.poux[a]gmail.com
+jammetthomas[a]gmail.com
+
+This file is part of Librtmfp.
+
+Librtmfp is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Librtmfp is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with Librtmfp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "RTMFPFEC.h"
+#include "Base/Logs.h"
+
+using namespace std;
+using namespace Base;
+
+// Arithmetic on GF(2^8) (polynomial 0x11D)
+static const struct Galois {
+	Galois() {
+		UInt16 x(1);
+		for (UInt16 i = 0; i < 255; ++i) {
+			exp[i] = exp[i + 255] = UInt8(x);
+			log[x] = UInt8(i);
+			x <<= 1;
+			if (x & 0x100)
+				x ^= 0x11D;
+		}
+		log[0] = 0;
+	}
+	UInt8 inverse(UInt8 value) const { return exp[255 - log[value]]; }
+	// out ^= coefficient * in
+	void  multiplyAdd(UInt8* out, const UInt8* in, UInt32 size, UInt8 coefficient) const {
+		if (coefficient == 1) {
+			while (size--)
+				*out++ ^= *in++;
+			return;
+		}
+		const UInt8* exp(this->exp + log[coefficient]);
+		for (; size--; ++out, ++in) {
+			if (*in)
+				*out ^= exp[log[*in]];
+		}
+	}
+	// data *= coefficient
+	void  multiply(UInt8* data, UInt32 size, UInt8 coefficient) const {
+		const UInt8* exp(this->exp + log[coefficient]);
+		for (; size--; ++data) {
+			if (*data)
+				*data = exp[log[*data]];
+		}
+	}
+	UInt8 exp[510];
+	UInt8 log[256];
+} Galois;
+
+// Coefficient of the source symbol index in the repair row
+static UInt8 Coefficient(UInt8 scheme, UInt8 row, UInt8 index) {
+	if (scheme == RTMFPFEC::SCHEME_XOR)
+		return 1;
+	// Cauchy matrix 1/(x+y) with x=row and y=REPAIRS_MAX+index, all its square submatrices are invertible
+	return Galois.inverse(row ^ UInt8(RTMFPFEC::REPAIRS_MAX + index));
+}
+
+RTMFPFEC::Config::Config(UInt8 scheme, UInt8 sources, UInt8 repairs) : scheme(scheme), sources(sources), repairs(repairs) {
+	if (scheme > SCHEME_REED_SOLOMON) {
+		WARN("Unknown FEC scheme ", scheme, ", FEC disabled")
+		this->scheme = SCHEME_NONE;
+	}
+	if (this->sources < 2)
+		this->sources = 2;
+	else if (this->sources > SOURCES_MAX)
+		this->sources = SOURCES_MAX;
+	if (scheme == SCHEME_XOR || !this->repairs)
+		this->repairs = 1;
+	else if (this->repairs > REPAIRS_MAX)
+		this->repairs = REPAIRS_MAX;
+}
+
+RTMFPFEC::Encoder::Encoder(const Config& config) : config(config), _stage(0), _count(0), _length(0), _position(0), _unreliable(false), _time(0),
+	_pRepairs(new UInt8[config.repairs * SYMBOL_MAX]()) {
+}
+
+bool RTMFPFEC::Encoder::add(UInt64 stage, UInt8 flags, UInt32 size, bool reliable) {
+	if (_count && stage != (_stage + _count))
+		reset(); // not the following stage
+	if (flags & RTMFP::MESSAGE_ABANDON) {
+		reset(); // end of the writer
+		return false;
+	}
+	if (!_count) {
+		_stage = stage;
+		_time.update();
+	}
+	for (UInt8 row = 0; row < config.repairs; ++row)
+		_coefficients[row] = Coefficient(config.scheme, row, _count);
+	++_count;
+	_position = 0;
+	if (!reliable)
+		_unreliable = true;
+	UInt8 header[] = { flags, UInt8(size >> 8), UInt8(size) };
+	append(header, sizeof(header));
+	return true;
+}
+
+void RTMFPFEC::Encoder::append(const UInt8* data, UInt32 size) {
+	for (UInt8 row = 0; row < config.repairs; ++row)
+		Galois.multiplyAdd(_pRepairs.get() + row * SYMBOL_MAX + _position, data, size, _coefficients[row]);
+	_position += size;
+	if (_position > _length)
+		_length = _position;
+}
+
+UInt32 RTMFPFEC::Encoder::repairSize(UInt64 id) const {
+	return 6 + Binary::Get7BitValueSize(id) + Binary::Get7BitValueSize(_stage) + _length;
+}
+
+void RTMFPFEC::Encoder::writeRepair(BinaryWriter& writer, UInt64 id, UInt8 index) const {
+	writer.write8(CHUNK).write16(repairSize(id) - 3).write8(KIND_REPAIR);
+	writer.write7BitLongValue(id).write7BitLongValue(_stage).write8(_count).write8(index);
+	writer.write(_pRepairs.get() + index * SYMBOL_MAX, _length);
+}
+
+void RTMFPFEC::Encoder::reset() {
+	for (UInt8 row = 0; row < config.repairs; ++row)
+		memset(_pRepairs.get() + row * SYMBOL_MAX, 0, _length);
+	_count = 0;
+	_length = 0;
+	_unreliable = false;
+}
+
+void RTMFPFEC::Decoder::add(UInt64 stage, UInt8 flags, const Packet& packet) {
+	if (flags & RTMFP::MESSAGE_ABANDON)
+		return; // its symbol is unknown
+	_sources.emplace(piecewise_construct, forward_as_tuple(stage), forward_as_tuple(flags, packet));
+	auto it = _blocks.upper_bound(stage);
+	if (it != _blocks.begin()) {
+		--it; // block which can contain this stage
+		if (stage < (it->first + it->second.count))
+			_changed = it->second.changed = true;
+	}
+	if (stage <= _stage)
+		return;
+	_stage = stage;
+	if (_stage <= WINDOW)
+		return;
+	// Forget the old stages
+	UInt64 older(_stage - WINDOW);
+	_sources.erase(_sources.begin(), _sources.lower_bound(older));
+	auto itBlock(_blocks.begin());
+	while (itBlock != _blocks.end() && (itBlock->first + itBlock->second.count) <= older)
+		itBlock = _blocks.erase(itBlock);
+}
+
+void RTMFPFEC::Decoder::repair(UInt64 stage, UInt8 count, UInt8 index, const Packet& packet) {
+	_repaired = true;
+	if (!count || count > SOURCES_MAX || index >= (scheme == SCHEME_XOR ? 1 : REPAIRS_MAX) || packet.size() < 3 || packet.size() > SYMBOL_MAX) {
+		DEBUG("Invalid FEC repair ", index, " of ", count, " stages from stage ", stage)
+		return;
+	}
+	if ((stage + count + WINDOW) <= _stage)
+		return; // too old
+	Block& block(_blocks.emplace(piecewise_construct, forward_as_tuple(stage), forward_as_tuple(count)).first->second);
+	if (block.count != count || (!block.repairs.empty() && block.repairs.begin()->second.size() != packet.size()))
+		return; // inconsistent with the previous repairs
+	block.repairs.emplace(piecewise_construct, forward_as_tuple(index), forward_as_tuple(move(packet))); // bufferize it
+	_changed = block.changed = true;
+}
+
+bool RTMFPFEC::Decoder::recover(map<UInt64, Fragment>& fragments) {
+	if (!_changed)
+		return false;
+	_changed = false;
+	bool recovered(false);
+	vector<UInt8> losts;
+	auto it = _blocks.begin();
+	while (it != _blocks.end()) {
+		Block& block(it->second);
+		if (!block.changed || block.repairs.empty()) {
+			++it;
+			continue;
+		}
+		block.changed = false;
+		losts.clear();
+		for (UInt8 index = 0; index < block.count; ++index) {
+			if (!_sources.count(it->first + index))
+				losts.emplace_back(index);
+		}
+		if (losts.size() > block.repairs.size()) {
+			++it; // wait more sources or repairs
+			continue;
+		}
+		if (!losts.empty() && solve(it->first, block, losts, fragments))
+			recovered = true;
+		it = _blocks.erase(it);
+	}
+	return recovered;
+}
+
+bool RTMFPFEC::Decoder::solve(UInt64 first, const Block& block, const vector<UInt8>& losts, map<UInt64, Fragment>& fragments) {
+	UInt8 count(UInt8(losts.size()));
+	UInt32 length(block.repairs.begin()->second.size());
+
+	// Residuals : repairs less the contribution of the sources received
+	vector<UInt8> rows(count);
+	unique_ptr<UInt8[]> pResiduals(new UInt8[count * length]);
+	auto itRepair(block.repairs.begin());
+	for (UInt8 row = 0; row < count; ++row, ++itRepair) {
+		rows[row] = itRepair->first;
+		memcpy(pResiduals.get() + row * length, itRepair->second.data(), length);
+	}
+	UInt8 lost(0);
+	for (UInt8 index = 0; index < block.count; ++index) {
+		if (lost < count && losts[lost] == index) {
+			++lost;
+			continue;
+		}
+		const Fragment& source(_sources.find(first + index)->second);
+		if ((source.size() + 3) > length)
+			return false;
+		UInt8 header[] = { source.flags, UInt8(source.size() >> 8), UInt8(source.size()) };
+		for (UInt8 row = 0; row < count; ++row) {
+			UInt8 coefficient(Coefficient(scheme, rows[row], index));
+			UInt8* residual(pResiduals.get() + row * length);
+			Galois.multiplyAdd(residual, header, sizeof(header), coefficient);
+			Galois.multiplyAdd(residual + 3, source.data(), source.size(), coefficient);
+		}
+	}
+
+	// Gauss-Jordan elimination of the matrix of the lost symbols
+	vector<UInt8> matrix(count * count);
+	for (UInt8 row = 0; row < count; ++row) {
+		for (UInt8 column = 0; column < count; ++column)
+			matrix[row * count + column] = Coefficient(scheme, rows[row], losts[column]);
+	}
+	for (UInt8 column = 0; column < count; ++column) {
+		UInt8 pivot(column);
+		while (!matrix[pivot * count + column]) {
+			if (++pivot == count)
+				return false;
+		}
+		if (pivot != column) {
+			for (UInt8 i = 0; i < count; ++i)
+				swap(matrix[pivot * count + i], matrix[column * count + i]);
+			for (UInt32 i = 0; i < length; ++i)
+				swap(pResiduals[pivot * length + i], pResiduals[column * length + i]);
+		}
+		UInt8 inverse(Galois.inverse(matrix[column * count + column]));
+		Galois.multiply(matrix.data() + column * count, count, inverse);
+		Galois.multiply(pResiduals.get() + column * length, length, inverse);
+		for (UInt8 row = 0; row < count; ++row) {
+			UInt8 factor(matrix[row * count + column]);
+			if (row == column || !factor)
+				continue;
+			Galois.multiplyAdd(matrix.data() + row * count, matrix.data() + column * count, count, factor);
+			Galois.multiplyAdd(pResiduals.get() + row * length, pResiduals.get() + column * length, length, factor);
+		}
+	}
+
+	// Residuals are now the lost symbols
+	for (UInt8 row = 0; row < count; ++row) {
+		const UInt8* symbol(pResiduals.get() + row * length);
+		UInt32 size((symbol[1] << 8) | symbol[2]);
+		if ((size + 3) > length)
+			return false;
+		shared_ptr<Buffer> pBuffer(new Buffer(size, symbol + 3));
+		Packet packet(pBuffer);
+		UInt64 stage(first + losts[row]);
+		_sources.emplace(piecewise_construct, forward_as_tuple(stage), forward_as_tuple(symbol[0], packet)); // for a late repair of the same block
+		fragments.emplace(piecewise_construct, forward_as_tuple(stage), forward_as_tuple(symbol[0], packet));
+	}
+	return true;
+}
@@ -26,14 +26,16 @@ using namespace std;
 using namespace Base;
 
 RTMFPFlow::RTMFPFlow(UInt64 id,const string& signature, FlowManager& band, const shared_ptr<FlashConnection>& pMainStream, UInt64 idWriterRef) : _pStream(pMainStream),
-	_lost(0),id(id),_writerRef(idWriterRef),_stage(0),_stageEnd(0),_band(band), fragmentation(0) {
+	_lost(0),id(id),_writerRef(idWriterRef),_stage(0),_stageEnd(0),_band(band), fragmentation(0), _fragments(0), _stageMax(0) {
 
+	memset(_bits, 0, sizeof(_bits));
 	DEBUG("New main flow ", id, " on connection ", _band.name())
 }
 
 RTMFPFlow::RTMFPFlow(UInt64 id,const string& signature,const shared_ptr<FlashStream>& pStream, FlowManager& band, UInt64 idWriterRef) : _pStream(pStream),
-	_lost(0),id(id),_writerRef(idWriterRef),_stage(0), _stageEnd(0),_band(band), fragmentation(0) {
+	_lost(0),id(id),_writerRef(idWriterRef),_stage(0), _stageEnd(0),_band(band), fragmentation(0), _fragments(0), _stageMax(0) {
 
+	memset(_bits, 0, sizeof(_bits));
 	DEBUG("New flow ", id, " on connection ", _band.name())
 }
 
@@ -43,32 +45,85 @@ RTMFPFlow::~RTMFPFlow() {
 	DEBUG("RTMFPFlow ", id, " consumed");
 
 	// delete fragments
-	_fragments.clear();
+	_pFragments.reset();
 }
 
-UInt64 RTMFPFlow::buildAck(vector<UInt64>& losts, UInt16& size) {
-	// Lost informations!
-	UInt64 stage = _stage;
-	auto it = _fragments.begin();
-	while (it != _fragments.end()) {
-		stage = it->first - stage - 2;
-		size += Binary::Get7BitValueSize(stage);
-		losts.emplace_back(stage); // lost count
-		UInt32 buffered(0);
-		stage = it->first;
-		while (++it != _fragments.end() && it->first == (++stage))
-			++buffered;
-		size += Binary::Get7BitValueSize(buffered);
-		losts.emplace_back(buffered);
-		--stage;
+UInt64 RTMFPFlow::next(UInt64 stage, bool present) const {
+	while (stage <= _stageMax) {
+		UInt32 index(stage & (WINDOW - 1));
+		UInt64 bits(present ? _bits[index >> 6] : ~_bits[index >> 6]);
+		bits >>= index & 63;
+		if (bits) {
+			while (!(bits & 1)) {
+				bits >>= 1;
+				++stage;
+			}
+			return min(stage, _stageMax + 1);
+		}
+		stage += 64 - (index & 63);
 	}
+	return _stageMax + 1;
+}
+
+bool RTMFPFlow::nextRange(UInt64& stage, UInt64& lost, UInt64& bufferized) const {
+	if (!_fragments || stage >= _stageMax)
+		return false;
+	UInt64 first(next(stage + 1, true));
+	UInt64 end(next(first, false));
+	lost = first - stage - 2; // lost count
+	bufferized = end - first - 1; // buffered count
+	stage = end - 1;
+	return true;
+}
+
+UInt64 RTMFPFlow::buildAck(UInt16& size) {
+	// Lost informations!
+	UInt64 stage(_stage), lost, bufferized;
+	while (nextRange(stage, lost, bufferized))
+		size += Binary::Get7BitValueSize(lost) + Binary::Get7BitValueSize(bufferized);
 	_completeTime.update(); // update the complete time to wait at least 120s before destruction of the flow
 	return _stage;
 }
 
+void RTMFPFlow::writeLosts(BinaryWriter& writer) const {
+	UInt64 stage(_stage), lost, bufferized;
+	while (nextRange(stage, lost, bufferized))
+		writer.write7BitLongValue(lost).write7BitLongValue(bufferized);
+}
+
 void RTMFPFlow::input(UInt64 stage, UInt8 flags, const Packet& packet) {
+	if (_pFEC && stage > _stage)
+		_pFEC->add(stage, flags, packet); // keep it as a source of FEC block
+	receive(stage, flags, packet);
+	if (_pFEC)
+		recover();
+}
+
+bool RTMFPFlow::repair(UInt64 stage, UInt8 count, UInt8 index, const Packet& packet) {
+	if (!_pFEC)
+		return false;
+	_pFEC->repair(stage, count, index, packet);
+	return recover();
+}
+
+bool RTMFPFlow::recover() {
+	map<UInt64, RTMFPFEC::Fragment> fragments;
+	if (!_pFEC->recover(fragments))
+		return false;
+	bool recovered(false);
+	for (auto& it : fragments) {
+		if (it.first <= _stage || buffered(it.first))
+			continue; // received in the meantime
+		DEBUG("Stage ", it.first, " recovered by FEC on flow ", id, " in session ", _band.name())
+		receive(it.first, it.second.flags, it.second);
+		recovered = true;
+	}
+	return recovered;
+}
+
+void RTMFPFlow::receive(UInt64 stage, UInt8 flags, const Packet& packet) {
 	if (_stageEnd) {
-		if (_fragments.empty()) {
+		if (!_fragments) {
 			// if completed accept anyway to allow ack and avoid repetition
 			_stage = stage;
 			return; // completed!
@@ -78,8 +133,6 @@ void RTMFPFlow::input(UInt64 stage, UInt8 flags, const Packet& packet) {
 			return;
 		}
 	}
-	else if (flags&RTMFP::MESSAGE_END)
-		_stageEnd = stage;
 
 	UInt64 nextStage = _stage + 1;
 	if (stage < nextStage) {
@@ -88,25 +141,45 @@ void RTMFPFlow::input(UInt64 stage, UInt8 flags, const Packet& packet) {
 	}
 	if (stage>nextStage) {
 		// not following stage, bufferizes the stage
-		if (_fragments.empty())
-			DEBUG("Wait stage ", nextStage, " lost on flow ", id, " in session ", _band.name());
-		if (_fragments.emplace(piecewise_construct, forward_as_tuple(stage), forward_as_tuple(flags, packet)).second) {
-			fragmentation += packet.size();
-			if (_fragments.size()>100)
-				DEBUG("fragments buffer increasing on flow ", id, " in session ", _band.name(), " : ", _fragments.size());
+		if ((stage - _stage) > WINDOW) {
+			DEBUG("Stage ", stage, " beyond the reception window on flow ", id, " in session ", _band.name(), ", waiting stage ", nextStage)
+			return; // will be repeated
 		}
-		else
+		if (buffered(stage)) {
 			DEBUG("Stage ", stage, " on flow ", id, " has already been received in session ", _band.name())
+			return;
+		}
+		if (!_stageEnd && (flags&RTMFP::MESSAGE_END))
+			_stageEnd = stage; // accepted in the window only, else the stages before would be taken as completed
+		if (!_fragments) {
+			DEBUG("Wait stage ", nextStage, " lost on flow ", id, " in session ", _band.name());
+			if (!_pFragments)
+				_pFragments.reset(new Fragment[WINDOW]);
+		}
+		Fragment& fragment(_pFragments[stage & (WINDOW - 1)]);
+		fragment.flags = flags;
+		fragment.set(move(packet)); // bufferize it
+		_bits[(stage & (WINDOW - 1)) >> 6] |= 1ull << (stage & 63);
+		if (stage > _stageMax)
+			_stageMax = stage;
+		fragmentation += fragment.size();
+		if (++_fragments>100)
+			DEBUG("fragments buffer increasing on flow ", id, " in session ", _band.name(), " : ", _fragments);
 	}
 	else {
+		if (!_stageEnd && (flags&RTMFP::MESSAGE_END))
+			_stageEnd = stage;
 		onFragment(nextStage++, flags, packet);
-		auto it = _fragments.begin();
-		while (it != _fragments.end() && it->first <= nextStage) {
-			onFragment(nextStage++, it->second.flags, it->second);
-			fragmentation -= it->second.size();
-			it = _fragments.erase(it);
+		while (buffered(nextStage)) {
+			Fragment& fragment(_pFragments[nextStage & (WINDOW - 1)]);
+			onFragment(nextStage, fragment.flags, fragment);
+			fragmentation -= fragment.size();
+			fragment.reset();
+			_bits[(nextStage & (WINDOW - 1)) >> 6] &= ~(1ull << (nextStage & 63));
+			--_fragments;
+			++nextStage;
 		}
-		if (_fragments.empty() && _stageEnd)
+		if (!_fragments && _stageEnd)
 			output(id, _lost, Packet::Null()); // end flow!
 	}
 }
@@ -116,22 +189,22 @@ void RTMFPFlow::onFragment(UInt64 stage, UInt8 flags, const Packet& packet) {
 	_stage = stage;
 	// If MESSAGE_ABANDON, abandon the current packet (happen on lost data)
 	if (flags&RTMFP::MESSAGE_ABANDON) {
-		if (_pBuffer) {
+		if (!_message.empty()) {
 			_lost += packet.size(); // this fragment abandonned
-			_lost += _pBuffer->size(); // the bufferized fragment abandonned
+			_lost += _message.bytes; // the bufferized fragments abandonned
 			DEBUG("Fragments lost on flow ", id, " in session ", _band.name());
-			_pBuffer.reset();
+			_message.clear();
 		}
 		return;
 	}
 
-	if (_pBuffer) {
-		_pBuffer->append(packet.data(), packet.size());
+	if (!_message.empty()) {
+		_message.add(packet);
 		if (flags&RTMFP::MESSAGE_WITH_AFTERPART)
 			return;
-		Packet packet(_pBuffer);
-		if (packet)
-			output(id, _lost, packet);
+		if (_message.bytes)
+			output(id, _lost, _message);
+		_message.clear();
 		return;
 
 	}
@@ -140,7 +213,7 @@ void RTMFPFlow::onFragment(UInt64 stage, UInt8 flags, const Packet& packet) {
 		return; // the beginning of this message is lost, ignore it!
 	}
 	if (flags&RTMFP::MESSAGE_WITH_AFTERPART) {
-		_pBuffer.reset(new Buffer(packet.size(), packet.data()));
+		_message.add(packet); // referenced until the last fragment
 		return;
 	}
 	if (packet)
@@ -154,3 +227,11 @@ void RTMFPFlow::output(UInt64 flowId, UInt32& lost, const Packet& packet) {
 		return;
 	}
 }
+
+void RTMFPFlow::output(UInt64 flowId, UInt32& lost, const RTMFP::Fragments& fragments) {
+
+	if (!_pStream || !_pStream->process(fragments, id, _writerRef, lost)) {
+		_band.closeFlow(id); // send an exception
+		return;
+	}
+}
@@ -21,6 +21,7 @@ along with Librtmfp.  If not, see <http://www.gnu.org/licenses/>.
 
 #include "RTMFPHandshaker.h"
 #include "RTMFPSession.h"
+#include "Invoker.h"
 #include "RTMFPSender.h"
 #include "Base/Util.h"
 
@@ -109,8 +110,13 @@ void RTMFPHandshaker::sendHandshake70(const string& tag, const SocketAddress& ad
 	sendHandshake70(tag, itHandshake->second);
 }
 
-void RTMFPHandshaker::manage() {
-	// TODO: maybe add a timer to not loop every call of manage()
+UInt32 RTMFPHandshaker::manage() {
+	UInt32 delay(DELAY_CONNECTIONS_IDLE);
+	auto until = [&delay](const Time& time, Int64 timeout) {
+		Int64 remaining(timeout - time.elapsed() + 1); // +1 because isElapsed() is strict
+		if (remaining < delay)
+			delay = remaining > 0 ? UInt32(remaining) : 1;
+	};
 
 	// Ask server to send p2p addresses
 	auto itHandshake = _mapTags.begin();
@@ -140,6 +146,8 @@ void RTMFPHandshaker::manage() {
 					pHandshake->status = RTMFP::HANDSHAKE30;
 				pHandshake->lastAttempt.update();
 			}
+			if (pHandshake->pSession)
+				until(pHandshake->lastAttempt, pHandshake->attempt * 1500);
 			break;
 		case RTMFP::HANDSHAKE38:
 
@@ -155,6 +163,8 @@ void RTMFPHandshaker::manage() {
 				sendHandshake38(pHandshake, pHandshake->cookieReceived);
 				pHandshake->lastAttempt.update();
 			}
+			if (pHandshake->pSession)
+				until(pHandshake->lastAttempt, pHandshake->attempt * 1500);
 			break;
 		default:
 			break;
@@ -168,8 +178,9 @@ void RTMFPHandshaker::manage() {
 		if (itCookie->second->cookieCreation.isElapsed(95000))
 			removeHandshake((itCookie++)->second);
 		else
-			++itCookie;
+			until((itCookie++)->second->cookieCreation, 95000);
 	}
+	return delay;
 }
 
 void RTMFPHandshaker::sendHandshake30(const Binary& epd, const string& tag) {
@@ -0,0 +1,101 @@
+/*
+Copyright 2016 Thomas Jammet
+mathieu.poux[a]gmail.com
+jammetthomas[a]gmail.com
+
+This file is part of Librtmfp.
+
+Librtmfp is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Librtmfp is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with Librtmfp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "RTMFPNotifier.h"
+#include "Base/Logs.h"
+#if !defined(_WIN32)
+	#include <unistd.h>
+	#include <fcntl.h>
+#if !defined(_BSD)
+	#include <sys/eventfd.h>
+#endif
+#endif
+
+using namespace Base;
+using namespace std;
+
+RTMFPNotifier::~RTMFPNotifier() {
+#if !defined(_WIN32)
+	if (_fdWrite >= 0 && _fdWrite != _fd)
+		::close(_fdWrite);
+	if (_fd >= 0)
+		::close(_fd);
+#endif
+}
+
+int RTMFPNotifier::fd() {
+	lock_guard<mutex> lock(_mutex);
+	if (_fd >= 0)
+		return _fd;
+#if defined(_WIN32)
+	WARN("Event descriptors are not available on Windows")
+	return -1;
+#elif defined(_BSD)
+	int fds[2];
+	if (pipe(fds) != 0) {
+		ERROR("Unable to create the event descriptor, ", strerror(errno))
+		return -1;
+	}
+	for (int fd : fds)
+		fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+	_fd = fds[0];
+	_fdWrite = fds[1];
+#else
+	if ((_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) < 0) {
+		ERROR("Unable to create the event descriptor, ", strerror(errno))
+		return -1;
+	}
+	_fdWrite = _fd;
+#endif
+	if (_set)
+		signal();
+	return _fd;
+}
+
+void RTMFPNotifier::set() {
+	if (_set)
+		return; // already readable
+	lock_guard<mutex> lock(_mutex);
+	if (_set.exchange(true))
+		return;
+	if (_fdWrite >= 0)
+		signal();
+}
+
+void RTMFPNotifier::reset() {
+	if (!_set)
+		return;
+	lock_guard<mutex> lock(_mutex);
+	if (!_set.exchange(false) || _fd < 0)
+		return;
+#if !defined(_WIN32)
+	UInt8 buffer[8];
+	while (::read(_fd, buffer, sizeof(buffer)) > 0); // drain
+#endif
+}
+
+void RTMFPNotifier::signal() {
+#if !defined(_WIN32)
+	UInt64 value(1); // 8 bytes required by eventfd
+	if (::write(_fdWrite, &value, sizeof(value)) < 0 && errno != EAGAIN)
+		WARN("Unable to signal the event descriptor, ", strerror(errno))
+#endif
+}
@@ -0,0 +1,65 @@
+/*
+Copyright 2016 Thomas Jammet
+mathieu.poux[a]gmail.com
+jammetthomas[a]gmail.com
+
+This file is part of Librtmfp.
+
+Librtmfp is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Librtmfp is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with Librtmfp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "RTMFPPacer.h"
+#include "Base/Logs.h"
+
+using namespace Base;
+using namespace std;
+
+struct RTMFPPacer::Schedule : Runner, virtual Object {
+	Schedule(RTMFPPacer& pacer, Int64 time, ThreadQueue& thread, const shared<Runner>& pRunner) : Runner("PacerSchedule"), _pacer(pacer), _time(time), _thread(thread), _pRunner(pRunner) {}
+	bool run(Exception& ex) {
+		auto it = _pacer._runners.emplace(_time, make_pair(&_thread, move(_pRunner)));
+		if (it != _pacer._runners.begin())
+			return true; // the timer is set before
+		Int64 delay = _time - Time::Now();
+		_pacer._timer.set(_pacer._onTimer, delay > 0 ? UInt32(delay) : 1);
+		return true;
+	}
+private:
+	RTMFPPacer&		_pacer;
+	Int64			_time;
+	ThreadQueue&	_thread;
+	shared<Runner>	_pRunner;
+};
+
+RTMFPPacer::RTMFPPacer(const Handler& handler, const Timer& timer) : _handler(handler), _timer(timer), _onTimer([this](UInt32) { return raise(); }) {}
+
+void RTMFPPacer::schedule(UInt32 delay, ThreadQueue& thread, const shared<Runner>& pRunner) {
+	_handler.queue(make_shared<Schedule>(*this, Time::Now() + delay, thread, pRunner));
+}
+
+void RTMFPPacer::clear() {
+	_timer.set(_onTimer, 0);
+	_runners.clear();
+}
+
+UInt32 RTMFPPacer::raise() {
+	Int64 now = Time::Now();
+	auto it = _runners.begin();
+	while (it != _runners.end() && it->first <= now) {
+		Exception ex;
+		AUTO_ERROR(it->second.first->queue(ex, it->second.second), "RTMFPPacer");
+		it = _runners.erase(it);
+	}
+	return it == _runners.end() ? 0 : UInt32(it->first - now);
+}
@@ -0,0 +1,115 @@
+/*
+Copyright 2016 Thomas Jammet
+mathieu.poux[a]gmail.com
+jammetthomas[a]gmail.com
+
+This file is part of Librtmfp.
+
+Librtmfp is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Librtmfp is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with Librtmfp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "RTMFPPlayout.h"
+#include "Base/Logs.h"
+
+using namespace Base;
+using namespace std;
+
+RTMFPPlayout::RTMFPPlayout(UInt16 minLatency, UInt16 maxLatency) : minLatency(min(minLatency, maxLatency)), maxLatency(maxLatency), late(0), dropped(0), _flushing(0), _started(false),
+	_transitBase(0), _transitMin(0), _transitPrevious(0), _period(0), _transitLast(0), _jitter(0), _latency(0), _released(0), _hasReleased(false) {
+}
+
+void RTMFPPlayout::reset(Int64 transit) {
+	_flushing = _packets.size(); // release the packets of the previous timeline
+	_started = true;
+	_transitBase = _transitMin = _transitPrevious = _transitLast = transit;
+	_period = 0;
+	_jitter = 0;
+	_latency = minLatency;
+	_hasReleased = false;
+}
+
+void RTMFPPlayout::add(Int64 now, const shared<RTMFPMediaPacket>& pPacket) {
+	Int64 transit(now - pPacket->time);
+	if (!_started || transit < (_transitBase - RESET) || transit > (_transitBase + RESET + maxLatency)) {
+		if (_started)
+			DEBUG("Playout timeline changed (transit ", transit, "ms instead of ", _transitBase, "ms), ", _packets.size(), " packets flushed")
+		reset(transit);
+	}
+	
+	// Late?
+	if (now > playoutTime(*pPacket)) {
+		++late;
+		if (_hasReleased && pPacket->time < _released && !pPacket->essential()) {
+			++dropped;
+			DEBUG("Late ", pPacket->type == AMF::TYPE_AUDIO ? "audio" : "video", " packet dropped (time ", pPacket->time, ", playout time ", _released, ")")
+			return;
+		}
+	}
+
+	// Minimum transit of the 2 last periods (to follow the clock drift)
+	if (now >= _period) {
+		_transitPrevious = _transitMin;
+		_transitMin = transit;
+		_period = now + PERIOD;
+	} else if (transit < _transitMin)
+		_transitMin = transit;
+	_transitBase = min(_transitMin, _transitPrevious);
+
+	// Interarrival jitter (RFC 3550)
+	Int64 difference(transit - _transitLast);
+	_transitLast = transit;
+	_jitter += (double(difference < 0 ? -difference : difference) - _jitter) / 16;
+
+	// Latency : peak of the delay (fast increase, slow decrease), at least 4 times the jitter
+	double delay(double(transit - _transitBase));
+	if (delay > _latency)
+		_latency = delay;
+	else
+		_latency -= (_latency - delay) / 512;
+	if (_latency < 4 * _jitter)
+		_latency = 4 * _jitter;
+	if (_latency < minLatency)
+		_latency = minLatency;
+	else if (_latency > maxLatency)
+		_latency = maxLatency;
+
+	// Insert by timestamp (after the packets of the previous timeline)
+	auto it(_packets.end()), begin(_packets.begin() + _flushing);
+	while (it != begin && (*(it - 1))->time > pPacket->time)
+		--it;
+	_packets.insert(it, pPacket);
+}
+
+void RTMFPPlayout::release(Int64 now, deque<shared<RTMFPMediaPacket>>& output) {
+	for (; _flushing; --_flushing) {
+		output.emplace_back(move(_packets.front()));
+		_packets.pop_front();
+	}
+	while (!_packets.empty() && playoutTime(*_packets.front()) <= now) {
+		if (!_hasReleased || _packets.front()->time > _released)
+			_released = _packets.front()->time;
+		_hasReleased = true;
+		output.emplace_back(move(_packets.front()));
+		_packets.pop_front();
+	}
+}
+
+UInt32 RTMFPPlayout::delay(Int64 now) const {
+	if (_flushing)
+		return 0;
+	if (_packets.empty())
+		return 0xFFFFFFFF;
+	Int64 time(playoutTime(*_packets.front()));
+	return time > now ? UInt32(time - now) : 0;
+}
@@ -21,40 +21,209 @@ along with Librtmfp.  If not, see <http://www.gnu.org/licenses/>.
 
 #include "RTMFPSender.h"
 #include "Base/BinaryWriter.h"
+#include "Base/ThreadQueue.h"
 #include "Base/Logs.h"
 
 using namespace Base;
 
 bool RTMFPSender::run(Exception&) {
 	run();
-	if (!pQueue)
+	if (pSession->batch.size() < Socket::BATCH_MAX) {
+		// If the next runner is a sender of the same session its chunks and datagrams will be sent with ours
+		ThreadQueue* pThread = ThreadQueue::Current();
+		shared<Runner> pNext(pThread ? pThread->next() : nullptr);
+		RTMFPSender* pSender = dynamic_cast<RTMFPSender*>(pNext.get());
+		if (pSender && pSender->pSession == pSession && pSender->address == address) {
+			if (pQueue)
+				flush(pQueue);
+			return true;
+		}
+	}
+	closeDatagram();
+	if (pQueue)
+		flush(pQueue);
+	sendBatch();
+	return true;
+}
+
+void RTMFPSender::send(const Base::Packet& packet) {
+	if (pSession->batch.size() == Socket::BATCH_MAX)
+		sendBatch(); // never grow the batch, a reallocation would copy its packets as references
+	pSession->batch.emplace_back(std::move(packet)); // bufferize, the packet can be released (acknowledged or temporary) before the batch is sent
+}
+
+void RTMFPSender::sendBatch() {
+	if (pSession->batch.empty())
+		return;
+	RTMFP::Send(pSession->socket, pSession->batch.data(), pSession->batch.size(), address); // on error the repeater will retry
+	pSession->batch.clear();
+}
+
+Buffer& RTMFPSender::newDatagram() {
+	closeDatagram();
+	pSession->datagramMarker = _marker;
+	return RTMFP::InitBuffer(pSession->pDatagram, pSession->initiatorTime, _marker);
+}
+
+void RTMFPSender::closeDatagram() {
+	Session& session(*pSession);
+	if (!session.pDatagram)
+		return;
+	Base::Packet datagram(session.pEncoder->encode(session.pDatagram, session.segments, session.farId, address));
+	session.pDatagram.reset();
+	session.pLastQueue = NULL;
+	shared<bool> pSent(new bool(session.datagramUrgent));
+	if (session.datagramUrgent) {
+		// acknowledgments must not wait for the congestion window
+		send(datagram);
+		session.sendTime = Time::Now();
+		session.sendByteRate += datagram.size();
+		session.datagramUrgent = false;
+	} else if (!session.parts.empty())
+		session.queueing += datagram.size();
+	std::vector<Session::Part> parts(std::move(session.parts));
+	session.parts.clear();
+	for (Session::Part& part : parts)
+		part.pQueue->emplace_back(new Packet(std::move(datagram), part.fragments, part.reliable, pSent)); // shares the buffer of the datagram
+	for (Session::Part& part : parts) {
+		if (part.pQueue != pQueue) // our queue is flushed by the caller
+			flush(part.pQueue);
+	}
+}
+
+bool RTMFPSender::pace() {
+	if (pSession->pace())
+		return true;
+	if (pSession->pacingWait)
+		return false; // resume already scheduled
+	ThreadQueue* pThread = ThreadQueue::Current();
+	if (!pThread)
+		return true; // not in a thread queue, can't be resumed
+	shared<RTMFPSender> pResumer(new RTMFPResumer(_marker));
+	pResumer->address = address;
+	pResumer->pSession = pSession;
+	pSession->pacer.schedule(pSession->pacingDelay(), *pThread, pResumer);
+	pSession->pacingWait = true;
+	return false;
+}
+
+bool RTMFPSender::Session::pace() {
+	if (!pacingBurst || !rtt)
+		return true; // no pacing (or no RTT measured for now)
+	Int64 now = Time::Now();
+	pacingTokens += (now - pacingTime) * pacingRate();
+	pacingTime = now;
+	if (pacingTokens > pacingBurst)
+		pacingTokens = pacingBurst;
+	if (pacingTokens < 1)
+		return false;
+	--pacingTokens;
+	return true;
+}
+
+void RTMFPSender::acknowledged(Packet& packet) {
+	if (!packet.repeatTime)
+		return;
+	// If the acknowledgment comes before half a round trip after the repeat it is the one of the original packet
+	Int64 elapsed = Time::Now() - packet.repeatTime;
+	if (!pSession->rtt || elapsed >= (pSession->rtt >> 1))
+		++pSession->usefulRepeats;
+	packet.repeatTime = 0;
+}
+
+bool RTMFPSender::Losts::lost(UInt64 first, UInt64 last, bool unknownLost) const {
+	if (last > stageReceived && unknownLost)
 		return true;
+	for (const auto& range : *this) {
+		if (range.first > last)
+			break;
+		if (range.second >= first)
+			return true;
+	}
+	return false;
+}
 
+bool RTMFPSender::flush(const shared<Queue>& pWriterQueue) {
 	// Flush Queue!
-	while (pSession->sendable && !pQueue->empty()) {
-		TRACE("Stage ", pQueue->stageSending + 1, " sent");
-		shared<Packet>& pPacket(pQueue->front());
-		if (!RTMFP::Send(pSession->socket, *pPacket, address)) {
-			pSession->sendable = 0;
-			break;
-		}
-		--pSession->sendable;
-		pSession->sendTime = Time::Now();
-		pSession->sendByteRate += pPacket->size();
-		pSession->queueing -= pPacket->size();
+	while (!pWriterQueue->empty()) {
+		shared<Packet>& pPacket(pWriterQueue->front());
+		if (!*pPacket->pSent) {
+			if (pSession->inFlight >= pSession->pCongestion->window() || !pace()) {
+				// congestion window full (wait for an ack) or pacing (wait for a token)
+				if (!pWriterQueue->blocked) {
+					pWriterQueue->blocked = true;
+					shared<RTMFPSender> pFlusher(new RTMFPFlusher(_marker, pWriterQueue));
+					pFlusher->address = address;
+					pFlusher->pSession = pSession;
+					pSession->blocked.emplace_back(pFlusher);
+				}
+				return false;
+			}
+			send(*pPacket);
+			*pPacket->pSent = true;
+			pSession->sendTime = Time::Now();
+			pSession->sendByteRate += pPacket->size();
+			pSession->queueing -= pPacket->size();
+		} // else datagram already sent with the packet of an other writer
+		TRACE("Stage ", pWriterQueue->stageSending + 1, " sent");
+		++pSession->inFlight;
+		++pWriterQueue->inFlight;
 		pPacket->setSent();
-		pQueue->stageSending += pPacket->fragments;
-		pQueue->sending.emplace_back(pPacket);
-		pQueue->pop_front();
+		pWriterQueue->stageSending += pPacket->fragments;
+		pWriterQueue->sending.emplace_back(pPacket);
+		pWriterQueue->pop_front();
 	}
 	return true;
 }
 
+void RTMFPSender::flushBlocked() {
+	if (pSession->blocked.empty() || pSession->inFlight >= pSession->pCongestion->window())
+		return;
+	// The flushers are queued in order after us, the ones still blocked when they run come back in Session::blocked
+	std::deque<shared<RTMFPSender>> blocked(std::move(pSession->blocked));
+	pSession->blocked.clear();
+	ThreadQueue* pThread = ThreadQueue::Current();
+	for (shared<RTMFPSender>& pFlusher : blocked) {
+		Exception ex;
+		if (pThread)
+			AUTO_ERROR(pThread->queue(ex, pFlusher), name)
+		else
+			((Runner&)*pFlusher).run(ex); // not in a thread queue
+	}
+}
+
+void RTMFPSender::release(UInt32 count) {
+	if (count > pQueue->inFlight)
+		count = pQueue->inFlight; // already released by a timeout
+	pQueue->inFlight -= count;
+	pSession->inFlight -= count;
+}
+
 void RTMFPCmdSender::run() {
 	// COMMAND
 	shared<Buffer> pBuffer;
 	BinaryWriter(RTMFP::InitBuffer(pBuffer, pSession->initiatorTime, _marker)).write24(UInt32(_cmd << 16));
-	RTMFP::Send(pSession->socket, Base::Packet(pSession->pEncoder->encode(pBuffer, pSession->farId, address)), address);
+	send(Base::Packet(pSession->pEncoder->encode(pBuffer, pSession->farId, address)));
+}
+
+void RTMFPChunkSender::run() {
+	Session& session(*pSession);
+	if (!session.pDatagram || session.datagramMarker != _marker || (session.pDatagram->size() + session.segments.bytes + _chunks.size()) > RTMFP::SIZE_PACKET)
+		newDatagram();
+	session.pDatagram->append(_chunks.data(), _chunks.size());
+	session.datagramUrgent = true;
+	session.pLastQueue = NULL;
+}
+
+void RTMFPResumer::run() {
+	pSession->pacingWait = false;
+	flushBlocked();
+}
+
+void RTMFPReleaser::run() {
+	release(pQueue->inFlight);
+	pQueue->sending.clear();
+	flushBlocked();
 }
 
 void RTMFPAcquiter::run() {
@@ -63,11 +232,31 @@ void RTMFPAcquiter::run() {
 		ERROR("stageAck ", _stageAck, " superior to sending stage ", pQueue->stageSending, " on writer ", pQueue->id);
 		_stageAck = pQueue->stageSending;
 	}
-	while (!pQueue->sending.empty() && _stageAck > pQueue->stageAck) {
+	UInt32 acked(0);
+	// (packets without stage, FEC repairs, are released with the previous ones)
+	while (!pQueue->sending.empty() && (_stageAck > pQueue->stageAck || !pQueue->sending.front()->fragments)) {
 		pQueue->stageAck += pQueue->sending.front()->fragments;
+		acknowledged(*pQueue->sending.front());
 		pQueue->sending.pop_front();
-		pSession->sendable = RTMFP::SENDABLE_MAX; // has progressed, can send max!
+		++acked;
+	}
+	// Packets received after a gap
+	UInt64 stage = pQueue->stageAck;
+	for (shared<Packet>& pPacket : pQueue->sending) {
+		UInt64 first = stage + 1;
+		stage += pPacket->fragments;
+		if (stage > _losts.stageReceived)
+			break;
+		if (!_losts.lost(first, stage, false))
+			acknowledged(*pPacket);
 	}
+	pQueue->losts = std::move(_losts);
+	if (!acked)
+		return;
+	// has progressed, open the congestion window
+	release(acked);
+	pSession->pCongestion->onAck(acked, pSession->rtt, pSession->rttSample);
+	flushBlocked();
 }
 
 void RTMFPRepeater::run() {
@@ -76,20 +265,54 @@ void RTMFPRepeater::run() {
 	bool oneReliable = false;
 	UInt64 abandonStage = 0;
 	UInt64 stage = pQueue->stageAck;
-	UInt8 sendable(RTMFP::SENDABLE_MAX);
+	if (_selective) {
+		pSession->pCongestion->onLoss(pSession->rtt);
+		pQueue->losts = std::move(_losts);
+	} else {
+		// FEC repairs are never repeated, release them if nothing else is waiting
+		UInt32 repairs(0);
+		while (!pQueue->sending.empty() && !pQueue->sending.front()->fragments) {
+			pQueue->sending.pop_front();
+			++repairs;
+		}
+		while (!pQueue->sending.empty() && !pQueue->sending.back()->fragments) {
+			pQueue->sending.pop_back();
+			++repairs;
+		}
+		if (pQueue->sending.empty()) {
+			release(repairs);
+			return;
+		}
+		// timeout, packets of the queue in flight are considered lost
+		pSession->pCongestion->onTimeout();
+		release(pQueue->inFlight);
+	}
+	const Losts& losts(pQueue->losts);
+	UInt32 sendable(pSession->pCongestion->window());
 	for (shared<Packet>& pPacket : pQueue->sending) {
-		DEBUG("Stage ", stage + 1, " repeated (", address, ")");
+		if (!pPacket->fragments)
+			continue; // FEC repairs
+		UInt64 first = stage + 1;
 		stage += pPacket->fragments;
+		if (_selective) {
+			if (losts.empty() || first > losts.back().second)
+				break; // no more lost stages
+			if (stage <= _stageFrom)
+				continue; // already repeated
+		}
+		// repeat only the packets not received by the peer (unknown stages are lost on timeout)
+		if (!losts.lost(first, stage, !_selective))
+			continue;
 		if (pPacket->reliable) {
+			DEBUG("Stage ", first, " repeated (", address, ")");
 			oneReliable = true;
 			if (abandonStage) {
 				sendAbandon(abandonStage);
 				abandonStage = 0;
 			}
-			if (!RTMFP::Send(pSession->socket, *pPacket, address)) {
-				pSession->sendable = 0; // pause sending!
-				break;
-			}
+			send(*pPacket);
+			pPacket->repeatTime = Time::Now();
+			++pSession->repeats;
 			if (!--sendable)
 				break;
 		}
@@ -97,14 +320,11 @@ void RTMFPRepeater::run() {
 			abandonStage = stage;
 			pSession->sendLostRate += pPacket->sizeSent();
 		}
-		if (_fragments) {
-			if (pPacket->fragments >= _fragments)
-				break;
-			_fragments -= pPacket->fragments;
-		}
 	}
 	if (abandonStage)
 		sendAbandon(abandonStage);
+	if (!_selective)
+		flushBlocked(); // our packets in flight have been released
 }
 
 void RTMFPRepeater::sendAbandon(UInt64 stage) {
@@ -112,7 +332,7 @@ void RTMFPRepeater::sendAbandon(UInt64 stage) {
 	BinaryWriter writer(RTMFP::InitBuffer(pBuffer, pSession->initiatorTime, _marker));
 	writer.write8(0x10).write16(2 + Binary::Get7BitValueSize(pQueue->id) + Binary::Get7BitValueSize(stage));
 	writer.write8(RTMFP::MESSAGE_ABANDON).write7BitLongValue(pQueue->id).write7BitLongValue(stage).write8(0);
-	RTMFP::Send(pSession->socket, Base::Packet(pSession->pEncoder->encode(pBuffer, pSession->farId, address)), address);
+	send(Base::Packet(pSession->pEncoder->encode(pBuffer, pSession->farId, address)));
 }
 
 
@@ -120,23 +340,44 @@ UInt32 RTMFPMessenger::headerSize() { // max size header = 50
 	UInt32 size = Binary::Get7BitValueSize(pQueue->id);
 	size += Binary::Get7BitValueSize(pQueue->stage);
 	size += Binary::Get7BitValueSize(pQueue->stage - pQueue->stageAck);
-	size += pQueue->stageAck ? 0 : (pQueue->signature.size() + (pQueue->flowId ? (4 + Binary::Get7BitValueSize(pQueue->flowId)) : 2));
+	size += pQueue->stageAck ? 0 : (pQueue->signature.size() + (pQueue->flowId ? (4 + Binary::Get7BitValueSize(pQueue->flowId) + (pQueue->fec ? 3 : 0)) : 2));
 	return size;
 }
 
 
 void RTMFPMessenger::run() {
+	if (!pQueue->pFEC && pQueue->fecAccepted)
+		pQueue->pFEC.reset(new RTMFPFEC::Encoder(pQueue->fec));
 	for (Message& message : _messages)
 		write(message);
-	flush();
+	if (pQueue->pFEC && pQueue->pFEC->closable())
+		repair();
 }
 
-void RTMFPMessenger::flush() {
-	if (!_pBuffer)
-		return;
-	// encode and add to pQueue
-	pQueue->emplace_back(new Packet(pSession->pEncoder->encode(_pBuffer, pSession->farId, address), _fragments, _flags&RTMFP::MESSAGE_RELIABLE ? true : false));
-	pSession->queueing += pQueue->back()->size();
+void RTMFPMessenger::repair() {
+	RTMFPFEC::Encoder& encoder(*pQueue->pFEC);
+	if (encoder.useful()) {
+		Session& session(*pSession);
+		UInt32 size(encoder.repairSize(pQueue->id));
+		for (UInt8 index = 0; index < encoder.config.repairs; ++index) {
+			Session::Part* pPart(NULL);
+			if (session.pDatagram && session.datagramMarker == _marker && (session.pDatagram->size() + session.segments.bytes + size) <= RTMFP::SIZE_PACKET) {
+				for (Session::Part& part : session.parts) {
+					if (part.pQueue == pQueue) {
+						pPart = &part;
+						break;
+					}
+				}
+			} else
+				newDatagram();
+			if (!pPart)
+				session.parts.emplace_back(pQueue, false, 0); // repairs have no stage
+			BinaryWriter writer(*session.pDatagram);
+			encoder.writeRepair(writer, pQueue->id, index);
+		}
+		session.pLastQueue = NULL; // no continuation chunk after a repair
+	}
+	encoder.reset();
 }
 
 void RTMFPMessenger::write(const Message& message) {
@@ -144,6 +385,7 @@ void RTMFPMessenger::write(const Message& message) {
 	UInt32 size = message.packet.size();
 	UInt32 available = size;
 	const UInt8* current;
+	bool inPacket(!message.writer); // current is in message.packet (can be referenced rather than copied)
 	if (message.writer) {
 		current = message.writer->data();
 		available = message.writer->size();
@@ -152,7 +394,11 @@ void RTMFPMessenger::write(const Message& message) {
 	else
 		current = message.packet.data();
 
-	bool header(!_pBuffer);
+	Session& session(*pSession);
+	// continuation chunk (0x11) only if the last chunk of the datagram is ours
+	bool header(!session.pDatagram || session.pLastQueue != pQueue.get());
+	// with FEC keep enough place in the datagram to write a repair of the same size
+	UInt32 sizePacket(pQueue->pFEC ? (RTMFP::SIZE_PACKET - RTMFPFEC::MARGIN) : RTMFP::SIZE_PACKET);
 	do {
 		++pQueue->stage;
 
@@ -162,28 +408,40 @@ void RTMFPMessenger::write(const Message& message) {
 		if (header)
 			headerSize += this->headerSize();
 
-		UInt32 availableToWrite(RTMFP::SIZE_PACKET);
-		if (_pBuffer)
-			availableToWrite -= _pBuffer->size();
+		UInt32 availableToWrite(sizePacket);
+		if (session.pDatagram)
+			availableToWrite -= session.pDatagram->size() + session.segments.bytes;
+		// Chunks of our queue already in the datagram (one packet per queue, so with the same reliability)
+		Session::Part* pPart(NULL);
+		if (session.pDatagram) {
+			for (Session::Part& part : session.parts) {
+				if (part.pQueue == pQueue) {
+					pPart = &part;
+					break;
+				}
+			}
+		}
 		// headerSize+16 to avoid a useless fragment (without payload data)
-		if (!_pBuffer || (headerSize + 16) > availableToWrite || message.reliable != (_flags&RTMFP::MESSAGE_RELIABLE ? true : false)) {
-			flush();
+		if (!session.pDatagram || session.datagramMarker != _marker || (headerSize + 16) > availableToWrite || (pPart && message.reliable != pPart->reliable)) {
 			// New packet
 			if (!header) {
 				headerSize += this->headerSize();
 				header = true;
 			}
-			RTMFP::InitBuffer(_pBuffer, pSession->initiatorTime, _marker);
-			_fragments = 1;
+			newDatagram();
+			session.parts.emplace_back(pQueue, message.reliable);
 
-			if ((headerSize + contentSize) > RTMFP::SIZE_PACKET)
-				contentSize = RTMFP::SIZE_PACKET - headerSize;
+			if ((headerSize + contentSize) > sizePacket)
+				contentSize = sizePacket - headerSize;
 
 		}
 		else {
 			if ((headerSize + contentSize)>availableToWrite)
 				contentSize = availableToWrite - headerSize;
-			++_fragments;
+			if (pPart)
+				++pPart->fragments;
+			else
+				session.parts.emplace_back(pQueue, message.reliable);
 		}
 
 		size -= contentSize;
@@ -199,12 +457,11 @@ void RTMFPMessenger::write(const Message& message) {
 				_flags |= RTMFP::MESSAGE_WITH_AFTERPART;
 		}
 
-		BinaryWriter writer(*_pBuffer);
+		session.pLastQueue = pQueue.get();
+		BinaryWriter writer(*session.pDatagram);
 		writer.write8(header ? 0x10 : 0x11);
 		writer.write16(headerSize - RTMFP::SIZE_HEADER - 3 + contentSize);
 		writer.write8(_flags);
-		if (message.reliable)
-			_flags |= RTMFP::MESSAGE_RELIABLE;
 
 		if (header) {
 			writer.write7BitLongValue(pQueue->id);
@@ -219,24 +476,42 @@ void RTMFPMessenger::write(const Message& message) {
 					writer.write8(1 + Binary::Get7BitValueSize(pQueue->flowId)); // following size
 					writer.write8(0x0a); // Unknown!
 					writer.write7BitLongValue(pQueue->flowId);
+					if (pQueue->fec)
+						writer.write8(2).write8(RTMFPFEC::OPTION).write8(pQueue->fec.scheme); // FEC offer (librtmfp extension)
 				}
 				writer.write8(0); // marker of end for this part
 			}
 		}
 
+		bool protect(pQueue->pFEC && pQueue->pFEC->add(pQueue->stage, _flags, contentSize, message.reliable));
+
+		// The payload of message.packet is referenced, encrypted directly from it by closeDatagram (no copy)
+		auto write = [&](const UInt8* data, UInt32 size) {
+			if (protect)
+				pQueue->pFEC->append(data, size);
+			if (inPacket && size >= SEGMENT_MIN)
+				session.segments.add(session.pDatagram->size(), message.packet, data, size);
+			else
+				writer.write(data, size);
+		};
 		if (contentSize>available) {
-			writer.write(current, available);
+			write(current, available);
 			available = contentSize - available;
 			current = message.packet.data();
-			writer.write(current, available);
+			inPacket = true;
+			write(current, available);
 			current += available;
 			available = size;
 		}
 		else {
-			writer.write(current, contentSize);
+			write(current, contentSize);
 			current += contentSize;
 			available -= contentSize;
 		}
 
+		if (protect && pQueue->pFEC->closable()) {
+			repair();
+			header = true;
+		}
 	} while (size);
 }
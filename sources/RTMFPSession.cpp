@@ -36,9 +36,10 @@ using namespace std;
 
 UInt32 RTMFPSession::RTMFPSessionCounter = 0x02000000;
 
-RTMFPSession::RTMFPSession(Invoker& invoker, OnSocketError pOnSocketError, OnStatusEvent pOnStatusEvent, OnMediaEvent pOnMediaEvent) : _rawId(PEER_ID_SIZE + 2, '\0'),
-	_handshaker(this), _isWaitingStream(false), _mediaCount(0), p2pPublishReady(false), p2pPlayReady(false), publishReady(false), connectReady(false), dataAvailable(false), _threadRcv(0),
-	FlowManager(false, invoker, pOnSocketError, pOnStatusEvent), _pOnMedia(pOnMediaEvent), _pSocket(new UDPSocket(_invoker.sockets)), _pSocketIPV6(new UDPSocket(_invoker.sockets)) {
+RTMFPSession::RTMFPSession(Invoker& invoker, const RTMFPConfig& config) : _rawId(PEER_ID_SIZE + 2, '\0'),
+	_handshaker(this), _isWaitingStream(false), _mediaCount(0), p2pPublishReady(false), p2pPlayReady(false), publishReady(false), connectReady(false), dataAvailable(false), closed(false),
+	FlowManager(false, invoker, config.pOnSocketError, config.pOnStatusEvent, (UInt8)config.congestionControl, config.pacingBurst, RTMFPFEC::Config((UInt8)config.fecScheme, (UInt8)config.fecSources, (UInt8)config.fecRepairs)),
+	_pOnMedia(config.pOnMedia), _playoutMinLatency(config.playoutMinLatency), _playoutMaxLatency(config.playoutMaxLatency), _queueSize(config.queueSize), _queueBlocking(config.queueBlocking>0), _connected(false), _pSocket(new UDPSocket(_invoker.sockets)), _pSocketIPV6(new UDPSocket(_invoker.sockets)) {
 
 	_pSocketIPV6->onPacket = _pSocket->onPacket = [this](shared<Buffer>& pBuffer, const SocketAddress& address) {
 		if (status > RTMFP::NEAR_CLOSED)
@@ -69,9 +70,13 @@ RTMFPSession::RTMFPSession(Invoker& invoker, OnSocketError pOnSocketError, OnSta
 			return;
 		}
 
-		shared_ptr<RTMFPDecoder> pDecoder(new RTMFPDecoder(idSession, address, pEngine, pBuffer, _invoker.handler));
-		pDecoder->onDecoded = _onDecoded;
-		AUTO_ERROR(_invoker.threadPool.queue(ex, pDecoder, _threadRcv), "RTMFP Decode")
+		// Each session has its own decoding pipeline (decoded in parallel, ordered by session)
+		shared_ptr<RTMFPDecoder>& pDecoder(_decoders[idSession]);
+		if (!pDecoder) {
+			pDecoder.reset(new RTMFPDecoder(idSession, _invoker.handler, _invoker.threadPool));
+			pDecoder->onDecoded = _onDecoded;
+		}
+		AUTO_ERROR(pDecoder->decode(ex, pEngine, pBuffer, address), "RTMFP Decode")
 	};
 	_pSocketIPV6->onError = _pSocket->onError = [this](const Exception& ex) {
 		SocketAddress address;
@@ -120,44 +125,63 @@ RTMFPSession::RTMFPSession(Invoker& invoker, OnSocketError pOnSocketError, OnSta
 		handleNewGroupPeer(rawId, peerId);
 	};
 	onMediaPlay = _pMainStream->onMedia = [this](UInt16 mediaId, UInt32 time, const Packet& packet, double lostRate, AMF::Type type) {
+		RTMFP::Fragments fragments;
+		fragments.add(packet);
+		onMediaPlayFragments(mediaId, time, fragments, lostRate, type);
+	};
+	onMediaPlayFragments = _pMainStream->onMediaFragments = [this](UInt16 mediaId, UInt32 time, const RTMFP::Fragments& fragments, double lostRate, AMF::Type type) {
 		auto itMedia = _mapPlayers.find(mediaId);
 		if (itMedia == _mapPlayers.end()) {
 			WARN("Unable to find media ", mediaId) // implementation error
-			return;
+			return true;
 		}
 		MediaPlayer& media = itMedia->second;
+		const Packet& first(fragments.front()); // enough to check the media header
 
 		if (!media.codecInfosRead) {
-			if (type == AMF::TYPE_VIDEO && RTMFP::IsVideoCodecInfos(packet.data(), packet.size())) {
+			if (type == AMF::TYPE_VIDEO && RTMFP::IsVideoCodecInfos(first.data(), first.size())) {
 				INFO("Video codec infos found, starting to read")
 				media.codecInfosRead = true;
 			}
 			else {
 				if (type == AMF::TYPE_VIDEO)
 					DEBUG("Video frame dropped to wait first key frame");
-				return;
+				return true;
 			}
 		}
 
 		// AAC (correct the issue with ffmpeg aac decoder!)
-		if (type == AMF::TYPE_AUDIO && !media.AACsequenceHeaderRead && (packet.size()>1 && (*packet.data() >> 4) == 0x0A)) {
-			if (!RTMFP::IsAACCodecInfos(packet.data(), packet.size()))
-				return; // ignore until finding the AAC sequence header
+		if (type == AMF::TYPE_AUDIO && !media.AACsequenceHeaderRead && (first.size()>1 && (*first.data() >> 4) == 0x0A)) {
+			if (!RTMFP::IsAACCodecInfos(first.data(), first.size()))
+				return true; // ignore until finding the AAC sequence header
 			INFO("AAC codec infos found, starting to read audio part")
 			media.AACsequenceHeaderRead = true;
 		}
 
-		if (_pOnMedia) // Synchronous read
+		if (_pOnMedia) { // Synchronous read
+			Packet packet;
+			fragments.linearize(packet);
 			_pOnMedia(mediaId, time, STR packet.data(), packet.size(), type);
-		else { // Asynchronous read
-			media.mediaPackets.emplace_back(new MediaPlayer::RTMFPMediaPacket(packet, time, type));
-			if (!dataAvailable)
-				dataAvailable = true;
+		} else { // Asynchronous read
+			shared_ptr<RTMFPMediaPacket> pPacket(new RTMFPMediaPacket(fragments, time, type));
+			if (type == AMF::TYPE_VIDEO && media.waitKeyFrame) {
+				if (!pPacket->essential()) {
+					++media.dropped;
+					return true;
+				}
+				media.waitKeyFrame = false;
+			}
+			media.push(pPacket);
+			signalMedia(media);
 		}
+		return true;
 	};
 	onPushAudio = [this](MediaPacket& packet) { _pPublisher->pushAudio(packet.time, packet); };
 	onPushVideo = [this](MediaPacket& packet) { _pPublisher->pushVideo(packet.time, packet); };
-	onFlushPublisher = [this]() { _pPublisher->flush(); };
+	onFlushPublisher = [this]() {
+		_pPublisher->flush();
+		_invoker.schedule(*this, DELAY_CONNECTIONS_MANAGER); // to repeat the messages not acknowledged
+	};
 	_onDecoded = [this](RTMFPDecoder::Decoded& decoded) {
 
 		lock_guard<mutex> lock(_mutexConnections);
@@ -171,6 +195,8 @@ RTMFPSession::RTMFPSession(Invoker& invoker, OnSocketError pOnSocketError, OnSta
 			}
 			itSession->second->receive(decoded.address, decoded);
 		}
+		// acknowledgments are delayed and messages can wait to be repeated
+		_invoker.schedule(*this, DELAY_CONNECTIONS_MANAGER);
 	};
 
 	_sessionId = RTMFPSessionCounter++;
@@ -241,7 +267,10 @@ void RTMFPSession::close(bool abrupt) {
 	// Close the session & writers
 	_pGroupWriter.reset();
 	_pMainWriter.reset();
+	_connected = false;
 	FlowManager::close(abrupt);
+	closed = true;
+	notifier.set();
 
 	if (abrupt) {
 		// Close the NetGroup
@@ -327,6 +356,7 @@ bool RTMFPSession::connect(Exception& ex, const char* url, const char* host) {
 		_handshaker.startHandshake(_pHandshake, address, addresses, this, false, false);
 	} else
 		return false;
+	_invoker.wake(*this); // send the handshake
 	return true;
 }
 
@@ -335,7 +365,8 @@ UInt16 RTMFPSession::connect2Peer(const char* peerId, const char* streamName) {
 	PEER_LIST_ADDRESS_TYPE emptyAddresses;
 	SocketAddress emptyHost; // We don't know the peer's host address
 	if (connect2Peer(peerId, streamName, emptyAddresses, emptyHost, _mediaCount + 1)) {
-		_mapPlayers.emplace(piecewise_construct, forward_as_tuple(++_mediaCount), forward_as_tuple());
+		addPlayer(++_mediaCount);
+		_invoker.wake(*this); // send the handshake
 		return _mediaCount;
 	}
 	return 0;
@@ -423,20 +454,122 @@ UInt16 RTMFPSession::connect2Group(const char* streamName, RTMFPGroupConfig* par
 			}
 			_pPublisher.reset(new Publisher(streamName, _invoker, true, true, true));
 		} else // Create the player
-			_mapPlayers.emplace(piecewise_construct, forward_as_tuple(_mediaCount+1), forward_as_tuple());
+			addPlayer(_mediaCount+1);
 
 		_group.reset(new NetGroup(++_mediaCount, groupHex, groupTxt, streamName, *this, parameters));
 		_group->onMedia = onMediaPlay;
 		_group->onStatus = _pMainStream->onStatus;
 		_waitingGroup.push_back(groupHex);
+		_invoker.wake(*this); // send the group connection
 		return _mediaCount;
 	}
 }
 
+void RTMFPSession::addPlayer(UInt16 mediaId) {
+	lock_guard<mutex> lock(_mutexPlayers);
+	_mapPlayers.emplace(piecewise_construct, forward_as_tuple(mediaId), forward_as_tuple(_playoutMinLatency, _playoutMaxLatency, _queueSize, _queueBlocking));
+}
+
+RTMFPSession::MediaPlayer* RTMFPSession::player(UInt16 mediaId) {
+	lock_guard<mutex> lock(_mutexPlayers);
+	auto itMedia = _mapPlayers.find(mediaId);
+	return itMedia == _mapPlayers.end() ? NULL : &itMedia->second;
+}
+
+void RTMFPSession::MediaPlayer::push(const shared_ptr<RTMFPMediaPacket>& pPacket) {
+	if (flush() && queue.push(shared_ptr<RTMFPMediaPacket>(pPacket)))
+		return;
+	// Late reader : the packet waits in order without blocking the reception
+	if (overflow.empty()) {
+		++blocked;
+		overflowing = true;
+	}
+	overflow.emplace_back(pPacket);
+	UInt32 limit(blocking ? queue.capacity() : (queue.capacity() / 2));
+	if (overflow.size() <= limit)
+		return;
+
+	// Overflow full : drop the oldest non-key frames (the key frames are kept to restart the decoding),
+	// and the next video frames until a key frame once a video frame is dropped
+	UInt32 count(0);
+	bool videoBroken(false);
+	auto it = overflow.begin();
+	while (it != overflow.end() && (videoBroken || overflow.size() > (limit / 2))) {
+		const RTMFPMediaPacket& packet(**it);
+		if (packet.essential()) {
+			if (packet.type == AMF::TYPE_VIDEO)
+				videoBroken = false;
+			++it;
+			continue;
+		}
+		if (packet.type == AMF::TYPE_VIDEO)
+			videoBroken = true;
+		else if (overflow.size() <= (limit / 2)) {
+			++it;
+			continue;
+		}
+		it = overflow.erase(it);
+		++count;
+	}
+	if (videoBroken)
+		waitKeyFrame = true;
+	if (overflow.size() > limit) {
+		overflow.pop_front(); // only essential packets, the oldest one is dropped
+		++count;
+	}
+	dropped += count;
+	DEBUG("Reader is late, ", count, " packets dropped")
+}
+
+bool RTMFPSession::MediaPlayer::flush() {
+	while (!overflow.empty() && queue.push(move(overflow.front())))
+		overflow.pop_front();
+	if (!overflow.empty())
+		return false;
+	if (overflowing)
+		overflowing = false;
+	return true;
+}
+
+void RTMFPSession::MediaPlayer::pull(Int64 now) {
+	// The packets stay in the queue while the reader is late, the session drops them
+	shared_ptr<RTMFPMediaPacket> pPacket;
+	while (mediaPackets.size() < queue.capacity() && queue.pop(pPacket)) {
+		if (pPlayout)
+			pPlayout->add(pPacket->arrival, pPacket);
+		else
+			mediaPackets.emplace_back(move(pPacket));
+	}
+	if (pPlayout && mediaPackets.size() < queue.capacity())
+		pPlayout->release(now, mediaPackets);
+}
+
+void RTMFPSession::signalMedia(MediaPlayer& media) {
+	atomic_thread_fence(memory_order_seq_cst); // the queue is written before reading dataAvailable (see updateDataAvailable)
+	media.notifier.set();
+	if (!dataAvailable.exchange(true)) {
+		readSignal.set();
+		notifier.set();
+	}
+}
+
+void RTMFPSession::updateDataAvailable(MediaPlayer& media) {
+	if (!media.mediaPackets.empty())
+		return;
+	media.notifier.reset();
+	if (dataAvailable)
+		dataAvailable = false;
+	atomic_thread_fence(memory_order_seq_cst);
+	if (!media.queue.empty()) { // pushed meanwhile
+		media.notifier.set();
+		dataAvailable = true;
+		readSignal.set();
+	}
+}
+
 int RTMFPSession::read(UInt16 mediaId, UInt8* buf, UInt32 size, int& nbRead) {
 	
-	lock_guard<mutex> lock(_mutexConnections);
-	if (status != RTMFP::CONNECTED) {
+	if (!_connected) {
 		WARN("Connection is not established, cannot read data")
 		return 0; // to stop the parent loop
 	}
@@ -444,55 +577,146 @@ int RTMFPSession::read(UInt16 mediaId, UInt8* buf, UInt32 size, int& nbRead) {
 		ERROR("Parameter nbRead must equal zero in readAsync()")
 		return -1;
 	}
-	auto itMedia = _mapPlayers.find(mediaId);
-	if (itMedia == _mapPlayers.end()) {
+	MediaPlayer* pMedia = player(mediaId);
+	if (!pMedia) {
 		WARN("Unable to find media ", mediaId, ", it can be closed")
 		return 0;
 	}
+	MediaPlayer& media(*pMedia);
+	lock_guard<mutex> lock(media.mutexRead);
+	media.pull(Time::Now());
+	if (media.overflowing)
+		_invoker.wake(*this); // to push the overflow in the queue
 
-	bool available = false;
-	if (!itMedia->second.mediaPackets.empty()) {
+	if (!media.mediaPackets.empty()) {
 		// First read => send header
 		BinaryWriter writer(buf, size);
-		if (itMedia->second.firstRead && size > 13) {
+		if (media.firstRead && size > 13) {
 			writer.write(EXPAND("FLV\x01\x05\x00\x00\x00\x09\x00\x00\x00\x00"));
-			itMedia->second.firstRead = false;
+			media.firstRead = false;
 		}
 
 		// While media packets are available and buffer is not full
-		while (!itMedia->second.mediaPackets.empty() && (writer.size() < size - 15)) {
+		while (!media.mediaPackets.empty() && (writer.size() < size - 15)) {
 
 			// Read next packet
-			std::shared_ptr<MediaPlayer::RTMFPMediaPacket>& packet = itMedia->second.mediaPackets.front();
-			UInt32 bufferSize = packet->size() - packet->pos;
+			std::shared_ptr<RTMFPMediaPacket>& packet = media.mediaPackets.front();
+			UInt32 bufferSize = packet->fragments.bytes - packet->pos;
 			UInt32 toRead = (bufferSize > (size - writer.size() - 15)) ? size - writer.size() - 15 : bufferSize;
 
 			// header
 			if (!packet->pos) {
 			writer.write8(packet->type);
-			writer.write24(packet->size()); // size on 3 bytes
+			writer.write24(packet->fragments.bytes); // size on 3 bytes
 			writer.write24(packet->time); // time on 3 bytes
 			writer.write32(0); // unknown 4 bytes set to 0
 			}
-			writer.write(packet->data() + packet->pos, toRead); // payload
+			packet->fragments.write(writer, packet->pos, toRead); // payload
 
 			// If packet too big : save position and exit, else write footer
 			if (bufferSize > toRead) {
 				packet->pos += toRead;
 				break;
 			}
-			writer.write32(11 + packet->size()); // footer, size on 4 bytes
-			itMedia->second.mediaPackets.pop_front();
+			writer.write32(11 + packet->fragments.bytes); // footer, size on 4 bytes
+			media.mediaPackets.pop_front();
 		}
-		// Finally update the nbRead & available
+		// Finally update the nbRead
 		nbRead = writer.size();
-		available = !itMedia->second.mediaPackets.empty();
 	}
-	if (!available && dataAvailable)
-		dataAvailable = false;
+	updateDataAvailable(media);
+	return 1;
+}
+
+int RTMFPSession::read(UInt16 mediaId, shared_ptr<RTMFPMediaPacket>& pPacket, bool& header) {
+
+	if (!_connected) {
+		WARN("Connection is not established, cannot read data")
+		return 0; // to stop the parent loop
+	}
+	MediaPlayer* pMedia = player(mediaId);
+	if (!pMedia) {
+		WARN("Unable to find media ", mediaId, ", it can be closed")
+		return 0;
+	}
+	MediaPlayer& media(*pMedia);
+	lock_guard<mutex> lock(media.mutexRead);
+	media.pull(Time::Now());
+	if (media.overflowing)
+		_invoker.wake(*this); // to push the overflow in the queue
+
+	if (!media.mediaPackets.empty()) {
+		pPacket = move(media.mediaPackets.front());
+		media.mediaPackets.pop_front();
+		header = media.firstRead;
+		media.firstRead = false;
+	}
+	updateDataAvailable(media);
 	return 1;
 }
 
+UInt32 RTMFPSession::readDelay(UInt16 mediaId) {
+	MediaPlayer* pMedia = player(mediaId);
+	if (!pMedia)
+		return 100;
+	lock_guard<mutex> lock(pMedia->mutexRead);
+	if (!pMedia->pPlayout || !pMedia->mediaPackets.empty())
+		return 100;
+	UInt32 delay = pMedia->pPlayout->delay(Time::Now());
+	return delay > 100 ? 100 : (delay ? delay : 1);
+}
+
+bool RTMFPSession::playoutStats(UInt16 mediaId, UInt32& latency, UInt32& jitter, UInt32& buffered, UInt64& late, UInt64& dropped) {
+	MediaPlayer* pMedia = player(mediaId);
+	if (!pMedia || !pMedia->pPlayout)
+		return false;
+	lock_guard<mutex> lock(pMedia->mutexRead);
+	const RTMFPPlayout& playout(*pMedia->pPlayout);
+	latency = playout.latency();
+	jitter = playout.jitter();
+	buffered = playout.size();
+	late = playout.late;
+	dropped = playout.dropped;
+	return true;
+}
+
+int RTMFPSession::streamDescriptor(UInt16 mediaId) {
+	MediaPlayer* pMedia = player(mediaId);
+	return pMedia ? pMedia->notifier.fd() : -1;
+}
+
+int RTMFPSession::state() {
+	notifier.reset();
+	if (dataAvailable)
+		notifier.set(); // level-triggered while data is not read
+	int flags = 0;
+	if (connectReady)
+		flags |= RTMFP_STATE_CONNECTED;
+	if (publishReady)
+		flags |= RTMFP_STATE_PUBLISHED;
+	if (p2pPublishReady)
+		flags |= RTMFP_STATE_P2P_PUBLISHED;
+	if (p2pPlayReady)
+		flags |= RTMFP_STATE_P2P_PLAYING;
+	if (dataAvailable)
+		flags |= RTMFP_STATE_DATA;
+	if (closed)
+		flags |= RTMFP_STATE_CLOSED;
+	return flags;
+}
+
+bool RTMFPSession::queueStats(UInt16 mediaId, UInt32& depth, UInt32& capacity, UInt64& dropped, UInt64& blocked) {
+	MediaPlayer* pMedia = player(mediaId);
+	if (!pMedia)
+		return false;
+	lock_guard<mutex> lock(pMedia->mutexRead);
+	depth = pMedia->queue.size() + pMedia->mediaPackets.size();
+	capacity = pMedia->queue.capacity();
+	dropped = pMedia->dropped;
+	blocked = pMedia->blocked;
+	return true;
+}
+
 bool RTMFPSession::write(const UInt8* data, UInt32 size, int& pos) {
 	{
 		lock_guard<mutex> lock(_mutexConnections);
@@ -551,6 +775,7 @@ bool RTMFPSession::write(const UInt8* data, UInt32 size, int& pos) {
 }
 
 unsigned int RTMFPSession::callFunction(const char* function, int nbArgs, const char** args, const char* peerId) {
+	_invoker.wake(*this); // to repeat the call if not acknowledged
 	// Server call
 	if (!peerId && _pMainStream && _pMainWriter) {
 		// TODO: refactorize with P2PSession code
@@ -577,10 +802,11 @@ unsigned int RTMFPSession::callFunction(const char* function, int nbArgs, const
 	return 0;
 }
 
-void RTMFPSession::manage() {
+UInt32 RTMFPSession::manage() {
 	lock_guard<mutex> lock(_mutexConnections);
 	if (!_pMainStream)
-		return;
+		return DELAY_CONNECTIONS_IDLE;
+	UInt32 delay(DELAY_CONNECTIONS_IDLE), next;
 
 	// Release closed P2P connections
 	auto itPeer = _mapPeersById.begin();
@@ -588,18 +814,21 @@ void RTMFPSession::manage() {
 		if (itPeer->second->failed()) {
 			DEBUG("RTMFPSession management - Deleting closed P2P session to ", itPeer->first)
 			auto nbRemoved = _mapSessions.erase(itPeer->second->sessionId());
+			_decoders.erase(itPeer->second->sessionId());
 			if (nbRemoved != 1)
 				WARN("RTMFPSession management - Error to remove P2P session ", itPeer->first, " (", itPeer->second->sessionId(),") : ", nbRemoved)
 			_mapPeersById.erase(itPeer++);
 		}
 		else {
-			itPeer->second->manage();
+			if ((next = itPeer->second->manage()) < delay)
+				delay = next;
 			++itPeer;
 		}
 	}
 
 	// Manage the flows
-	FlowManager::manage();
+	if ((next = FlowManager::manage()) < delay)
+		delay = next;
 
 	// Treat waiting commands
 	createWaitingStreams();
@@ -608,15 +837,34 @@ void RTMFPSession::manage() {
 	sendConnections();
 
 	// Send waiting handshake requests
-	_handshaker.manage();
+	if ((next = _handshaker.manage()) < delay)
+		delay = next;
 
-	// Manage NetGroup
-	if (_group)
+	// Manage NetGroup (periodic work : fragments map, push and pull)
+	if (_group) {
 		_group->manage();
+		delay = DELAY_CONNECTIONS_MANAGER;
+	}
+	// Commands waiting for the connection or a stream creation
+	if (!_waitingStreams.empty() || !_waitingGroup.empty())
+		delay = DELAY_CONNECTIONS_MANAGER;
+
+	// Media waiting for a place in the queues of the players (blocking mode)
+	for (auto& it : _mapPlayers) {
+		MediaPlayer& media(it.second);
+		if (media.overflow.empty())
+			continue;
+		UInt32 waiting(media.overflow.size());
+		if (!media.flush())
+			delay = DELAY_CONNECTIONS_MANAGER;
+		if (media.overflow.size() < waiting)
+			signalMedia(media);
+	}
 
 	// notify the client that data is available to flush
 	if (dataAvailable)
 		readSignal.set();
+	return delay;
 }
 
 Base::UInt16 RTMFPSession::addStream(bool publisher, const char* streamName, bool audioReliable, bool videoReliable) {
@@ -629,7 +877,8 @@ Base::UInt16 RTMFPSession::addStream(bool publisher, const char* streamName, boo
 		
 	_waitingStreams.emplace(publisher, streamName, ++_mediaCount, audioReliable, videoReliable);
 	if (!publisher)
-		_mapPlayers.emplace(piecewise_construct, forward_as_tuple(_mediaCount), forward_as_tuple());
+		addPlayer(_mediaCount);
+	_invoker.wake(*this); // create the stream
 	INFO("Creation of the ", publisher? "publisher" : "player", " stream ", _mediaCount)
 	return _mediaCount;
 }
@@ -664,6 +913,7 @@ bool RTMFPSession::closePublication(const char* streamName) {
 	}
 	if (_group)
 		_group->stopListener();
+	_invoker.wake(*this); // send the last messages
 	return true;
 }
 
@@ -723,6 +973,7 @@ void RTMFPSession::onNetConnectionSuccess() {
 	// We are connected : unlock the possible blocking RTMFP_Connect function
 	connectReady = true;
 	connectSignal.set();
+	notifier.set();
 }
 
 void RTMFPSession::onPublished(UInt16 streamId) {
@@ -739,8 +990,7 @@ void RTMFPSession::onPublished(UInt16 streamId) {
 	if (!(_pListener = _pPublisher->addListener<FlashListener, shared_ptr<RTMFPWriter>&>(ex, name(), pDataWriter, pAudioWriter, pVideoWriter)))
 		WARN(ex)
 
-	publishReady = true;
-	publishSignal.set();
+	setPublishReady();
 }
 
 void RTMFPSession::stopListening(const string& peerId) {
@@ -869,6 +1119,7 @@ void RTMFPSession::onConnection() {
 	INFO("RTMFPSession is now connected to ", name())
 	removeHandshake(_pHandshake);
 	status = RTMFP::CONNECTED;
+	_connected = true;
 	_pMainWriter = createWriter(Packet(EXPAND("\x00\x54\x43\x04\x00")), 0);
 
 	// Send the connect request
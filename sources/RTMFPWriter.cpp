@@ -30,7 +30,7 @@ using namespace std;
 using namespace Base;
 
 RTMFPWriter::RTMFPWriter(UInt8 marker, UInt64 id, UInt64 flowId, const Binary& signature, RTMFP::Output& output) :
-	_marker(marker), _repeatDelay(0), _output(output), _stageAck(0), _lostCount(0), id(id), flowId(flowId), signature(signature) {
+	_marker(marker), _repeatDelay(0), _output(output), _stageAck(0), _lostStage(0), id(id), flowId(flowId), signature(signature) {
 	_pQueue.reset(new RTMFPSender::Queue(id, flowId, signature));
 }
 
@@ -51,47 +51,43 @@ void RTMFPWriter::close(Int32 error, const char* reason) {
 	_state = (_state>=NEAR_CLOSED) ? CLOSED : NEAR_CLOSED; // before flush to get MESSAGE_END!
 }
 
-void RTMFPWriter::acquit(UInt64 stageAck, UInt32 lostCount) {
-	TRACE("Ack ", stageAck, " on writer ", _pQueue->id, " (lostCount=", lostCount, ")");
+void RTMFPWriter::acquit(UInt64 stageAck, RTMFPSender::Losts& losts) {
+	TRACE("Ack ", stageAck, " on writer ", _pQueue->id, " (lost ranges=", losts.size(), ")");
 	// have to continue to become consumed even if writer closed!
 	if (stageAck > _stageAck) {
 		// progress!
 		_stageAck = stageAck;
-		_lostCount = 0;
 		// reset repeat time on progression!
 		_repeatDelay = _output.rto();
 		_repeatTime.update();
 		// continue sending
-		_output.send(make_shared<RTMFPAcquiter>(_marker, _pQueue, _stageAck));
-		return;
-	}
-	if (!lostCount) {
+		_output.send(make_shared<RTMFPAcquiter>(_marker, _pQueue, _stageAck, RTMFPSender::Losts(losts)));
+	} else if (losts.empty()) {
 		DEBUG("Ack ", stageAck, " obsolete on writer ", _pQueue->id);
 		return;
 	}
-	if (lostCount > _lostCount) {
-		/// emulate ERTO-timeout=ping if lost infos =>
-		// repeating is caused by a gap in ack-range, it can be a packet lost or an non-ordering transfer
-		// to avoid a self-sustaining congestion repeated just the first missing packet if lost infos are present
-		// and just once time (raising=true, to emulate first RTMFP ERTO=ping), let do the trigger after
-		repeatMessages(_lostCount = lostCount);
-	}
-}
-
-void RTMFPWriter::repeatMessages(UInt32 lostCount) {
-	if (lostCount) {
-		// means that there is something lost! We can start a repeation without wait end of current sending
-		_output.send(make_shared<RTMFPRepeater>(_marker, _pQueue, lostCount>0xFF ? 0xFF : lostCount));
+	if (losts.empty() || losts.back().second <= _lostStage)
 		return;
-	}
-	if (!_pQueue.unique())
+	/// emulate ERTO-timeout=ping if lost infos =>
+	// repeating is caused by a gap in ack-range, it can be a packet lost or an non-ordering transfer
+	// to avoid a self-sustaining congestion repeat only the lost stages not already repeated,
+	// and just once time (raising=true, to emulate first RTMFP ERTO=ping), let do the trigger after
+	UInt64 stageFrom = _lostStage > _stageAck ? _lostStage : _stageAck;
+	_lostStage = losts.back().second;
+	_output.send(make_shared<RTMFPRepeater>(_marker, _pQueue, move(losts), stageFrom));
+}
+
+void RTMFPWriter::repeatMessages() {
+	if (_pQueue.unique()) {
+		// REPEAT! (the queue can be read only if no sender holds it)
+		if (_pQueue->empty() && _pQueue->sending.empty()) {
+			// nothing to repeat, stop repeat
+			_repeatDelay = 0;
+			return;
+		}
+	} else if (!_repeatDelay)
 		return; // wait next! is sending, wait before to repeat packets
-				// REPEAT!
-	if (_pQueue->empty()) {
-		// nothing to repeat, stop repeat
-		_repeatDelay = 0;
-		return;
-	}
+	// else repeat on timeout even if the queue is held by its flusher (blocked by the congestion window), to release its packets in flight
 	if (!_repeatTime.isElapsed(_repeatDelay))
 		return;
 	_repeatTime.update();
@@ -102,6 +98,25 @@ void RTMFPWriter::repeatMessages(UInt32 lostCount) {
 	_output.send(make_shared<RTMFPRepeater>(_marker, _pQueue));
 }
 
+void RTMFPWriter::release() {
+	if (!_pQueue->sending.empty()) // consumed, no sender holds the queue
+		_output.send(make_shared<RTMFPReleaser>(_marker, _pQueue));
+}
+
+void RTMFPWriter::acceptFEC() {
+	if (!_pQueue->fec || _pQueue->fecAccepted)
+		return;
+	DEBUG("FEC accepted on writer ", _pQueue->id)
+	_pQueue->fecAccepted = true;
+}
+
+Int64 RTMFPWriter::repeatTimeout() const {
+	if (!_repeatDelay)
+		return -1;
+	Int64 remaining(_repeatDelay - _repeatTime.elapsed() + 1); // +1 because isElapsed() is strict
+	return remaining > 0 ? remaining : 0;
+}
+
 void RTMFPWriter::flush() {
 	// manage sub writers, erase them closed
 	auto it = _writers.begin();
@@ -33,6 +33,7 @@ using namespace std;
 extern "C" {
 
 static std::shared_ptr<Invoker>		GlobalInvoker; // manage threads, sockets and connection
+static unsigned short				GlobalThreads(0); // number of threads of the global invoker thread pool, 0 for the default value
 
 void RTMFP_Init(RTMFPConfig* config, RTMFPGroupConfig* groupConfig, int createLogger) {
 	if (!config) {
@@ -42,7 +43,7 @@ void RTMFP_Init(RTMFPConfig* config, RTMFPGroupConfig* groupConfig, int createLo
 
 	// Init global invoker (+logger)
 	if (!GlobalInvoker) {
-		GlobalInvoker.reset(new Invoker(createLogger>0));
+		GlobalInvoker.reset(new Invoker(createLogger>0, GlobalThreads));
 		if (!GlobalInvoker->start()) {
 			GlobalInvoker.reset();
 			return;
@@ -50,6 +51,9 @@ void RTMFP_Init(RTMFPConfig* config, RTMFPGroupConfig* groupConfig, int createLo
 	}
 
 	memset(config, 0, sizeof(RTMFPConfig));
+	config->fecSources = 8;
+	config->fecRepairs = 2;
+	config->queueSize = 1024;
 
 	if (!groupConfig)
 		return; // ignore groupConfig if not set
@@ -62,6 +66,12 @@ void RTMFP_Init(RTMFPConfig* config, RTMFPGroupConfig* groupConfig, int createLo
 	groupConfig->pushLimit = 4;
 }
 
+void RTMFP_ThreadPoolSetSize(unsigned short threads) {
+	if (GlobalInvoker)
+		WARN("RTMFP_ThreadPoolSetSize() must be called before RTMFP_Init(), the thread pool has already ", GlobalInvoker->threadPool.threads(), " threads")
+	GlobalThreads = threads;
+}
+
 void RTMFP_Terminate() {
 	GlobalInvoker.reset();
 }
@@ -85,7 +95,7 @@ unsigned int RTMFP_Connect(const char* url, RTMFPConfig* parameters) {
 	Util::UnpackUrl(url, host, publication, query);
 
 	Exception ex;
-	shared_ptr<RTMFPSession> pConn(new RTMFPSession(*GlobalInvoker, parameters->pOnSocketError, parameters->pOnStatusEvent, parameters->pOnMedia));
+	shared_ptr<RTMFPSession> pConn(new RTMFPSession(*GlobalInvoker, *parameters));
 	unsigned int index = GlobalInvoker->addConnection(pConn);
 	if (!pConn->connect(ex, url, host.c_str())) {
 		ERROR("Error in connect : ", ex)
@@ -264,7 +274,7 @@ int RTMFP_Read(unsigned short streamId, unsigned int RTMFPcontext,char *buf,unsi
 
 		// Nothing read, wait for data
 		DEBUG("Nothing available, sleeping...")
-		pConn->readSignal.wait(100);
+		pConn->readSignal.wait(pConn->readDelay(streamId));
 		if (!GlobalInvoker || GlobalInvoker->isInterrupted())
 			break;
 	}
@@ -272,6 +282,171 @@ int RTMFP_Read(unsigned short streamId, unsigned int RTMFPcontext,char *buf,unsi
 	return 0;
 }
 
+int RTMFP_TryRead(unsigned short streamId, unsigned int RTMFPcontext, char *buf, unsigned int size) {
+	if (!GlobalInvoker) {
+		ERROR("RTMFP_Init() has not been called, please call it first")
+		return -1;
+	}
+
+	int nbRead = 0;
+	shared_ptr<RTMFPSession> pConn;
+	if (!GlobalInvoker->getConnection(RTMFPcontext, pConn) || pConn->read(streamId, (UInt8*)buf, size, nbRead) <= 0)
+		return -1;
+	return nbRead;
+}
+
+unsigned int RTMFP_GetReadDelay(unsigned int RTMFPcontext, unsigned short streamId) {
+	shared_ptr<RTMFPSession> pConn;
+	if (!GlobalInvoker || !GlobalInvoker->getConnection(RTMFPcontext, pConn))
+		return 0;
+	return pConn->readDelay(streamId);
+}
+
+int RTMFP_GetDescriptor(unsigned int RTMFPcontext) {
+	if (!GlobalInvoker) {
+		ERROR("RTMFP_Init() has not been called, please call it first")
+		return -1;
+	}
+
+	shared_ptr<RTMFPSession> pConn;
+	if (!GlobalInvoker->getConnection(RTMFPcontext, pConn))
+		return -1;
+	return pConn->notifier.fd();
+}
+
+int RTMFP_GetStreamDescriptor(unsigned int RTMFPcontext, unsigned short streamId) {
+	if (!GlobalInvoker) {
+		ERROR("RTMFP_Init() has not been called, please call it first")
+		return -1;
+	}
+
+	shared_ptr<RTMFPSession> pConn;
+	if (!GlobalInvoker->getConnection(RTMFPcontext, pConn))
+		return -1;
+	return pConn->streamDescriptor(streamId);
+}
+
+int RTMFP_GetState(unsigned int RTMFPcontext) {
+	if (!GlobalInvoker) {
+		ERROR("RTMFP_Init() has not been called, please call it first")
+		return -1;
+	}
+
+	shared_ptr<RTMFPSession> pConn;
+	if (!GlobalInvoker->getConnection(RTMFPcontext, pConn))
+		return RTMFP_STATE_CLOSED; // deleted
+	return pConn->state();
+}
+
+// Media lent by RTMFP_ReadMedia until RTMFP_ReleaseMedia
+struct LentMedia : virtual Object {
+	LentMedia(const shared_ptr<RTMFPMediaPacket>& pPacket) : pPacket(pPacket) {}
+
+	shared_ptr<RTMFPMediaPacket>	pPacket;
+	UInt8							header[24]; // FLV header (13 bytes) + FLV tag header (11 bytes)
+	UInt8							footer[4]; // previous tag size
+	vector<RTMFPSlice>				slices;
+};
+
+// Fill media with the packet lent until RTMFP_ReleaseMedia
+static void LendMedia(RTMFPMedia* media, const shared_ptr<RTMFPMediaPacket>& pPacket, bool header, int flvTags) {
+	LentMedia* pMedia = new LentMedia(pPacket);
+	const RTMFP::Fragments& fragments = pPacket->fragments;
+	UInt32 pos = pPacket->pos; // payload already read by RTMFP_Read
+	if (flvTags) {
+		BinaryWriter writer(pMedia->header, sizeof(pMedia->header));
+		if (header)
+			writer.write(EXPAND("FLV\x01\x05\x00\x00\x00\x09\x00\x00\x00\x00"));
+		if (!pos) // else tag header already read by RTMFP_Read
+			writer.write8(pPacket->type).write24(fragments.bytes).write24(pPacket->time).write32(0);
+		if (writer.size())
+			pMedia->slices.push_back({ pMedia->header, writer.size() });
+		BinaryWriter(pMedia->footer, sizeof(pMedia->footer)).write32(11 + fragments.bytes);
+	}
+	for (const Packet& fragment : fragments) {
+		if (pos >= fragment.size()) {
+			pos -= fragment.size();
+			continue;
+		}
+		pMedia->slices.push_back({ fragment.data() + pos, fragment.size() - pos });
+		pos = 0;
+	}
+	if (flvTags)
+		pMedia->slices.push_back({ pMedia->footer, sizeof(pMedia->footer) });
+
+	media->time = pPacket->time;
+	media->type = pPacket->type;
+	media->size = fragments.bytes - pPacket->pos;
+	media->count = pMedia->slices.size();
+	media->slices = pMedia->slices.data();
+	media->handle = pMedia;
+}
+
+int RTMFP_ReadMedia(unsigned short streamId, unsigned int RTMFPcontext, RTMFPMedia* media, int flvTags) {
+	if (!GlobalInvoker) {
+		ERROR("RTMFP_Init() has not been called, please call it first")
+		return -1;
+	}
+	if (!media) {
+		ERROR("media parameter must be not null")
+		return -1;
+	}
+
+	int ret = 0;
+	bool header = false;
+	shared_ptr<RTMFPMediaPacket> pPacket;
+	shared_ptr<RTMFPSession> pConn;
+	// Loop while the connection is available and no data is available
+	while (GlobalInvoker->getConnection(RTMFPcontext, pConn)) {
+		if ((ret = pConn->read(streamId, pPacket, header)) <= 0)
+			return ret;
+		if (pPacket)
+			break;
+
+		// Nothing read, wait for data
+		DEBUG("Nothing available, sleeping...")
+		pConn->readSignal.wait(pConn->readDelay(streamId));
+		if (!GlobalInvoker || GlobalInvoker->isInterrupted())
+			return 0;
+	}
+	if (!pPacket)
+		return 0;
+
+	LendMedia(media, pPacket, header, flvTags);
+	return 1;
+}
+
+int RTMFP_TryReadMedia(unsigned short streamId, unsigned int RTMFPcontext, RTMFPMedia* media, int flvTags) {
+	if (!GlobalInvoker) {
+		ERROR("RTMFP_Init() has not been called, please call it first")
+		return -1;
+	}
+	if (!media) {
+		ERROR("media parameter must be not null")
+		return -1;
+	}
+
+	bool header = false;
+	shared_ptr<RTMFPMediaPacket> pPacket;
+	shared_ptr<RTMFPSession> pConn;
+	if (!GlobalInvoker->getConnection(RTMFPcontext, pConn) || pConn->read(streamId, pPacket, header) <= 0)
+		return -1;
+	if (!pPacket)
+		return 0;
+
+	LendMedia(media, pPacket, header, flvTags);
+	return 1;
+}
+
+void RTMFP_ReleaseMedia(RTMFPMedia* media) {
+	if (!media || !media->handle)
+		return;
+	delete (LentMedia*)media->handle;
+	media->handle = NULL;
+	media->slices = NULL;
+	media->count = 0;
+}
+
 int RTMFP_Write(unsigned int RTMFPcontext,const char *buf,int size) {
 	if (!GlobalInvoker) {
 		ERROR("RTMFP_Init() has not been called, please call it first")
@@ -354,6 +529,60 @@ void RTMFP_GetPublicationAndUrlFromUri(const char* uri, char** publication) {
 	}
 }
 
+int RTMFP_GetBufferStats(RTMFPBufferStats* stats) {
+	if (!GlobalInvoker)
+		return 0;
+	BufferPool::Stats poolStats;
+	GlobalInvoker->bufferPool.stats(poolStats);
+	stats->allocations = poolStats.allocations;
+	stats->reuses = poolStats.reuses;
+	stats->allocationRate = poolStats.rate;
+	stats->fragmentation = poolStats.fragmentation();
+	stats->cached = poolStats.cached;
+	return 1;
+}
+
+int RTMFP_GetPlayoutStats(unsigned int RTMFPcontext, unsigned short streamId, RTMFPPlayoutStats* stats) {
+	if (!GlobalInvoker) {
+		ERROR("RTMFP_Init() has not been called, please call it first")
+		return 0;
+	}
+
+	shared_ptr<RTMFPSession> pConn;
+	if (!GlobalInvoker->getConnection(RTMFPcontext, pConn))
+		return 0;
+	UInt32 latency, jitter, buffered;
+	UInt64 late, dropped;
+	if (!pConn->playoutStats(streamId, latency, jitter, buffered, late, dropped))
+		return 0;
+	stats->latency = latency;
+	stats->jitter = jitter;
+	stats->buffered = buffered;
+	stats->late = late;
+	stats->dropped = dropped;
+	return 1;
+}
+
+int RTMFP_GetQueueStats(unsigned int RTMFPcontext, unsigned short streamId, RTMFPQueueStats* stats) {
+	if (!GlobalInvoker) {
+		ERROR("RTMFP_Init() has not been called, please call it first")
+		return 0;
+	}
+
+	shared_ptr<RTMFPSession> pConn;
+	if (!GlobalInvoker->getConnection(RTMFPcontext, pConn))
+		return 0;
+	UInt32 depth, capacity;
+	UInt64 dropped, blocked;
+	if (!pConn->queueStats(streamId, depth, capacity, dropped, blocked))
+		return 0;
+	stats->depth = depth;
+	stats->capacity = capacity;
+	stats->dropped = dropped;
+	stats->blocked = blocked;
+	return 1;
+}
+
 void RTMFP_ActiveDump() {
 	Logs::SetDump("LIBRTMFP");
 }